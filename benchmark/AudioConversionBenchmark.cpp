@@ -0,0 +1,92 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "AudioConversion.hpp"
+#include "KaldiInterface.hpp"
+
+namespace {
+
+/// @brief One second of 16KHz audio, about what a client sends per request
+constexpr int64_t DefaultSampleCount = 16000;
+
+std::string randomAudio(size_t sampleCount) {
+  std::mt19937 generator(42);
+  std::uniform_int_distribution<int16_t> distribution;
+  std::string bytes(sampleCount * sizeof(int16_t), '\0');
+  for (size_t i = 0; i < sampleCount; ++i) {
+    const auto sample = distribution(generator);
+    std::memcpy(bytes.data() + i * sizeof(int16_t), &sample, sizeof(int16_t));
+  }
+  return bytes;
+}
+
+/// @brief How stringToKaldiVector used to do it: copy into an int16 buffer, then convert each
+/// element into the Kaldi vector
+kaldi::Vector<kaldi::BaseFloat> copyThenConvert(std::unique_ptr<std::string> audioDataPtr) {
+  if (audioDataPtr->length() % 2 != 0) {
+    audioDataPtr->push_back(0x0);
+  }
+  std::vector<int16_t> buffer_int16(audioDataPtr->length() / 2);
+  std::memmove(buffer_int16.data(), audioDataPtr->data(), audioDataPtr->length());
+
+  kaldi::Vector<kaldi::BaseFloat> audio_data_float(
+      static_cast<kaldi::MatrixIndexT>(buffer_int16.size()), kaldi::kUndefined);
+  for (int i = 0; i < audio_data_float.Dim(); ++i) {
+    audio_data_float(i) = static_cast<kaldi::BaseFloat>(buffer_int16[static_cast<size_t>(i)]);
+  }
+  return audio_data_float;
+}
+
+void setBytesProcessed(benchmark::State& state) {
+  state.SetBytesProcessed(state.iterations() * state.range(0) *
+                          static_cast<int64_t>(sizeof(int16_t)));
+}
+
+} // namespace
+
+static void BM_CopyThenConvert(benchmark::State& state) {
+  const auto audio = randomAudio(static_cast<size_t>(state.range(0)));
+  for ([[maybe_unused]] auto _ : state) {
+    // Both versions are handed their own copy of the request's audio
+    auto output = copyThenConvert(std::make_unique<std::string>(audio));
+    benchmark::DoNotOptimize(output.Data());
+  }
+  setBytesProcessed(state);
+}
+BENCHMARK(BM_CopyThenConvert)->Arg(DefaultSampleCount)->Arg(DefaultSampleCount * 10);
+
+static void BM_StringToKaldiVector(benchmark::State& state) {
+  const auto audio = randomAudio(static_cast<size_t>(state.range(0)));
+  for ([[maybe_unused]] auto _ : state) {
+    auto output = mik::stringToKaldiVector(std::make_unique<std::string>(audio));
+    benchmark::DoNotOptimize(output.Data());
+  }
+  setBytesProcessed(state);
+}
+BENCHMARK(BM_StringToKaldiVector)->Arg(DefaultSampleCount)->Arg(DefaultSampleCount * 10);
+
+/// @brief Only the conversion, for each instruction set the CPU supports
+static void BM_Int16ToFloat(benchmark::State& state, mik::SimdLevel simdLevel) {
+  if (static_cast<int>(simdLevel) > static_cast<int>(mik::detectSimdLevel())) {
+    state.SkipWithError("Not supported by this CPU");
+    return;
+  }
+  const auto audio = randomAudio(static_cast<size_t>(state.range(0)));
+  std::vector<float> output(static_cast<size_t>(state.range(0)));
+  for ([[maybe_unused]] auto _ : state) {
+    mik::int16ToFloat(audio, output.data(), simdLevel);
+    benchmark::DoNotOptimize(output.data());
+    benchmark::ClobberMemory();
+  }
+  setBytesProcessed(state);
+}
+BENCHMARK_CAPTURE(BM_Int16ToFloat, Scalar, mik::SimdLevel::Scalar)->Arg(DefaultSampleCount);
+BENCHMARK_CAPTURE(BM_Int16ToFloat, Sse2, mik::SimdLevel::Sse2)->Arg(DefaultSampleCount);
+BENCHMARK_CAPTURE(BM_Int16ToFloat, Avx2, mik::SimdLevel::Avx2)->Arg(DefaultSampleCount);
+
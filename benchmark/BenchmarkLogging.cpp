@@ -0,0 +1,44 @@
+#include <spdlog/async.h>
+#include <spdlog/sinks/basic_file_sink.h>
+
+#include "BenchmarkLogging.hpp"
+
+namespace mik::benchmarks {
+namespace {
+
+/// @brief Same as the server's default --log-queue-size
+constexpr size_t QueueSize = 8192;
+
+std::shared_ptr<spdlog::logger> makeLogger(LogMode mode) {
+  if (mode == LogMode::Off) {
+    auto logger = std::make_shared<spdlog::logger>("benchmark-off");
+    logger->set_level(spdlog::level::off);
+    return logger;
+  }
+
+  auto sink = std::make_shared<spdlog::sinks::basic_file_sink_mt>("logs/benchmark.log", true);
+  std::shared_ptr<spdlog::logger> logger;
+  if (mode == LogMode::Async) {
+    // Lives as long as the program, the logger only holds a weak reference to it
+    static const auto threadPool = std::make_shared<spdlog::details::thread_pool>(QueueSize, 1);
+    logger = std::make_shared<spdlog::async_logger>("benchmark-async", std::move(sink), threadPool,
+                                                    spdlog::async_overflow_policy::overrun_oldest);
+  } else {
+    logger = std::make_shared<spdlog::logger>("benchmark-sync", std::move(sink));
+  }
+  logger->set_level(spdlog::level::debug);
+  return logger;
+}
+
+} // namespace
+
+/**
+ * benchmarkLogger
+ */
+std::shared_ptr<spdlog::logger> benchmarkLogger(LogMode mode) {
+  static const std::shared_ptr<spdlog::logger> loggers[] = {
+      makeLogger(LogMode::Off), makeLogger(LogMode::Sync), makeLogger(LogMode::Async)};
+  return loggers[static_cast<size_t>(mode)];
+}
+
+} // namespace mik::benchmarks
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include <spdlog/spdlog.h>
+
+namespace mik::benchmarks {
+
+/// @brief Ways the server can be logging while it decodes, passed to benchmarks as an argument
+enum class LogMode : int64_t { Off, Sync, Async };
+
+/// @brief Logger that writes debug messages to a file in the given mode, made once per mode
+std::shared_ptr<spdlog::logger> benchmarkLogger(LogMode mode);
+
+/**
+ * ScopedDefaultLogger
+ * @brief Makes the benchmark logger the default for as long as it's alive, so that code that logs
+ * with the SPDLOG_ macros is measured with it
+ */
+class ScopedDefaultLogger {
+public:
+  explicit ScopedDefaultLogger(LogMode mode)
+      : previous_(spdlog::default_logger()), previousLevel_(spdlog::get_level()) {
+    spdlog::set_default_logger(benchmarkLogger(mode));
+  }
+  ScopedDefaultLogger(const ScopedDefaultLogger&) = delete;
+  ScopedDefaultLogger& operator=(const ScopedDefaultLogger&) = delete;
+  ~ScopedDefaultLogger() {
+    spdlog::set_default_logger(previous_);
+    spdlog::set_level(previousLevel_);
+  }
+
+private:
+  std::shared_ptr<spdlog::logger> previous_;
+  spdlog::level::level_enum previousLevel_;
+};
+
+} // namespace mik::benchmarks
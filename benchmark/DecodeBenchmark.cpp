@@ -0,0 +1,134 @@
+#include <benchmark/benchmark.h>
+
+#include <feat/resample.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "BenchmarkLogging.hpp"
+#include "KaldiInterface.hpp"
+#include "ServerConfig.hpp"
+
+using mik::benchmarks::LogMode;
+using mik::benchmarks::ScopedDefaultLogger;
+
+namespace {
+
+/// @brief Resamples raw int16 audio, rounding and clamping back into int16
+std::string resampleAudio(const std::string& audio, kaldi::BaseFloat fromRate,
+                          kaldi::BaseFloat toRate) {
+  const auto wave = mik::stringToKaldiVector(audio);
+  kaldi::Vector<kaldi::BaseFloat> resampled;
+  kaldi::ResampleWaveform(fromRate, wave, toRate, &resampled);
+
+  std::vector<int16_t> samples(static_cast<size_t>(resampled.Dim()));
+  for (kaldi::MatrixIndexT i = 0; i < resampled.Dim(); ++i) {
+    samples[static_cast<size_t>(i)] = static_cast<int16_t>(
+        std::clamp(std::round(resampled(i)), -32768.0f, 32767.0f));
+  }
+  return std::string(reinterpret_cast<const char*>(samples.data()),
+                     samples.size() * sizeof(int16_t));
+}
+
+/**
+ * @brief Models are too big to keep in the repository, so RISTRETTO_BENCHMARK_MODEL has to point
+ * at a directory laid out like Kaldi's online decoding setup: final.mdl, HCLG.fst, words.txt and
+ * conf/online.conf. RISTRETTO_BENCHMARK_AUDIO can point at raw int16 audio to decode instead of the
+ * 8 kHz test resource, RISTRETTO_BENCHMARK_AUDIO_RATE sets its rate if it's not the model's. Audio
+ * at another rate than --samp-freq in online.conf is resampled once up front
+ */
+struct DecodeSetup {
+  std::shared_ptr<const mik::Nnet3Model> model;
+  std::string audio;
+  double audioSecs = 0;
+  std::string error;
+};
+
+const DecodeSetup& decodeSetup() {
+  static const DecodeSetup setup = [] {
+    DecodeSetup result;
+    const char* modelDir = std::getenv("RISTRETTO_BENCHMARK_MODEL");
+    if (!modelDir) {
+      result.error = "Set RISTRETTO_BENCHMARK_MODEL to a model directory to run this";
+      return result;
+    }
+    const std::filesystem::path modelPath(modelDir);
+
+    mik::Nnet3Config config;
+    kaldi::ParseOptions po("");
+    config.Register(&po);
+    po.ReadConfigFile((modelPath / "conf" / "online.conf").string());
+    config.nnet3Filename = (modelPath / "final.mdl").string();
+    config.fstFilename = (modelPath / "HCLG.fst").string();
+    config.wordSymsFilename = (modelPath / "words.txt").string();
+
+    const char* audioFile = std::getenv("RISTRETTO_BENCHMARK_AUDIO");
+    std::ifstream audioStream(audioFile ? audioFile : RISTRETTO_BENCHMARK_DEFAULT_AUDIO,
+                              std::ios::binary);
+    result.audio.assign(std::istreambuf_iterator<char>(audioStream),
+                        std::istreambuf_iterator<char>());
+    if (result.audio.empty()) {
+      result.error = "Couldn't read the benchmark audio";
+      return result;
+    }
+    auto rate = audioFile ? config.sampFreq
+                          : static_cast<kaldi::BaseFloat>(RISTRETTO_BENCHMARK_DEFAULT_AUDIO_RATE);
+    if (const char* audioRate = std::getenv("RISTRETTO_BENCHMARK_AUDIO_RATE")) {
+      rate = std::stof(audioRate);
+    }
+    if (rate != config.sampFreq) {
+      result.audio = resampleAudio(result.audio, rate, config.sampFreq);
+    }
+
+    result.model = std::make_shared<const mik::Nnet3Model>(config);
+    result.audioSecs = static_cast<double>(result.audio.size() / sizeof(int16_t)) /
+                       static_cast<double>(config.sampFreq);
+    return result;
+  }();
+  return setup;
+}
+
+} // namespace
+
+/// @brief A whole recording sent in one request, the way the unary RPC decodes it. It's run with
+/// each way of logging to see what the decode path's logging costs
+static void BM_DecodeAudio(benchmark::State& state, LogMode logMode) {
+  const auto& setup = decodeSetup();
+  if (!setup.error.empty()) {
+    state.SkipWithError(setup.error.c_str());
+    return;
+  }
+
+  const ScopedDefaultLogger logger(logMode);
+  mik::Nnet3Data decoder(setup.model);
+  double decodeSecs = 0;
+  for ([[maybe_unused]] auto _ : state) {
+    const auto start = std::chrono::steady_clock::now();
+    auto segments = decoder.decodeAudio("benchmark", 0, std::make_unique<std::string>(setup.audio),
+                                        true);
+    decodeSecs += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    benchmark::DoNotOptimize(segments.data());
+  }
+
+  const auto iterations = static_cast<double>(state.iterations());
+  state.counters["audio_secs"] = setup.audioSecs;
+  state.counters["real_time_factor"] = decodeSecs / (setup.audioSecs * iterations);
+}
+BENCHMARK_CAPTURE(BM_DecodeAudio, LogOff, LogMode::Off)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(BM_DecodeAudio, LogSync, LogMode::Sync)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(BM_DecodeAudio, LogAsync, LogMode::Async)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
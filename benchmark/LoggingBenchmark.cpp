@@ -0,0 +1,27 @@
+#include <benchmark/benchmark.h>
+
+#include <string>
+
+#include "BenchmarkLogging.hpp"
+
+using mik::benchmarks::LogMode;
+
+/**
+ * @brief The messages decodeAudio logs for every chunk, from many decode threads at once. They're
+ * logged at runtime so that the cost of each mode shows even in release builds, where decodeAudio's
+ * own per-chunk messages are compiled out
+ */
+static void BM_ChunkLogging(benchmark::State& state, LogMode mode) {
+  const auto logger = mik::benchmarks::benchmarkLogger(mode);
+  const std::string transcript = "the quick brown fox jumps over the lazy dog";
+  int sampleCount = 0;
+  for ([[maybe_unused]] auto _ : state) {
+    sampleCount += 2880;
+    logger->debug("Chunk length:{}, Total sample count:{}", 2880, sampleCount);
+    logger->debug("Temporary transcript: {}", transcript);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_CAPTURE(BM_ChunkLogging, Off, LogMode::Off)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK_CAPTURE(BM_ChunkLogging, Sync, LogMode::Sync)->ThreadRange(1, 16)->UseRealTime();
+BENCHMARK_CAPTURE(BM_ChunkLogging, Async, LogMode::Async)->ThreadRange(1, 16)->UseRealTime();
@@ -0,0 +1,61 @@
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "SessionManager.hpp"
+
+namespace {
+
+/// @brief Lookups don't touch the decoder so it doesn't need a model
+struct FakeDecoder {
+  void reset() {}
+};
+
+using SessionManager = mik::BasicSessionManager<FakeDecoder>;
+
+constexpr size_t SessionCount = 1024;
+
+/// @brief Shared by every thread of a benchmark, it's filled with sessions once
+SessionManager& sharedSessions() {
+  static SessionManager sessions([] { return std::make_unique<FakeDecoder>(); }, 0,
+                                 std::chrono::seconds(0), 0);
+  return sessions;
+}
+
+const std::vector<std::string>& sessionTokens() {
+  static const std::vector<std::string> tokens = [] {
+    std::vector<std::string> result;
+    for (size_t i = 0; i < SessionCount; ++i) {
+      result.emplace_back("session-token-" + std::to_string(i));
+    }
+    return result;
+  }();
+  return tokens;
+}
+
+} // namespace
+
+/// @brief Every request looks up its session first, this is how much that costs when many decode
+/// threads do it at once
+static void BM_AcquireExistingSession(benchmark::State& state) {
+  auto& sessions = sharedSessions();
+  const auto& tokens = sessionTokens();
+  for (const auto& token : tokens) {
+    benchmark::DoNotOptimize(sessions.acquire(token));
+  }
+
+  // Threads start at different sessions so they don't all hit the same shard
+  static std::atomic<size_t> nextStart = 0;
+  size_t i = nextStart.fetch_add(97);
+  for ([[maybe_unused]] auto _ : state) {
+    auto decoder = sessions.acquire(tokens[i % tokens.size()]);
+    benchmark::DoNotOptimize(decoder.get());
+    ++i;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AcquireExistingSession)->ThreadRange(1, 16)->UseRealTime();
@@ -0,0 +1,91 @@
+#include <benchmark/benchmark.h>
+
+#include <string>
+
+#include "KaldiInterface.hpp"
+#include "TestLattices.hpp"
+
+namespace {
+
+constexpr int VocabularySize = 1000;
+
+fst::SymbolTable makeWordSymbols() { return TestUtils::makeWordSymbols(VocabularySize); }
+
+/// @brief Best path of an utterance, every word takes a few frames
+kaldi::Lattice makeLinearLattice(int wordCount) {
+  constexpr int FramesPerWord = 8;
+  kaldi::Lattice lat;
+  auto state = lat.AddState();
+  lat.SetStart(state);
+  for (int i = 0; i < wordCount * FramesPerWord; ++i) {
+    const auto next = lat.AddState();
+    // The word label is on the first frame of the word
+    const int word = i % FramesPerWord == 0 ? (i / FramesPerWord) % VocabularySize + 1 : 0;
+    lat.AddArc(state, kaldi::LatticeArc(i + 1, word, kaldi::LatticeWeight(1, 1), next));
+    state = next;
+  }
+  lat.SetFinal(state, kaldi::LatticeWeight::One());
+  return lat;
+}
+
+} // namespace
+
+/// @brief Temporary transcripts are made from the best path
+static void BM_LatticeToString(benchmark::State& state) {
+  const auto wordSyms = makeWordSymbols();
+  const auto lat = makeLinearLattice(static_cast<int>(state.range(0)));
+  for ([[maybe_unused]] auto _ : state) {
+    auto text = mik::LatticeToString(lat, wordSyms);
+    benchmark::DoNotOptimize(text.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_LatticeToString)->Arg(10)->Arg(100);
+
+/// @brief Final transcripts are made from the determinized lattice, which has to find the best
+/// path first
+static void BM_CompactLatticeToString(benchmark::State& state) {
+  const auto wordSyms = makeWordSymbols();
+  kaldi::CompactLattice clat;
+  fst::ConvertLattice(makeLinearLattice(static_cast<int>(state.range(0))), &clat);
+  for ([[maybe_unused]] auto _ : state) {
+    auto text = mik::LatticeToString(clat, wordSyms);
+    benchmark::DoNotOptimize(text.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CompactLatticeToString)->Arg(10)->Arg(100);
+
+/// @brief Final transcripts with N-best and the words' confidences and times, Args are words, N
+/// and whether to give the words. Compare with BM_CompactLatticeToString to see what the extra
+/// output costs
+static void BM_LatticeToSegment(benchmark::State& state) {
+  const auto wordSyms = makeWordSymbols();
+  const auto clat = TestUtils::makeSausageLattice(static_cast<int>(state.range(0)), 3);
+  mik::TranscriptOptions options;
+  options.nbest = static_cast<kaldi::int32>(state.range(1));
+  options.wordConfidence = state.range(2) != 0;
+  options.wordTimes = state.range(2) != 0;
+  options.frameDuration = 0.03f;
+  for ([[maybe_unused]] auto _ : state) {
+    auto segment = mik::LatticeToSegment(clat, wordSyms, options);
+    benchmark::DoNotOptimize(segment.text.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_LatticeToSegment)
+    ->Args({10, 1, 0})
+    ->Args({10, 10, 0})
+    ->Args({10, 1, 1})
+    ->Args({10, 10, 1})
+    ->Args({100, 10, 1});
+
+static void BM_GetTimeString(benchmark::State& state) {
+  kaldi::int32 frame = 0;
+  for ([[maybe_unused]] auto _ : state) {
+    auto text = mik::GetTimeString(frame, frame + 150, 0.03f);
+    benchmark::DoNotOptimize(text.data());
+    ++frame;
+  }
+}
+BENCHMARK(BM_GetTimeString);
@@ -0,0 +1,14 @@
+#include <benchmark/benchmark.h>
+#include <spdlog/spdlog.h>
+
+int main(int argc, char** argv) {
+  // The decoders log every chunk, which would otherwise be measured along with them
+  spdlog::set_level(spdlog::level::warn);
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -16,6 +16,7 @@ class RistrettoConan(ConanFile):
         self.requires("fmt/6.2.0")
         self.requires("spdlog/1.5.0")
         self.requires("nlohmann_json/3.8.0")
+        self.requires("benchmark/1.5.0")
         # Any other dependencies are handled by Dockerfiles since both the server
         # and client are containerized
 
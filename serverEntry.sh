@@ -44,24 +44,13 @@ start_server()
 
     ulimit -c unlimited
 
-    # Export directory, shortened to 'exp' in Kaldi
-    EXP="/opt/kaldi/egs/aspire/s5/exp"
-    MODEL="${EXP}/chain/tdnn_7b/final.mdl"
-    HCLG="${EXP}/tdnn_7b_chain_online/graph_pp/HCLG.fst"
-    WORDS="${EXP}/tdnn_7b_chain_online/graph_pp/words.txt"
-    CONFIG="${EXP}/tdnn_7b_chain_online/conf/online.conf" 
-    # Make sure all of the files exist
-    for conf in $MODEL $HCLG $WORDS $CONFIG; do
-        test -f ${conf} || { echo "${conf} does not exist"; exit 1; }
-    done
-
-    ARGS=" --verbose=1 --frames-per-chunk=20 \
-    --extra-left-context-initial=0 --frame-subsampling-factor=3 --config=${CONFIG} \
-    --min-active=200 --max-active=7000 \
-    --beam=15.0 --lattice-beam=6.0 --acoustic-scale=1.0 \
-     ${MODEL} ${HCLG} ${WORDS}"
+    # The model files, tuning knobs and Kaldi options are all in the JSON config, the server says
+    # which of its files it couldn't read
+    SERVER_CONFIG="serverConfig.json"
+    ARGS=" --server-config=${SERVER_CONFIG}"
 
     pushd /opt/ristretto
+    test -f ${SERVER_CONFIG} || { echo "${SERVER_CONFIG} does not exist"; exit 1; }
 
     if [ "$DEBUG" != "YES" ]; then
         ./build/bin/RistrettoServer $ARGS
@@ -29,6 +29,8 @@ void AlsaInterface::stopRecording() {
   if (recordingThread_.joinable()) {
     recordingThread_.join();
   }
+  // Whoever is waiting for audio won't get any more
+  this->notifyAudioWaiter();
   SPDLOG_INFO("Recording stopped.");
 }
 
@@ -40,6 +42,7 @@ void AlsaInterface::record() {
 
   std::vector<char> audioBuffer(config_.periodSizeBytes);
   audioBuffer.resize(config_.periodSizeBytes);
+  bool overran = false;
 
   while (shouldRecord_) {
 
@@ -60,11 +63,17 @@ void AlsaInterface::record() {
       continue;
     }
 
-    {
-      // Access the container that holds all the auido data, add this chunk of audio to it
-      std::lock_guard<std::mutex> lock(audioChunkMutex_);
-      audioData_.insert(std::end(audioData_), std::cbegin(audioBuffer), std::cend(audioBuffer));
+    // Never waits for the consumer, the period is dropped if there's no room for it
+    const bool written =
+        audioData_->write(std::string_view(audioBuffer.data(), audioBuffer.size()));
+    if (!written && !overran) {
+      SPDLOG_WARN("record(): Audio isn't consumed fast enough, dropping it until it is");
+    } else if (written && overran) {
+      SPDLOG_WARN("record(): Caught up, {} bytes of audio were dropped so far",
+                  audioData_->overrunBytes());
     }
+    overran = !written;
+    this->notifyAudioWaiter();
   }
 
   SPDLOG_DEBUG("record(): end");
@@ -99,11 +108,11 @@ std::vector<char> AlsaInterface::captureAudioUntilUserExit() {
   const auto secondsAsFraction = static_cast<double>(duration.count()) / 1000.0;
   const auto infoMsg =
       fmt::format("Recording stopped, received {} seconds of audio totalling {} bytes",
-                  secondsAsFraction, audioData_.size());
+                  secondsAsFraction, audioData_->size());
   SPDLOG_DEBUG(infoMsg);
   fmt::print("{}\n", infoMsg);
 
-  return audioData_;
+  return this->consumeAllAudioData();
 }
 
 /**
@@ -1,9 +1,20 @@
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
 #include "AlsaInterface.hpp"
 #include "Utils.hpp"
 
 namespace mik {
 
-AlsaInterface::AlsaInterface(const AlsaConfig& alsaConfig) : config_(alsaConfig) {
+AlsaInterface::AlsaInterface(const AlsaConfig& alsaConfig)
+    : config_(alsaConfig),
+      audioData_(std::make_unique<RingBuffer>(alsaConfig.captureBufferBytes())),
+      audioEventFd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+  if (audioEventFd_ < 0) {
+    SPDLOG_ERROR("Could not create an eventfd, waiting for audio will poll. errno:{}",
+                 std::strerror(errno));
+  }
   SPDLOG_INFO("Configuring AlsaInterface...");
   if (this->configureInterface() == Status::SUCCESS) {
     SPDLOG_INFO("Configured AlsaInterface successfully");
@@ -21,6 +32,9 @@ AlsaInterface::~AlsaInterface() {
   SPDLOG_INFO("Destroying AlsaInterface...");
   this->stopRecording();
   pcmHandle_.reset();
+  if (audioEventFd_ >= 0) {
+    close(audioEventFd_);
+  }
   SPDLOG_INFO("Done destroying AlsaInterface");
 }
 
@@ -38,9 +52,30 @@ snd_pcm_t* AlsaInterface::openSoundDevice(std::string_view pcmDesc, StreamConfig
   return pcmHandle;
 }
 
+/**
+ * AlsaInterface::updateConfiguration
+ * @brief The previous device stays open until the new one is configured, so it can be restored
+ */
 Status AlsaInterface::updateConfiguration(const AlsaConfig& config) {
-  config_ = config;
-  return this->configureInterface();
+  if (recordingThread_.joinable()) {
+    SPDLOG_ERROR("Can't change the configuration while recording");
+    return Status::ERROR;
+  }
+
+  auto previousConfig = std::exchange(config_, config);
+  auto previousHandle = std::move(pcmHandle_);
+  if (this->configureInterface() != Status::SUCCESS) {
+    SPDLOG_ERROR("Keeping the previous configuration");
+    config_ = std::move(previousConfig);
+    pcmHandle_ = std::move(previousHandle);
+    return Status::ERROR;
+  }
+
+  // Otherwise the buffer would hold a different duration of audio at the new rate
+  if (config_.captureBufferBytes() != audioData_->capacity()) {
+    audioData_ = std::make_unique<RingBuffer>(config_.captureBufferBytes());
+  }
+  return Status::SUCCESS;
 }
 
 Status AlsaInterface::configureInterface() {
@@ -76,6 +111,8 @@ Status AlsaInterface::configureInterface() {
   snd_pcm_hw_params_set_rate_near(pcmHandle_.get(), params, &val, &dir);
   // Check what rate we actually got
   SPDLOG_INFO("Got a sampling freq of {} Hz", val);
+  // Kept so that the audio can be resampled from the rate it really has
+  config_.samplingFreq_Hz = val;
 
   // Set period size to X frames
   SPDLOG_INFO("Attempting to set period size to {} frames", config_.frames);
@@ -136,63 +173,114 @@ std::chrono::milliseconds AlsaInterface::bytesToAudioDuration(size_t size) const
 /**
  * AlsaInterface::audioDataAvailableBytes()
  */
-size_t AlsaInterface::audioDataAvailableBytes() const noexcept { return audioData_.size(); }
+size_t AlsaInterface::audioDataAvailableBytes() const noexcept { return audioData_->size(); }
+
+/**
+ * AlsaInterface::waitForAudioData()
+ * @brief The waiter publishes how much it wants and then checks for it one last time, the recording
+ * thread writes audio and then checks for a waiter. The ring buffer's indices are only acquire and
+ * release, so a seq_cst fence on each side keeps either load from moving before its store. Then
+ * at least one side sees the other's store: the recording thread signals the eventfd or the last
+ * check finds the audio. A leftover signal only causes a spurious wakeup
+ */
+bool AlsaInterface::waitForAudioData(size_t bytes, std::chrono::milliseconds timeout) {
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  while (audioData_->size() < bytes) {
+    bytesWaitedFor_.store(bytes);
+    // Pairs with the fence in notifyAudioWaiter
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (audioData_->size() >= bytes) {
+      break;
+    }
+
+    const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+        deadline - std::chrono::steady_clock::now());
+    if (remaining.count() <= 0 || !shouldRecord_) {
+      break;
+    }
+    if (audioEventFd_ < 0) {
+      std::this_thread::sleep_for(std::min(remaining, bytesToAudioDuration(bytes)));
+      continue;
+    }
+    pollfd event{audioEventFd_, POLLIN, 0};
+    if (poll(&event, 1, static_cast<int>(remaining.count())) > 0) {
+      eventfd_t count;
+      eventfd_read(audioEventFd_, &count);
+    }
+  }
+  bytesWaitedFor_.store(0);
+  return audioData_->size() >= bytes;
+}
+
+/**
+ * AlsaInterface::notifyAudioWaiter()
+ * @brief Only makes a syscall once per wait, not for every period. Called after the audio was
+ * written, see waitForAudioData for why the fence is needed
+ */
+void AlsaInterface::notifyAudioWaiter() noexcept {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  const auto wanted = bytesWaitedFor_.load(std::memory_order_relaxed);
+  if (wanted == 0 || (shouldRecord_ && audioData_->size() < wanted)) {
+    return;
+  }
+  if (bytesWaitedFor_.exchange(0) != 0 && audioEventFd_ >= 0) {
+    eventfd_write(audioEventFd_, 1);
+  }
+}
 
 /**
  * AlsaInterface::audioDataAvailableMilliseconds()
  * @brief Returns how many milliseconds of audio data are available
  */
 std::chrono::milliseconds AlsaInterface::audioDataAvailableMilliseconds() const noexcept {
-  return bytesToAudioDuration(audioData_.size());
+  return bytesToAudioDuration(audioData_->size());
 }
 
 /**
  * AlsaInterface::consumeAllAudioData()
  */
 std::vector<char> AlsaInterface::consumeAllAudioData() {
-  std::scoped_lock<std::mutex> lock(audioChunkMutex_);
-  SPDLOG_DEBUG("Consuming all {} bytes of audio data", audioData_.size());
-  // Swap our audio data for an empty vector and return the full one
-  return std::exchange(audioData_, std::vector<char>{});
+  return this->consumeAudioBytes(audioData_->size());
+}
+
+/**
+ * AlsaInterface::consumeAllAudioData()
+ * @brief Only copies the audio once, into output
+ */
+size_t AlsaInterface::consumeAllAudioData(std::string* output) {
+  const auto bytesRead = audioData_->read(audioData_->size(), output);
+  SPDLOG_DEBUG("Consumed all {} bytes of audio data", bytesRead);
+  return bytesRead;
 }
 
 /**
  * AlsaInterface::consumeDurationOfAudioData()
  */
 std::vector<char> AlsaInterface::consumeDurationOfAudioData(std::chrono::milliseconds duration) {
-  std::scoped_lock<std::mutex> lock(audioChunkMutex_);
-
   const auto bytesToGet = audioDurationToBytes(duration);
-
-  if (bytesToGet > audioData_.size()) {
+  const auto bytesAvailable = audioData_->size();
+  if (bytesToGet > bytesAvailable) {
     SPDLOG_WARN(
         "{} bytes were requested but only {} were available. Returning all that are available.",
-        bytesToGet, audioData_.size());
-    return std::exchange(audioData_, std::vector<char>{});
-  } else if (bytesToGet == 0) {
-    return std::vector<char>{};
+        bytesToGet, bytesAvailable);
   }
+  return this->consumeAudioBytes(bytesToGet);
+}
 
-  // Split this vector into two. The lower indices wil be returned, the rest will be kept
-  const auto startOfConsumedAudio = std::cbegin(audioData_);
-  const auto endOfConsumedAudio =
-      std::next(startOfConsumedAudio,
-                static_cast<decltype(startOfConsumedAudio)::difference_type>(bytesToGet));
-  // This data will be returned
-  const std::vector<char> consumedAudio(startOfConsumedAudio, endOfConsumedAudio);
-
-  {
-    // Swap audioData_ with a vector containing the current remaining audio
-    const auto startOfRemainingAudio = std::next(endOfConsumedAudio);
-    const auto endOfRemainingAudio = std::cend(audioData_);
-    // This data will be kept
-    std::vector<char> remainingAudio(startOfRemainingAudio, endOfRemainingAudio);
-
-    // Let the data that was formerly known as audioData_ be destroyed
-    audioData_.swap(remainingAudio);
+/**
+ * AlsaInterface::consumeAudioBytes()
+ * @brief The audio is copied once, straight out of the capture buffer
+ */
+std::vector<char> AlsaInterface::consumeAudioBytes(size_t bytes) {
+  const auto pieces = audioData_->peek(bytes);
+  std::vector<char> consumedAudio;
+  consumedAudio.reserve(pieces[0].size() + pieces[1].size());
+  for (const auto piece : pieces) {
+    consumedAudio.insert(std::end(consumedAudio), std::cbegin(piece), std::cend(piece));
   }
+  audioData_->consume(consumedAudio.size());
 
-  SPDLOG_INFO("Consumed {} bytes of audio", consumedAudio.size());
+  SPDLOG_DEBUG("Consumed {} bytes of audio", consumedAudio.size());
   return consumedAudio;
 }
 
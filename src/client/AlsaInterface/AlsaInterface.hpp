@@ -2,15 +2,20 @@
 
 #include <alsa/asoundlib.h>
 
+#include <algorithm>
 #include <atomic>
 #include <cstring>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <string_view>
 #include <thread>
+#include <utility>
 #include <vector>
 
+#include "RingBuffer.hpp"
+
 // This is the consumer-facing header
 
 namespace mik {
@@ -61,6 +66,14 @@ struct AlsaConfig {
   snd_pcm_access_t accessType = SND_PCM_ACCESS_RW_INTERLEAVED;
   StreamConfig streamConfig = StreamConfig::CAPTURE;
   std::string pcmDesc = static_cast<std::string>(defaultHw);
+  // Captured audio that hasn't been consumed yet is kept for up to this long, anything captured
+  // after that is dropped until it's consumed
+  unsigned int captureBuffer_ms = 10000;
+
+  inline size_t captureBufferBytes() const noexcept {
+    const auto bytesPerFrame = periodSizeBytes / std::max<snd_pcm_uframes_t>(frames, 1);
+    return static_cast<size_t>(captureBuffer_ms) * samplingFreq_Hz / 1000 * bytesPerFrame;
+  }
 
   inline int calculateRecordingLoops(unsigned int recordingDuration_us) {
     return static_cast<int>(recordingDuration_us / periodDuration_us);
@@ -71,7 +84,7 @@ struct AlsaConfig {
     return samplingFreq_Hz == rhs.samplingFreq_Hz && periodDuration_us == rhs.periodDuration_us &&
            frames == rhs.frames && format == rhs.format && accessType == rhs.accessType &&
            channelConfig == rhs.channelConfig && streamConfig == rhs.streamConfig &&
-           pcmDesc == rhs.pcmDesc;
+           pcmDesc == rhs.pcmDesc && captureBuffer_ms == rhs.captureBuffer_ms;
   }
   inline bool operator!=(const AlsaConfig& rhs) const noexcept { return !(*this == rhs); }
 };
@@ -92,6 +105,9 @@ public:
   std::vector<char> captureAudioUntilUserExit();
   void playbackAudioFixedSize(std::istream& inputStream, unsigned int seconds);
   void playbackAudioFixedSizeMs(std::istream& inputStream, unsigned int milliseconds);
+  /// @brief Reopens the device with the new configuration, the capture buffer is resized for it.
+  /// Fails while recording
+  /// @return ERROR if it couldn't be applied, the previous configuration and device are kept then
   Status updateConfiguration(const AlsaConfig& alsaConfig);
 
   Status configureInterface();
@@ -108,23 +124,39 @@ public:
   void stopRecording();
   void startRecording();
   [[nodiscard]] size_t audioDataAvailableBytes() const noexcept;
+  /// @brief Sleeps until at least this many bytes of audio can be consumed, the recording thread
+  /// wakes it up as soon as they're captured. Recording stopping also wakes it up
+  /// @return false if there still isn't enough audio after the timeout
+  bool waitForAudioData(size_t bytes, std::chrono::milliseconds timeout);
   [[nodiscard]] std::chrono::milliseconds audioDataAvailableMilliseconds() const noexcept;
   std::vector<char> consumeAllAudioData();
   std::vector<char> consumeDurationOfAudioData(std::chrono::milliseconds duration);
+  /// @brief Appends the audio straight from the capture buffer, e.g. into a protobuf's bytes
+  /// @return Number of bytes that were appended
+  size_t consumeAllAudioData(std::string* output);
+  /// @brief Bytes of audio that were dropped because they weren't consumed in time
+  [[nodiscard]] uint64_t overrunBytes() const noexcept { return audioData_->overrunBytes(); }
   [[nodiscard]] size_t audioDurationToBytes(std::chrono::milliseconds duration) const noexcept;
   [[nodiscard]] std::chrono::milliseconds bytesToAudioDuration(size_t size) const noexcept;
 
 protected:
   snd_pcm_t* openSoundDevice(std::string_view pcmDesc, StreamConfig streamConfig);
   void record();
+  std::vector<char> consumeAudioBytes(size_t bytes);
+  void notifyAudioWaiter() noexcept;
 
   AlsaConfig config_;
 
-  std::atomic<bool> shouldRecord_;
+  std::atomic<bool> shouldRecord_ = false;
   std::thread recordingThread_;
 
-  std::mutex audioChunkMutex_;
-  std::vector<char> audioData_;
+  /// @brief Filled by the recording thread, drained by one consumer. It's only replaced while not
+  /// recording, when a new configuration needs another capacity
+  std::unique_ptr<RingBuffer> audioData_;
+  /// @brief Bytes waitForAudioData is waiting for, 0 when nothing is waiting
+  std::atomic<size_t> bytesWaitedFor_ = 0;
+  /// @brief eventfd the recording thread signals without ever blocking on it
+  int audioEventFd_ = -1;
   std::unique_ptr<snd_pcm_t, SndPcmDeleter> pcmHandle_;
 };
 
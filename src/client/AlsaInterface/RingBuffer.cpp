@@ -0,0 +1,82 @@
+#include <algorithm>
+#include <cstring>
+
+#include "RingBuffer.hpp"
+
+namespace mik {
+
+/**
+ * RingBuffer::RingBuffer
+ */
+RingBuffer::RingBuffer(size_t capacity)
+    : capacity_(std::max<size_t>(capacity, 1)), data_(std::make_unique<char[]>(capacity_)) {}
+
+/**
+ * RingBuffer::write
+ * @brief The data is copied in before written_ is published, so the consumer never sees bytes
+ * that aren't there yet
+ */
+bool RingBuffer::write(std::string_view data) noexcept {
+  const auto written = written_.load(std::memory_order_relaxed);
+  const auto read = read_.load(std::memory_order_acquire);
+  if (data.size() > capacity_ - (written - read)) {
+    overrunBytes_.fetch_add(data.size(), std::memory_order_relaxed);
+    return false;
+  }
+
+  const auto start = written % capacity_;
+  const auto firstPart = std::min(data.size(), capacity_ - start);
+  std::memcpy(data_.get() + start, data.data(), firstPart);
+  std::memcpy(data_.get(), data.data() + firstPart, data.size() - firstPart);
+  written_.store(written + data.size(), std::memory_order_release);
+  return true;
+}
+
+/**
+ * RingBuffer::peek
+ */
+std::array<std::string_view, 2> RingBuffer::peek(size_t maxBytes) const noexcept {
+  const auto read = read_.load(std::memory_order_relaxed);
+  const auto written = written_.load(std::memory_order_acquire);
+  const auto length = std::min(maxBytes, written - read);
+
+  const auto start = read % capacity_;
+  const auto firstPart = std::min(length, capacity_ - start);
+  return {std::string_view(data_.get() + start, firstPart),
+          std::string_view(data_.get(), length - firstPart)};
+}
+
+/**
+ * RingBuffer::consume
+ * @brief Publishing read_ hands the space back to the producer, so it has to come after the
+ * consumer is done with the bytes
+ */
+void RingBuffer::consume(size_t bytes) noexcept {
+  const auto read = read_.load(std::memory_order_relaxed);
+  const auto written = written_.load(std::memory_order_acquire);
+  read_.store(read + std::min(bytes, written - read), std::memory_order_release);
+}
+
+/**
+ * RingBuffer::read
+ */
+size_t RingBuffer::read(size_t maxBytes, std::string* output) {
+  const auto pieces = peek(maxBytes);
+  output->reserve(output->size() + pieces[0].size() + pieces[1].size());
+  output->append(pieces[0]);
+  output->append(pieces[1]);
+  consume(pieces[0].size() + pieces[1].size());
+  return pieces[0].size() + pieces[1].size();
+}
+
+/**
+ * RingBuffer::size
+ */
+size_t RingBuffer::size() const noexcept {
+  const auto read = read_.load(std::memory_order_acquire);
+  const auto written = written_.load(std::memory_order_acquire);
+  // Read first, so written can only be ahead of it
+  return written - read;
+}
+
+} // namespace mik
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace mik {
+
+/**
+ * RingBuffer
+ * @brief Fixed-size byte queue for exactly one producer thread and one consumer thread. Neither
+ * side ever locks or waits for the other, and nothing is allocated after construction. When the
+ * consumer falls behind, writes that don't fit are dropped and counted instead of blocking
+ */
+class RingBuffer {
+public:
+  explicit RingBuffer(size_t capacity);
+  RingBuffer(const RingBuffer&) = delete;
+  RingBuffer& operator=(const RingBuffer&) = delete;
+
+  /// @brief Producer only. All of data is written or, if it doesn't fit, none of it is so that
+  /// audio frames are never split
+  /// @return false if it was dropped
+  bool write(std::string_view data) noexcept;
+
+  /// @brief Consumer only. Up to maxBytes of the oldest data, in two pieces since it may wrap
+  /// around the end of the buffer. The second piece is empty when it doesn't. They stay valid
+  /// until they're consumed
+  [[nodiscard]] std::array<std::string_view, 2> peek(size_t maxBytes) const noexcept;
+  /// @brief Consumer only. Frees the oldest bytes, at most as many as are readable
+  void consume(size_t bytes) noexcept;
+  /// @brief Consumer only. Appends up to maxBytes of the oldest data to output and frees them
+  /// @return Number of bytes that were read
+  size_t read(size_t maxBytes, std::string* output);
+
+  /// @brief Bytes that can be read, from any thread it's only a snapshot
+  [[nodiscard]] size_t size() const noexcept;
+  [[nodiscard]] size_t capacity() const noexcept { return capacity_; }
+  /// @brief Bytes that were dropped because the buffer was full
+  [[nodiscard]] uint64_t overrunBytes() const noexcept {
+    return overrunBytes_.load(std::memory_order_relaxed);
+  }
+
+private:
+  const size_t capacity_;
+  std::unique_ptr<char[]> data_;
+  /// @brief Total bytes ever written and read, the positions in data_ are these modulo capacity_.
+  /// Each one is only changed by one side, they're kept apart so they don't share a cache line
+  alignas(64) std::atomic<size_t> written_ = 0;
+  alignas(64) std::atomic<size_t> read_ = 0;
+  std::atomic<uint64_t> overrunBytes_ = 0;
+};
+
+} // namespace mik
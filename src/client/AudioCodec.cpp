@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <cstring>
+
+#include <spdlog/spdlog.h>
+
+#include "AudioCodec.hpp"
+
+namespace mik {
+
+/**
+ * parseAudioEncoding
+ */
+std::optional<AudioEncoding> parseAudioEncoding(std::string_view name) {
+  if (name == "pcm") {
+    return AudioEncoding::Linear16;
+  } else if (name == "flac") {
+    return AudioEncoding::Flac;
+  } else if (name == "opus") {
+    return AudioEncoding::Opus;
+  }
+  return std::nullopt;
+}
+
+/**
+ * makeAudioEncoder
+ */
+std::unique_ptr<AudioEncoder> makeAudioEncoder(AudioEncoding encoding, unsigned int sampleRate) {
+  switch (encoding) {
+  case AudioEncoding::Flac:
+    return std::make_unique<FlacAudioEncoder>(sampleRate);
+  case AudioEncoding::Opus:
+    return std::make_unique<OpusAudioEncoder>(sampleRate);
+  case AudioEncoding::Linear16:
+    break;
+  }
+  return nullptr;
+}
+
+/**
+ * FlacAudioEncoder::FlacAudioEncoder
+ */
+FlacAudioEncoder::FlacAudioEncoder(unsigned int sampleRate, unsigned int frameMs)
+    : sampleRate_(sampleRate), blockSize_(std::max(16u, sampleRate * frameMs / 1000)),
+      encoder_(FLAC__stream_encoder_new()) {
+  if (encoder_ == nullptr) {
+    SPDLOG_ERROR("Couldn't allocate a FLAC encoder");
+    return;
+  }
+  initialize();
+}
+
+/**
+ * FlacAudioEncoder::~FlacAudioEncoder
+ */
+FlacAudioEncoder::~FlacAudioEncoder() {
+  if (encoder_ != nullptr) {
+    FLAC__stream_encoder_delete(encoder_);
+  }
+}
+
+/**
+ * FlacAudioEncoder::initialize
+ * @brief Starts a new stream, its header is handed out with the first frames. Finishing a stream
+ * resets the settings so they're set every time
+ */
+bool FlacAudioEncoder::initialize() {
+  FLAC__stream_encoder_set_verify(encoder_, false);
+  FLAC__stream_encoder_set_channels(encoder_, 1);
+  FLAC__stream_encoder_set_bits_per_sample(encoder_, 16);
+  FLAC__stream_encoder_set_sample_rate(encoder_, sampleRate_);
+  FLAC__stream_encoder_set_compression_level(encoder_, 5);
+  FLAC__stream_encoder_set_blocksize(encoder_, blockSize_);
+  // Without seek and tell callbacks the header isn't rewritten once the stream is done
+  const auto status = FLAC__stream_encoder_init_stream(
+      encoder_, &FlacAudioEncoder::writeCallback, nullptr, nullptr, nullptr, this);
+  if (status != FLAC__STREAM_ENCODER_INIT_STATUS_OK) {
+    SPDLOG_ERROR("Couldn't initialize the FLAC encoder:{}",
+                 FLAC__StreamEncoderInitStatusString[status]);
+    return false;
+  }
+  return true;
+}
+
+/**
+ * FlacAudioEncoder::encode
+ */
+bool FlacAudioEncoder::encode(std::string_view pcm, std::string* output) {
+  if (encoder_ == nullptr) {
+    return false;
+  }
+  const auto sampleCount = pcm.size() / sizeof(int16_t);
+  samples_.resize(sampleCount);
+  for (size_t i = 0; i < sampleCount; ++i) {
+    int16_t sample = 0;
+    std::memcpy(&sample, pcm.data() + i * sizeof(int16_t), sizeof(int16_t));
+    samples_[i] = sample;
+  }
+
+  const bool ok = FLAC__stream_encoder_process_interleaved(encoder_, samples_.data(),
+                                                           static_cast<uint32_t>(sampleCount));
+  if (!ok) {
+    SPDLOG_ERROR("Couldn't encode FLAC:{}",
+                 FLAC__StreamEncoderStateString[FLAC__stream_encoder_get_state(encoder_)]);
+  }
+  output->append(encoded_);
+  encoded_.clear();
+  return ok;
+}
+
+/**
+ * FlacAudioEncoder::finish
+ * @brief The last frame is shorter than the others
+ */
+bool FlacAudioEncoder::finish(std::string* output) {
+  if (encoder_ == nullptr) {
+    return false;
+  }
+  const bool ok = FLAC__stream_encoder_finish(encoder_);
+  output->append(encoded_);
+  encoded_.clear();
+  return initialize() && ok;
+}
+
+/**
+ * FlacAudioEncoder::writeCallback
+ * @brief Called with the header blocks and then with one whole frame at a time
+ */
+FLAC__StreamEncoderWriteStatus
+FlacAudioEncoder::writeCallback([[maybe_unused]] const FLAC__StreamEncoder* encoder,
+                                const FLAC__byte buffer[], size_t bytes,
+                                [[maybe_unused]] uint32_t samples,
+                                [[maybe_unused]] uint32_t currentFrame, void* clientData) {
+  static_cast<FlacAudioEncoder*>(clientData)->encoded_.append(reinterpret_cast<const char*>(buffer),
+                                                              bytes);
+  return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+}
+
+/**
+ * OpusAudioEncoder::OpusAudioEncoder
+ */
+OpusAudioEncoder::OpusAudioEncoder(unsigned int sampleRate, opus_int32 bitrate)
+    : frameSamples_(sampleRate / 50) {
+  int error = OPUS_OK;
+  encoder_ =
+      opus_encoder_create(static_cast<opus_int32>(sampleRate), 1, OPUS_APPLICATION_VOIP, &error);
+  if (error != OPUS_OK) {
+    SPDLOG_ERROR("Couldn't create an Opus encoder at {} Hz:{}", sampleRate, opus_strerror(error));
+    encoder_ = nullptr;
+    return;
+  }
+  // Not the OPUS_SET_* macros, they're made of C-style casts
+  opus_encoder_ctl(encoder_, OPUS_SET_BITRATE_REQUEST, bitrate);
+  opus_encoder_ctl(encoder_, OPUS_SET_SIGNAL_REQUEST, OPUS_SIGNAL_VOICE);
+  heldBack_.reserve(frameSamples_);
+}
+
+/**
+ * OpusAudioEncoder::~OpusAudioEncoder
+ */
+OpusAudioEncoder::~OpusAudioEncoder() {
+  if (encoder_ != nullptr) {
+    opus_encoder_destroy(encoder_);
+  }
+}
+
+/**
+ * OpusAudioEncoder::encode
+ * @brief Samples are gathered in heldBack_ until there's enough for a packet
+ */
+bool OpusAudioEncoder::encode(std::string_view pcm, std::string* output) {
+  if (encoder_ == nullptr) {
+    return false;
+  }
+  const auto sampleCount = pcm.size() / sizeof(int16_t);
+  const auto sampleAt = [&pcm](size_t index) {
+    int16_t sample = 0;
+    std::memcpy(&sample, pcm.data() + index * sizeof(int16_t), sizeof(int16_t));
+    return sample;
+  };
+
+  bool ok = true;
+  size_t position = 0;
+  while (position < sampleCount) {
+    const auto count = std::min(frameSamples_ - heldBack_.size(), sampleCount - position);
+    for (size_t i = 0; i < count; ++i) {
+      heldBack_.push_back(sampleAt(position + i));
+    }
+    position += count;
+    if (heldBack_.size() == frameSamples_) {
+      ok = encodePacket(heldBack_.data(), output) && ok;
+      heldBack_.clear();
+    }
+  }
+  return ok;
+}
+
+/**
+ * OpusAudioEncoder::finish
+ * @brief The held back samples are padded with silence to fill the last packet
+ */
+bool OpusAudioEncoder::finish(std::string* output) {
+  if (encoder_ == nullptr) {
+    return false;
+  }
+  bool ok = true;
+  if (!heldBack_.empty()) {
+    heldBack_.resize(frameSamples_, 0);
+    ok = encodePacket(heldBack_.data(), output);
+    heldBack_.clear();
+  }
+  opus_encoder_ctl(encoder_, OPUS_RESET_STATE);
+  return ok;
+}
+
+/**
+ * OpusAudioEncoder::encodePacket
+ */
+bool OpusAudioEncoder::encodePacket(const int16_t* samples, std::string* output) {
+  const auto length = opus_encode(encoder_, samples, static_cast<int>(frameSamples_),
+                                  packet_.data(), static_cast<opus_int32>(packet_.size()));
+  if (length < 0) {
+    SPDLOG_ERROR("Couldn't encode an Opus packet:{}", opus_strerror(length));
+    return false;
+  }
+  output->push_back(static_cast<char>(length & 0xff));
+  output->push_back(static_cast<char>(length >> 8));
+  output->append(reinterpret_cast<const char*>(packet_.data()), static_cast<size_t>(length));
+  return true;
+}
+
+} // namespace mik
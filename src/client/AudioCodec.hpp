@@ -0,0 +1,100 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <FLAC/stream_encoder.h>
+#include <opus/opus.h>
+
+namespace mik {
+
+/// @brief How the audio that's sent is encoded, mirrors RistrettoProto::AudioEncoding
+enum class AudioEncoding { Linear16, Flac, Opus };
+
+/// @brief "pcm", "flac" or "opus"
+[[nodiscard]] std::optional<AudioEncoding> parseAudioEncoding(std::string_view name);
+
+/**
+ * AudioEncoder
+ * @brief Compresses the mono int16 PCM that's sent to the server. The audio is one continuous
+ * stream until finish(), so the state between chunks is kept
+ */
+class AudioEncoder {
+public:
+  virtual ~AudioEncoder() = default;
+
+  /// @brief Appends the encoded audio to output. Samples that don't fill a whole frame yet are
+  /// held back until the next call, so the output lags by less than one frame
+  /// @return false if the audio couldn't be encoded
+  virtual bool encode(std::string_view pcm, std::string* output) = 0;
+  /// @brief Appends whatever was held back and ends the stream, the next call starts a new one
+  virtual bool finish(std::string* output) = 0;
+};
+
+/**
+ * FlacAudioEncoder
+ * @brief Lossless FLAC, about half the size of PCM for speech. Every call hands out whole frames
+ * and the first one starts with the stream's header
+ */
+class FlacAudioEncoder : public AudioEncoder {
+public:
+  /// @param frameMs Audio in each FLAC frame, longer frames compress a bit better
+  explicit FlacAudioEncoder(unsigned int sampleRate, unsigned int frameMs = 40);
+  FlacAudioEncoder(const FlacAudioEncoder&) = delete;
+  FlacAudioEncoder& operator=(const FlacAudioEncoder&) = delete;
+  ~FlacAudioEncoder() override;
+
+  bool encode(std::string_view pcm, std::string* output) override;
+  bool finish(std::string* output) override;
+
+private:
+  static FLAC__StreamEncoderWriteStatus writeCallback(const FLAC__StreamEncoder* encoder,
+                                                      const FLAC__byte buffer[], size_t bytes,
+                                                      uint32_t samples, uint32_t currentFrame,
+                                                      void* clientData);
+  bool initialize();
+
+  const unsigned int sampleRate_;
+  const unsigned int blockSize_;
+  FLAC__StreamEncoder* encoder_;
+  /// @brief Filled by the write callback until it's handed out
+  std::string encoded_;
+  /// @brief Reused between calls, libFLAC takes 32-bit samples
+  std::vector<FLAC__int32> samples_;
+};
+
+/**
+ * OpusAudioEncoder
+ * @brief Low bitrate Opus in 20 ms packets, each one preceded by its length as a little-endian
+ * uint16. Only works at 8, 12, 16, 24 and 48 kHz
+ */
+class OpusAudioEncoder : public AudioEncoder {
+public:
+  explicit OpusAudioEncoder(unsigned int sampleRate, opus_int32 bitrate = 24000);
+  OpusAudioEncoder(const OpusAudioEncoder&) = delete;
+  OpusAudioEncoder& operator=(const OpusAudioEncoder&) = delete;
+  ~OpusAudioEncoder() override;
+
+  bool encode(std::string_view pcm, std::string* output) override;
+  bool finish(std::string* output) override;
+
+private:
+  bool encodePacket(const int16_t* samples, std::string* output);
+
+  const size_t frameSamples_;
+  OpusEncoder* encoder_;
+  /// @brief Samples that don't fill a packet yet
+  std::vector<int16_t> heldBack_;
+  /// @brief Largest packet Opus makes
+  std::array<unsigned char, 1275> packet_{};
+};
+
+/// @return nullptr for Linear16, which is sent as it is
+std::unique_ptr<AudioEncoder> makeAudioEncoder(AudioEncoding encoding, unsigned int sampleRate);
+
+} // namespace mik
@@ -0,0 +1,205 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <spdlog/spdlog.h>
+
+#include "AudioProcessing.hpp"
+
+namespace mik {
+namespace {
+
+constexpr double Pi = 3.14159265358979323846;
+/// @brief The passband ends a bit below the lower Nyquist frequency so the transition band fits
+/// under it
+constexpr double Rolloff = 0.95;
+
+double sinc(double x) noexcept { return x == 0 ? 1 : std::sin(Pi * x) / (Pi * x); }
+
+double blackman(size_t i, size_t length) noexcept {
+  if (length <= 1) {
+    return 1;
+  }
+  const double phase = 2 * Pi * static_cast<double>(i) / static_cast<double>(length - 1);
+  return 0.42 - 0.5 * std::cos(phase) + 0.08 * std::cos(2 * phase);
+}
+
+float dot(const float* a, const float* b, size_t length) noexcept {
+  size_t i = 0;
+  float sum = 0;
+#if defined(__SSE2__)
+  __m128 partialSums = _mm_setzero_ps();
+  for (; i + 4 <= length; i += 4) {
+    partialSums = _mm_add_ps(partialSums, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+  }
+  alignas(16) float parts[4];
+  _mm_store_ps(parts, partialSums);
+  sum = (parts[0] + parts[1]) + (parts[2] + parts[3]);
+#endif
+  for (; i < length; ++i) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+
+int16_t toSample(float value) noexcept {
+  const auto rounded = std::lrint(value);
+  return static_cast<int16_t>(std::clamp<long>(rounded, std::numeric_limits<int16_t>::min(),
+                                               std::numeric_limits<int16_t>::max()));
+}
+
+} // namespace
+
+/**
+ * downmixToMono
+ * @brief Stereo frames are averaged with an arithmetic shift so the vectorized and scalar paths
+ * round the same way
+ */
+void downmixToMono(const int16_t* input, size_t frameCount, unsigned int channels,
+                   int16_t* output) noexcept {
+  if (channels <= 1) {
+    std::memcpy(output, input, frameCount * sizeof(int16_t));
+    return;
+  } else if (channels > 2) {
+    for (size_t frame = 0; frame < frameCount; ++frame) {
+      int32_t sum = 0;
+      for (unsigned int channel = 0; channel < channels; ++channel) {
+        sum += input[frame * channels + channel];
+      }
+      output[frame] = static_cast<int16_t>(sum / static_cast<int32_t>(channels));
+    }
+    return;
+  }
+
+  size_t frame = 0;
+#if defined(__SSE2__)
+  const __m128i ones = _mm_set1_epi16(1);
+  for (; frame + 8 <= frameCount; frame += 8) {
+    const auto* in = reinterpret_cast<const __m128i*>(input + frame * 2);
+    // Adding each pair of neighbours is adding left and right
+    const __m128i low = _mm_srai_epi32(_mm_madd_epi16(_mm_loadu_si128(in), ones), 1);
+    const __m128i high = _mm_srai_epi32(_mm_madd_epi16(_mm_loadu_si128(in + 1), ones), 1);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(output + frame), _mm_packs_epi32(low, high));
+  }
+#endif
+  for (; frame < frameCount; ++frame) {
+    output[frame] = static_cast<int16_t>((input[frame * 2] + input[frame * 2 + 1]) >> 1);
+  }
+}
+
+/**
+ * Resampler::Resampler
+ * @brief Designs the low-pass filter that's applied at up_ times the input rate, it's cut off
+ * below the lower of the two Nyquist frequencies
+ */
+Resampler::Resampler(unsigned int inputRate, unsigned int outputRate, unsigned int zeroCrossings) {
+  const auto divisor = std::gcd(std::max(inputRate, 1u), std::max(outputRate, 1u));
+  up_ = std::max(outputRate, 1u) / divisor;
+  down_ = std::max(inputRate, 1u) / divisor;
+  if (isPassthrough()) {
+    tapsPerPhase_ = 1;
+    reset();
+    return;
+  }
+
+  const auto widerFactor = std::max(up_, down_);
+  const double cutoff = Rolloff * 0.5 / widerFactor;
+  const size_t halfLength = static_cast<size_t>(zeroCrossings) * widerFactor;
+  const size_t length = 2 * halfLength + 1;
+  tapsPerPhase_ = (length + up_ - 1) / up_;
+
+  phases_.assign(tapsPerPhase_ * up_, 0);
+  for (size_t i = 0; i < length; ++i) {
+    const double offset = static_cast<double>(i) - static_cast<double>(halfLength);
+    // Scaled by up_ since only one in up_ of the upsampled input isn't 0
+    const double tap = up_ * 2 * cutoff * sinc(2 * cutoff * offset) * blackman(i, length);
+    const size_t phase = i % up_;
+    const size_t k = i / up_;
+    phases_[phase * tapsPerPhase_ + tapsPerPhase_ - 1 - k] = static_cast<float>(tap);
+  }
+  SPDLOG_DEBUG("Resampling {} Hz to {} Hz with {} phases of {} taps", inputRate, outputRate, up_,
+               tapsPerPhase_);
+  reset();
+}
+
+/**
+ * Resampler::reset
+ */
+void Resampler::reset() {
+  input_.assign(tapsPerPhase_ - 1, 0);
+  nextTime_ = (tapsPerPhase_ - 1) * up_;
+}
+
+/**
+ * Resampler::process
+ * @brief Each output is a dot product of the latest tapsPerPhase_ inputs with the phase of the
+ * filter that lines up with it. Only the inputs that later outputs need are kept afterwards
+ */
+void Resampler::process(const int16_t* input, size_t count, std::vector<int16_t>* output) {
+  if (isPassthrough()) {
+    output->insert(output->end(), input, input + count);
+    return;
+  }
+
+  input_.insert(input_.end(), input, input + count);
+  while (nextTime_ / up_ < input_.size()) {
+    const auto newest = nextTime_ / up_;
+    const auto phase = nextTime_ % up_;
+    output->push_back(toSample(dot(phases_.data() + phase * tapsPerPhase_,
+                                   input_.data() + newest + 1 - tapsPerPhase_, tapsPerPhase_)));
+    nextTime_ += down_;
+  }
+
+  const auto oldestNeeded = std::min(nextTime_ / up_ + 1 - tapsPerPhase_, input_.size());
+  input_.erase(input_.begin(), input_.begin() + static_cast<std::ptrdiff_t>(oldestNeeded));
+  nextTime_ -= oldestNeeded * up_;
+}
+
+/**
+ * AudioPreprocessor::AudioPreprocessor
+ */
+AudioPreprocessor::AudioPreprocessor(unsigned int inputRate, unsigned int channels,
+                                     unsigned int outputRate)
+    : channels_(std::max(channels, 1u)), resampler_(inputRate, outputRate) {}
+
+/**
+ * AudioPreprocessor::process
+ */
+void AudioPreprocessor::process(std::string_view input, std::string* output) {
+  const size_t frameBytes = channels_ * sizeof(int16_t);
+  std::string pending;
+  if (!partialFrame_.empty()) {
+    pending = std::move(partialFrame_) + std::string(input);
+    input = pending;
+  }
+  const size_t frameCount = input.size() / frameBytes;
+
+  // Copied out since the bytes have no alignment guarantees
+  frames_.resize(frameCount * channels_);
+  std::memcpy(frames_.data(), input.data(), frameCount * frameBytes);
+  mono_.resize(frameCount);
+  downmixToMono(frames_.data(), frameCount, channels_, mono_.data());
+
+  resampled_.clear();
+  resampler_.process(mono_.data(), frameCount, &resampled_);
+  output->append(reinterpret_cast<const char*>(resampled_.data()),
+                 resampled_.size() * sizeof(int16_t));
+
+  partialFrame_.assign(input.substr(frameCount * frameBytes));
+}
+
+/**
+ * AudioPreprocessor::reset
+ */
+void AudioPreprocessor::reset() {
+  resampler_.reset();
+  partialFrame_.clear();
+}
+
+} // namespace mik
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace mik {
+
+/**
+ * downmixToMono
+ * @brief Averages the channels of each frame of interleaved int16 PCM. Stereo is vectorized
+ * @param output Must have room for frameCount samples
+ */
+void downmixToMono(const int16_t* input, size_t frameCount, unsigned int channels,
+                   int16_t* output) noexcept;
+
+/**
+ * Resampler
+ * @brief Polyphase windowed-sinc resampler for mono int16 PCM between any two integer rates.
+ * Audio can be fed in any number of pieces, the filter's history is kept between them. The output
+ * lags the input by about zeroCrossings input samples
+ */
+class Resampler {
+public:
+  /// @param zeroCrossings Zero crossings of the sinc on each side, more is sharper and slower
+  Resampler(unsigned int inputRate, unsigned int outputRate, unsigned int zeroCrossings = 16);
+
+  /// @brief Appends the resampled audio to output
+  void process(const int16_t* input, size_t count, std::vector<int16_t>* output);
+  /// @brief Forgets the history so that an unrelated stream can be resampled
+  void reset();
+
+  [[nodiscard]] bool isPassthrough() const noexcept { return up_ == down_; }
+
+private:
+  /// @brief Upsampling and downsampling factors with their common divisor removed
+  unsigned int up_;
+  unsigned int down_;
+  size_t tapsPerPhase_;
+  /// @brief One filter per phase, each one reversed so it's a plain dot product with the input
+  std::vector<float> phases_;
+  /// @brief Input that still has outputs depending on it, starting with tapsPerPhase_ - 1 samples
+  /// of history
+  std::vector<float> input_;
+  /// @brief Position of the next output in input_, in units of 1 / up_ input samples
+  size_t nextTime_;
+};
+
+/**
+ * AudioPreprocessor
+ * @brief Turns captured PCM into what the server's model takes, mono at its sample rate, so no
+ * more than that has to be sent
+ */
+class AudioPreprocessor {
+public:
+  AudioPreprocessor(unsigned int inputRate, unsigned int channels, unsigned int outputRate);
+
+  /// @brief Appends little-endian mono int16 PCM to output. A partial frame at the end of the
+  /// input is kept for the next call
+  void process(std::string_view input, std::string* output);
+  void reset();
+
+private:
+  unsigned int channels_;
+  Resampler resampler_;
+  /// @brief Reused between calls so steady-state processing doesn't allocate
+  std::vector<int16_t> frames_;
+  std::vector<int16_t> mono_;
+  std::vector<int16_t> resampled_;
+  std::string partialFrame_;
+};
+
+} // namespace mik
@@ -1,7 +1,12 @@
 #include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
 #include <fstream>
 #include <future>
 #include <iostream>
+#include <map>
+#include <optional>
 
 #include <fmt/core.h>
 #include <fmt/locale.h>
@@ -13,50 +18,201 @@
 #include "Utils.hpp"
 
 namespace mik {
+namespace {
+
+/// @brief Metadata in which an overloaded server says how many milliseconds to wait
+constexpr char RetryAfterKey[] = "retry-after-ms";
+/// @brief Refusals in a row before the client gives up on the audio
+constexpr unsigned int MaxOverloadRetries = 5;
+
+/**
+ * retryAfterHint
+ * @return How long the server asked to wait before trying again, if it did
+ */
+std::optional<std::chrono::milliseconds>
+retryAfterHint(const std::multimap<grpc::string_ref, grpc::string_ref>& metadata) {
+  const auto hint = metadata.find(RetryAfterKey);
+  if (hint == metadata.end()) {
+    return std::nullopt;
+  }
+  int64_t milliseconds = 0;
+  const auto* end = hint->second.data() + hint->second.size();
+  const auto [parsedEnd, error] = std::from_chars(hint->second.data(), end, milliseconds);
+  if (error != std::errc() || parsedEnd != end || milliseconds < 0) {
+    SPDLOG_WARN("Ignoring invalid {} metadata", RetryAfterKey);
+    return std::nullopt;
+  }
+  return std::chrono::milliseconds(milliseconds);
+}
+
+RistrettoProto::AudioEncoding toProtoEncoding(AudioEncoding encoding) {
+  switch (encoding) {
+  case AudioEncoding::Flac:
+    return RistrettoProto::FLAC;
+  case AudioEncoding::Opus:
+    return RistrettoProto::OPUS;
+  case AudioEncoding::Linear16:
+    break;
+  }
+  return RistrettoProto::LINEAR16;
+}
+
+} // namespace
+
+/**
+ * roundToServerChunks
+ */
+std::chrono::milliseconds roundToServerChunks(std::chrono::milliseconds requested,
+                                              uint32_t chunkSamples, uint32_t sampleRate) {
+  const auto serverChunk = std::chrono::microseconds(
+      std::max<int64_t>(1, int64_t{chunkSamples} * 1000000 / std::max<uint32_t>(sampleRate, 1)));
+  const auto chunkCount = std::max<int64_t>(1, (requested + serverChunk / 2) / serverChunk);
+  return std::chrono::ceil<std::chrono::milliseconds>(serverChunk * chunkCount);
+}
 
 /**
  * RistrettoClient::RistrettoClient
  */
 RistrettoClient::RistrettoClient(const std::shared_ptr<grpc::Channel>& channel, AlsaConfig config)
-    : stub_(RistrettoProto::Decoder::NewStub(channel)), config_(std::move(config)), alsa_(config_) {
+    : stub_(RistrettoProto::Decoder::NewStub(channel)), config_(std::move(config)), alsa_(config_),
+      preprocessor_(alsa_.getConfiguration().samplingFreq_Hz,
+                    static_cast<unsigned int>(alsa_.getConfiguration().channelConfig),
+                    DefaultServerSampleRate) {
   SPDLOG_INFO("Constructed RistrettoClient");
 
   sessionToken_ = Utils::generateSessionToken();
   SPDLOG_INFO("Created session token \"{}\"", sessionToken_);
 }
 
+/**
+ * RistrettoClient::negotiateWithServer
+ */
+bool RistrettoClient::negotiateWithServer(std::chrono::milliseconds timeout) {
+  grpc::ClientContext context;
+  context.set_deadline(std::chrono::system_clock::now() + timeout);
+  RistrettoProto::ServerInfo info;
+  const auto status = stub_->GetServerInfo(&context, RistrettoProto::ServerInfoRequest(), &info);
+  if (!status.ok() || info.samplerate() == 0) {
+    SPDLOG_WARN("Couldn't get the server's info, keeping the client's settings. Error:{}",
+                status.error_message());
+    return false;
+  }
+  SPDLOG_INFO("Server takes {} Hz audio in chunks of {} samples, {} sessions are active and "
+              "{} jobs are queued on {} decode threads",
+              info.samplerate(), info.chunksamples(), info.activesessions(), info.queuedjobs(),
+              info.decodethreads());
+
+  // Capturing at the model's rate leaves nothing to resample
+  if (alsa_.getConfiguration().samplingFreq_Hz != info.samplerate()) {
+    auto captureConfig = alsa_.getConfiguration();
+    captureConfig.samplingFreq_Hz = info.samplerate();
+    if (alsa_.updateConfiguration(captureConfig) == Status::SUCCESS) {
+      config_ = alsa_.getConfiguration();
+    } else {
+      SPDLOG_WARN("Couldn't capture at {} Hz, the audio will be resampled", info.samplerate());
+    }
+  }
+  setServerSampleRate(info.samplerate());
+
+  const auto& encodings = info.encodings();
+  if (std::find(encodings.begin(), encodings.end(), toProtoEncoding(encoding_)) ==
+      encodings.end()) {
+    SPDLOG_WARN("The server doesn't take {} audio, sending PCM instead",
+                RistrettoProto::AudioEncoding_Name(toProtoEncoding(encoding_)));
+    encoding_ = AudioEncoding::Linear16;
+  }
+
+  if (info.chunksamples() > 0) {
+    chunkDuration_ = roundToServerChunks(chunkDuration_, info.chunksamples(), info.samplerate());
+    SPDLOG_INFO("Sending {} ms of audio at a time", chunkDuration_.count());
+  }
+  return true;
+}
+
+/**
+ * RistrettoClient::setServerSampleRate
+ */
+void RistrettoClient::setServerSampleRate(unsigned int sampleRate) {
+  serverSampleRate_ = sampleRate;
+  const auto& captureConfig = alsa_.getConfiguration();
+  SPDLOG_INFO("Microphone audio at {} Hz with {} channels will be sent as mono at {} Hz",
+              captureConfig.samplingFreq_Hz, static_cast<unsigned int>(captureConfig.channelConfig),
+              sampleRate);
+  preprocessor_ =
+      AudioPreprocessor(captureConfig.samplingFreq_Hz,
+                        static_cast<unsigned int>(captureConfig.channelConfig), sampleRate);
+}
+
 /**
  * RistrettoClient::recordAudioChunks
- * @brief Starts recording and saves the audio in the input queue as protobuf objects
+ * @brief Starts recording and saves the audio in the input queue as protobuf objects. Each chunk
+ * is queued as soon as it's been captured
  */
 void RistrettoClient::recordAudioChunks() {
 
   unsigned int audioId = 0;
+  const auto chunkBytes =
+      std::max(alsa_.audioDurationToBytes(chunkDuration_), config_.periodSizeBytes);
+  preprocessor_.reset();
+  encoder_ = makeAudioEncoder(encoding_, serverSampleRate_);
   alsa_.startRecording();
   while (continueRecording_) {
-    if (alsa_.audioDataAvailableMilliseconds() < chunkDuration_) {
-      // It'd be smarter to use condition variables or something else but this'll work for now
-      std::this_thread::sleep_for(chunkDuration_);
-    }
-
-    const auto audioData = alsa_.consumeAllAudioData();
-    if (audioData.empty()) {
-      SPDLOG_ERROR("No audio data was available for consumption!");
-      return;
+    // Times out now and then to notice that recording should stop
+    if (alsa_.waitForAudioData(chunkBytes, chunkDuration_) && queueAudioChunk(audioId)) {
+      ++audioId;
     }
+  } // end of while loop
 
-    RistrettoProto::AudioData audioDataProto;
-    audioDataProto.set_audio(audioData.data(), audioData.size());
-    audioDataProto.set_audioid(audioId++);
-    audioDataProto.set_sessiontoken(sessionToken_);
-
+  alsa_.stopRecording();
+  // The end of the speech doesn't wait for a full chunk, and the encoder lets go of what it held
+  if (queueAudioChunk(audioId, true)) {
+    ++audioId;
+  }
+  {
     std::lock_guard<std::mutex> lock(audioInputMutex_);
-    // Add the audio data to the queue
-    audioInputQ_.emplace(std::move(audioDataProto));
+    recordingDone_ = true;
+  }
+  audioInputCv_.notify_all();
+}
 
-  } // end of while loop
+/**
+ * RistrettoClient::queueAudioChunk
+ * @brief Takes all the audio that was captured so far, turns it into what the server's model
+ * takes and wakes up the sending thread for it
+ * @param isLast Flushes the audio that the encoder held back
+ * @return false if there was nothing to send yet, the audioId wasn't used
+ */
+bool RistrettoClient::queueAudioChunk(unsigned int audioId, bool isLast) {
+  capturedAudio_.clear();
+  if (alsa_.consumeAllAudioData(&capturedAudio_) == 0 && !(isLast && encoder_)) {
+    return false;
+  }
+  RistrettoProto::AudioData audioDataProto;
+  auto* audio = audioDataProto.mutable_audio();
+  if (encoder_) {
+    processedAudio_.clear();
+    preprocessor_.process(capturedAudio_, &processedAudio_);
+    encoder_->encode(processedAudio_, audio);
+    if (isLast) {
+      encoder_->finish(audio);
+    }
+    audioDataProto.set_encoding(toProtoEncoding(encoding_));
+  } else {
+    preprocessor_.process(capturedAudio_, audio);
+  }
+  if (audio->empty()) {
+    // Not enough for a single output sample or packet yet, it's kept for the next chunk
+    return false;
+  }
+  audioDataProto.set_audioid(audioId);
+  audioDataProto.set_sessiontoken(sessionToken_);
 
-  alsa_.stopRecording();
+  {
+    std::lock_guard<std::mutex> lock(audioInputMutex_);
+    audioInputQ_.emplace_back(std::move(audioDataProto));
+  }
+  audioInputCv_.notify_one();
+  return true;
 }
 
 /**
@@ -70,27 +226,38 @@ void RistrettoClient::renderResults() {
   void* recieved_tag;
   bool queueIsOk = false;
   fmt::print("Results will be displayed below.\n");
+  // Each response only has the segments it finished, separate them like the ones within one
+  bool printedText = false;
 
-  // TODO: It may be best to empty out the queue before exiting the loop
-  //       due to continueRecording_ being false
-  while (continueRecording_ && resultCompletionQ_.Next(&recieved_tag, &queueIsOk)) {
+  // Keep going until the queue is shut down and every outstanding result was rendered
+  while (resultCompletionQ_.Next(&recieved_tag, &queueIsOk)) {
     // The tag identifies the ClientCallData* on the completion queue, so dereference it
     std::unique_ptr<ClientCallData> callData(static_cast<ClientCallData*>(recieved_tag));
 
+    const bool isOk = queueIsOk && callData->status.ok();
     if (!queueIsOk) {
       SPDLOG_ERROR("Could not process RPC with tag:{}, skipping this RPC call", recieved_tag);
-      continue;
-    }
-
-    if (callData->status.ok()) {
+    } else if (isOk) {
       // Render results
       SPDLOG_DEBUG("Rendering audioId {} with text \"{}\"", callData->transcript.audioid(),
                    callData->transcript.text());
-      fmt::print("{}", callData->transcript.text());
-    } else {
+      const auto& text = callData->transcript.text();
+      if (!text.empty()) {
+        fmt::print("{}{}", printedText ? " " : "", text);
+        printedText = true;
+      }
+    } else if (!retryWhenOverloaded(*callData)) {
       SPDLOG_ERROR("gRPC error:{}", callData->status.error_message());
-      continue;
     }
+
+    {
+      std::lock_guard<std::mutex> lock(audioInputMutex_);
+      --pendingCalls_;
+      if (isOk) {
+        overloadRetries_ = 0;
+      }
+    }
+    audioInputCv_.notify_all();
   }
   SPDLOG_INFO("renderResults exiting...");
 }
@@ -104,6 +271,7 @@ void RistrettoClient::decodeMicrophoneInput() {
 
   SPDLOG_DEBUG("Starting audio processing loop");
   continueRecording_.store(true);
+  recordingDone_ = false;
 
   // Print the results on-screen on another thread
   auto renderingThread = std::thread(&RistrettoClient::renderResults, this);
@@ -115,93 +283,317 @@ void RistrettoClient::decodeMicrophoneInput() {
 
   // If configured, Stop the recording after a while
   std::thread timeoutThread;
-  if (recordingTimeout_.count() > 0) {
-    timeoutThread = std::thread(
-        [&recordingTimeout_ = recordingTimeout_, &continueRecording_ = continueRecording_] {
-          SPDLOG_INFO("Recording will end after {} milliseconds", recordingTimeout_.count());
-          std::this_thread::sleep_for(recordingTimeout_);
-          SPDLOG_INFO("Timeout hit, ending recording...");
-          continueRecording_.store(false);
-        });
-    SPDLOG_INFO("Started recording timeout thread");
-  }
-
-  while (continueRecording_) {
-
-    // Consume audio from the queue
-    RistrettoProto::AudioData audioData;
-    {
-      while (audioInputQ_.empty()) {
-        // It's possible that there's no audio to send yet, so wait for some to be recorded
-        const auto timeToWait = chunkDuration_ * 3;
-        SPDLOG_WARN("Audio input queue is empty, waiting for {} ms before checking it again",
-                    timeToWait.count());
-        std::this_thread::sleep_for(timeToWait);
+  startRecordingTimeout(timeoutThread);
+
+  unsigned int nextAudioId = 0;
+  bool isEndOfStreamQueued = false;
+  // Consume audio from the queue until the last chunk was sent and answered, audio that the
+  // server refused comes back into the queue
+  RistrettoProto::AudioData audioData;
+  while (true) {
+    if (!takeAudioInput(audioData)) {
+      if (isEndOfStreamQueued) {
+        break;
       }
+      // Let the server finalize whatever audio it still has. It's only sent once everything
+      // before it was answered, so it can't overtake audio that has to be sent again
+      RistrettoProto::AudioData endOfStream;
+      endOfStream.set_audioid(nextAudioId);
+      endOfStream.set_sessiontoken(sessionToken_);
+      endOfStream.set_endofstream(true);
       std::lock_guard<std::mutex> lock(audioInputMutex_);
-      std::swap(audioData, audioInputQ_.back());
-      audioInputQ_.pop();
+      audioInputQ_.emplace_back(std::move(endOfStream));
+      isEndOfStreamQueued = true;
+      continue;
     }
+    waitForRetryAfter();
 
     // This will be deallocated by the completion queue handler (RistrettoClient::renderResults)
     auto call = new ClientCallData;
+    call->audioData = std::move(audioData);
+    nextAudioId = std::max(nextAudioId, call->audioData.audioid() + 1);
+    {
+      std::lock_guard<std::mutex> lock(audioInputMutex_);
+      ++pendingCalls_;
+    }
 
     call->responseReader =
-        stub_->PrepareAsyncDecodeAudio(&call->context, audioData, &resultCompletionQ_);
+        stub_->PrepareAsyncDecodeAudio(&call->context, call->audioData, &resultCompletionQ_);
     call->responseReader->StartCall();
     call->responseReader->Finish(&call->transcript, &call->status, reinterpret_cast<void*>(call));
 
-    SPDLOG_DEBUG("Sent {} bytes of audio, audioId:{}", audioData.ByteSizeLong(),
-                 audioData.audioid());
+    SPDLOG_DEBUG("Sent {} bytes of audio, audioId:{}", call->audioData.ByteSizeLong(),
+                 call->audioData.audioid());
   }
   SPDLOG_INFO("Recording ended.");
 
   recordingThread.join();
+  // Every call was answered so nothing is left on the queue
+  resultCompletionQ_.Shutdown();
   renderingThread.join();
-  timeoutThread.join();
+  if (timeoutThread.joinable()) {
+    timeoutThread.join();
+  }
 
   SPDLOG_DEBUG("Exiting...");
   return;
 }
 
+/**
+ * RistrettoClient::streamMicrophoneInput
+ * @brief Streams audio chunks to the server over a single DecodeStream RPC, temporary transcripts
+ *        are rendered as they arrive and replaced once they're final
+ */
+void RistrettoClient::streamMicrophoneInput() {
+
+  SPDLOG_DEBUG("Starting audio streaming loop");
+  continueRecording_.store(true);
+  recordingDone_ = false;
+
+  std::unique_ptr<grpc::ClientContext> context;
+  const auto stream = openStream(context);
+  if (!stream) {
+    fmt::print("The server is overloaded, try again later\n");
+    return;
+  }
+
+  // Render transcripts on another thread while audio is being sent on this one
+  auto renderingThread = std::thread([&stream] {
+    fmt::print("Results will be displayed below.\n");
+    RistrettoProto::Transcript transcript;
+    while (stream->Read(&transcript)) {
+      SPDLOG_DEBUG("Rendering audioId {} with text \"{}\", isFinal:{}", transcript.audioid(),
+                   transcript.text(), transcript.isfinal());
+      // Temporary transcripts are overwritten by the next one
+      fmt::print("\r{}{}", transcript.text(), transcript.isfinal() ? "\n" : "");
+      std::fflush(stdout);
+    }
+  });
+
+  auto recordingThread = std::thread(&RistrettoClient::recordAudioChunks, this);
+  SPDLOG_INFO("Started recording thread");
+
+  std::thread timeoutThread;
+  startRecordingTimeout(timeoutThread);
+
+  RistrettoProto::AudioData audioData;
+  while (takeAudioInput(audioData)) {
+    if (!stream->Write(audioData)) {
+      SPDLOG_ERROR("DecodeStream was closed by the server");
+      continueRecording_.store(false);
+      break;
+    }
+    SPDLOG_DEBUG("Streamed {} bytes of audio, audioId:{}", audioData.ByteSizeLong(),
+                 audioData.audioid());
+  }
+  SPDLOG_INFO("Recording ended.");
+
+  stream->WritesDone();
+  recordingThread.join();
+  // Keep on rendering until the server sends its last transcript
+  renderingThread.join();
+  if (timeoutThread.joinable()) {
+    timeoutThread.join();
+  }
+
+  const auto status = stream->Finish();
+  if (!status.ok()) {
+    SPDLOG_ERROR("DecodeStream error: Error code:{}, details:{}", status.error_code(),
+                 status.error_message());
+  }
+  SPDLOG_DEBUG("Exiting...");
+}
+
+/**
+ * RistrettoClient::openStream
+ * @brief Starts a DecodeStream RPC. While the server is overloaded it's started again as soon as
+ * the server asks for
+ * @param context Made for every try, it has to outlive the returned stream
+ * @return nullptr if the server kept refusing it
+ */
+std::unique_ptr<RistrettoClient::AudioStream>
+RistrettoClient::openStream(std::unique_ptr<grpc::ClientContext>& context) {
+  for (unsigned int attempt = 0;; ++attempt) {
+    context = std::make_unique<grpc::ClientContext>();
+    auto stream = stub_->DecodeStream(context.get());
+    // The server sends its initial metadata as soon as it has decided whether to take the stream
+    stream->WaitForInitialMetadata();
+    const auto retryAfter = retryAfterHint(context->GetServerInitialMetadata());
+    if (!retryAfter) {
+      return stream;
+    }
+
+    stream->WritesDone();
+    const auto status = stream->Finish();
+    if (attempt == MaxOverloadRetries) {
+      SPDLOG_ERROR("DecodeStream was refused {} times, giving up:{}", attempt + 1,
+                   status.error_message());
+      return nullptr;
+    }
+    SPDLOG_WARN("DecodeStream was refused, trying again in {} ms:{}", retryAfter->count(),
+                status.error_message());
+    std::this_thread::sleep_for(*retryAfter);
+  }
+}
+
+/**
+ * RistrettoClient::retryWhenOverloaded
+ * @brief Puts audio that an overloaded server refused back in the input queue, it's sent again
+ * once the server's retry-after hint has passed. Audio that was captured in the meantime waits in
+ * the queue behind it
+ * @return false if the call wasn't refused for being overloaded or it was refused too many times
+ */
+bool RistrettoClient::retryWhenOverloaded(ClientCallData& call) {
+  if (call.status.error_code() != grpc::StatusCode::RESOURCE_EXHAUSTED) {
+    return false;
+  }
+  const auto retryAfter = retryAfterHint(call.context.GetServerTrailingMetadata());
+  if (!retryAfter) {
+    // Refused because of the session limit, trying again won't help
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(audioInputMutex_);
+  if (overloadRetries_ >= MaxOverloadRetries) {
+    SPDLOG_ERROR("Server refused audio {} times in a row, dropping audioId:{}", overloadRetries_,
+                 call.audioData.audioid());
+    return false;
+  }
+  ++overloadRetries_;
+  retryAt_ = std::max(retryAt_, std::chrono::steady_clock::now() + *retryAfter);
+  SPDLOG_WARN("Server is overloaded, sending audioId:{} again in {} ms", call.audioData.audioid(),
+              retryAfter->count());
+
+  // Only audio of a session the server hasn't admitted yet is refused. It's sent in front of anything
+  // with a later ID, the server holds later audio that got through until it arrives
+  const auto audioId = call.audioData.audioid();
+  const auto position =
+      std::find_if(audioInputQ_.begin(), audioInputQ_.end(),
+                   [audioId](const auto& queued) { return queued.audioid() > audioId; });
+  audioInputQ_.insert(position, std::move(call.audioData));
+  return true;
+}
+
+/**
+ * RistrettoClient::waitForRetryAfter
+ * @brief Sleeps until an overloaded server wants to hear from the client again
+ */
+void RistrettoClient::waitForRetryAfter() {
+  std::chrono::steady_clock::time_point retryAt;
+  {
+    std::lock_guard<std::mutex> lock(audioInputMutex_);
+    retryAt = retryAt_;
+  }
+  std::this_thread::sleep_until(retryAt);
+}
+
+/**
+ * RistrettoClient::takeAudioInput
+ * @brief Sleeps until recorded audio shows up in the input queue and takes the oldest chunk
+ * @return false once recording is done, every chunk was taken and every DecodeAudio call was
+ * answered, since refused audio is put back in the queue
+ */
+bool RistrettoClient::takeAudioInput(RistrettoProto::AudioData& audioData) {
+  std::unique_lock<std::mutex> lock(audioInputMutex_);
+  audioInputCv_.wait(lock, [this] {
+    return !audioInputQ_.empty() || (recordingDone_ && pendingCalls_ == 0);
+  });
+  if (audioInputQ_.empty()) {
+    return false;
+  }
+  audioData = std::move(audioInputQ_.front());
+  audioInputQ_.pop_front();
+  return true;
+}
+
+/**
+ * RistrettoClient::startRecordingTimeout
+ * @brief If configured, stops the recording after a while
+ */
+void RistrettoClient::startRecordingTimeout(std::thread& timeoutThread) {
+  if (recordingTimeout_.count() > 0) {
+    timeoutThread = std::thread(
+        [&recordingTimeout_ = recordingTimeout_, &continueRecording_ = continueRecording_] {
+          SPDLOG_INFO("Recording will end after {} milliseconds", recordingTimeout_.count());
+          std::this_thread::sleep_for(recordingTimeout_);
+          SPDLOG_INFO("Timeout hit, ending recording...");
+          continueRecording_.store(false);
+        });
+    SPDLOG_INFO("Started recording timeout thread");
+  }
+}
+
 /**
  * RistrettoClient::decodeAudioSync
  * @brief Simple function for decoding audio in a synchronous fashion
  */
-std::string RistrettoClient::decodeAudioSync(const std::vector<char>& audio, unsigned int audioId) {
+RistrettoProto::Transcript RistrettoClient::decodeAudioSync(const std::vector<char>& audio,
+                                                            unsigned int audioId) {
+  return sendAudioSync(audio, audioId, false);
+}
+
+/**
+ * RistrettoClient::decodeFileSync
+ * @brief Lets the server split the recording and decode the pieces in parallel, which is a lot
+ * faster for long recordings
+ */
+RistrettoProto::Transcript RistrettoClient::decodeFileSync(const std::vector<char>& audio) {
+  return sendAudioSync(audio, 0, true);
+}
+
+/**
+ * RistrettoClient::sendAudioSync
+ * @brief Sends a whole recording in one unary RPC and waits for its transcript
+ * @param isFile Use DecodeFile instead of DecodeAudio
+ */
+RistrettoProto::Transcript RistrettoClient::sendAudioSync(const std::vector<char>& audio,
+                                                          unsigned int audioId, bool isFile) {
 
   RistrettoProto::AudioData audioDataProto;
   audioDataProto.set_audio(audio.data(), audio.size());
   audioDataProto.set_audioid(audioId);
   audioDataProto.set_sessiontoken(sessionToken_);
+  // The whole recording is sent at once
+  audioDataProto.set_endofstream(true);
   SPDLOG_INFO("Sending {} bytes of audio", audioDataProto.ByteSizeLong());
   if (audioDataProto.ByteSizeLong() == 0) {
     SPDLOG_ERROR("audioDataProto is empty, abandoning RPC");
     return {};
   }
 
-  grpc::ClientContext context;
-  grpc::CompletionQueue resultCompletionQ;
-  grpc::Status status;
-
-  std::unique_ptr<grpc::ClientAsyncResponseReader<RistrettoProto::Transcript>> rpc(
-      stub_->AsyncDecodeAudio(&context, audioDataProto, &resultCompletionQ));
-
-  RistrettoProto::Transcript transcipt;
-  auto tag = reinterpret_cast<void*>(1);
-  rpc->Finish(&transcipt, &status, tag);
-  void* recieved_tag;
-  bool ok = false;
-  GPR_ASSERT(resultCompletionQ.Next(&recieved_tag, &ok));
-  GPR_ASSERT(recieved_tag == tag);
-  GPR_ASSERT(ok);
-
-  if (status.ok()) {
-    return transcipt.text();
-  } else {
-    SPDLOG_ERROR("Error with RPC: Error code:{}, details:{}", status.error_code(),
-                 status.error_message());
-    return {};
+  // Sent again for as long as the server is overloaded and asks for it
+  for (unsigned int attempt = 0;; ++attempt) {
+    grpc::ClientContext context;
+    grpc::CompletionQueue resultCompletionQ;
+    grpc::Status status;
+
+    std::unique_ptr<grpc::ClientAsyncResponseReader<RistrettoProto::Transcript>> rpc(
+        isFile ? stub_->AsyncDecodeFile(&context, audioDataProto, &resultCompletionQ)
+               : stub_->AsyncDecodeAudio(&context, audioDataProto, &resultCompletionQ));
+
+    RistrettoProto::Transcript transcipt;
+    auto tag = reinterpret_cast<void*>(1);
+    rpc->Finish(&transcipt, &status, tag);
+    void* recieved_tag;
+    bool ok = false;
+    GPR_ASSERT(resultCompletionQ.Next(&recieved_tag, &ok));
+    GPR_ASSERT(recieved_tag == tag);
+    GPR_ASSERT(ok);
+
+    if (status.ok()) {
+      return transcipt;
+    }
+    const auto retryAfter = status.error_code() == grpc::StatusCode::RESOURCE_EXHAUSTED
+                                ? retryAfterHint(context.GetServerTrailingMetadata())
+                                : std::nullopt;
+    if (!retryAfter || attempt == MaxOverloadRetries) {
+      SPDLOG_ERROR("Error with RPC: Error code:{}, details:{}", status.error_code(),
+                   status.error_message());
+      return {};
+    }
+    SPDLOG_WARN("Server is overloaded, sending the audio again in {} ms:{}", retryAfter->count(),
+                status.error_message());
+    std::this_thread::sleep_for(*retryAfter);
   }
 }
 
@@ -1,14 +1,20 @@
 #pragma once
 
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
 #include <memory>
 #include <mutex>
-#include <queue>
 #include <string>
 #include <string_view>
+#include <thread>
 
 #include <grpc++/grpc++.h>
 
 #include "AlsaInterface.hpp"
+#include "AudioCodec.hpp"
+#include "AudioProcessing.hpp"
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wuseless-cast" // NOLINT Clang-tidy is not aware of the warning
@@ -17,27 +23,84 @@
 
 namespace mik {
 
+struct ClientCallData;
+
+/// @brief The whole number of the server's decoder chunks nearest to the requested duration, at
+/// least one. Rounded up to whole milliseconds
+[[nodiscard]] std::chrono::milliseconds roundToServerChunks(std::chrono::milliseconds requested,
+                                                           uint32_t chunkSamples,
+                                                           uint32_t sampleRate);
+
 class RistrettoClient {
 public:
+  /// @brief Sample rate of the audio the server's models are trained on
+  static constexpr unsigned int DefaultServerSampleRate = 16000;
+
   explicit RistrettoClient(const std::shared_ptr<grpc::Channel>& channel,
                            AlsaConfig config = AlsaConfig());
-  std::string decodeAudioSync(const std::vector<char>& audio, unsigned int audioId = 0);
+  RistrettoProto::Transcript decodeAudioSync(const std::vector<char>& audio,
+                                             unsigned int audioId = 0);
+  RistrettoProto::Transcript decodeFileSync(const std::vector<char>& audio);
   void decodeMicrophoneInput();
+  void streamMicrophoneInput();
   void setRecordingDuration(std::chrono::milliseconds milliseconds) {
     this->recordingTimeout_ = milliseconds;
   };
+  /**
+   * @brief Asks the server what audio it takes, then captures at its sample rate and rounds the
+   * chunk duration to whole decoder chunks
+   * @return false if the server didn't answer, the client's own settings are kept
+   */
+  bool negotiateWithServer(std::chrono::milliseconds timeout = std::chrono::seconds(5));
+  /// @brief Microphone audio is downmixed and resampled to this before it's sent, it has to be
+  /// the rate the server's model was trained on
+  void setServerSampleRate(unsigned int sampleRate);
+  /// @brief Microphone audio is compressed with this, if the server takes it
+  void setAudioEncoding(AudioEncoding encoding) { this->encoding_ = encoding; }
+  /// @brief How much audio is sent at a time, shorter chunks get transcripts back sooner
+  void setChunkDuration(std::chrono::milliseconds milliseconds) {
+    this->chunkDuration_ = milliseconds;
+  };
+  [[nodiscard]] std::chrono::milliseconds chunkDuration() const noexcept { return chunkDuration_; }
+  [[nodiscard]] unsigned int serverSampleRate() const noexcept { return serverSampleRate_; }
+  [[nodiscard]] AudioEncoding audioEncoding() const noexcept { return encoding_; }
+  [[nodiscard]] const AlsaConfig& captureConfiguration() const noexcept {
+    return alsa_.getConfiguration();
+  }
 
 private:
+  using AudioStream =
+      grpc::ClientReaderWriter<RistrettoProto::AudioData, RistrettoProto::Transcript>;
+
+  RistrettoProto::Transcript sendAudioSync(const std::vector<char>& audio, unsigned int audioId,
+                                           bool isFile);
   void recordAudioChunks();
+  bool queueAudioChunk(unsigned int audioId, bool isLast = false);
   void renderResults();
-  std::chrono::milliseconds chunkDuration_ = std::chrono::milliseconds(1000);
+  bool retryWhenOverloaded(ClientCallData& call);
+  void waitForRetryAfter();
+  std::unique_ptr<AudioStream> openStream(std::unique_ptr<grpc::ClientContext>& context);
+  bool takeAudioInput(RistrettoProto::AudioData& audioData);
+  void startRecordingTimeout(std::thread& timeoutThread);
+  std::chrono::milliseconds chunkDuration_ = std::chrono::milliseconds(200);
 
   std::string sessionToken_;
 
   /// @brief Stores captured audio in preparation for sending
-  std::queue<RistrettoProto::AudioData> audioInputQ_;
+  std::deque<RistrettoProto::AudioData> audioInputQ_;
   /// @brief Used for modifying the audioInputQ
   std::mutex audioInputMutex_;
+  /// @brief Signalled when audio is queued and when recording is done
+  std::condition_variable audioInputCv_;
+  /// @brief No more audio will be queued, guarded by audioInputMutex_
+  bool recordingDone_ = false;
+  /// @brief DecodeAudio calls that haven't been answered, guarded by audioInputMutex_
+  size_t pendingCalls_ = 0;
+  /// @brief Refusals in a row from an overloaded server, guarded by audioInputMutex_
+  unsigned int overloadRetries_ = 0;
+  /// @brief Nothing is sent before this, as the overloaded server asked. Guarded by
+  /// audioInputMutex_
+  std::chrono::steady_clock::time_point retryAt_;
 
   /// @brief This is thread safe according to https://github.com/grpc/grpc/issues/4486
   grpc::CompletionQueue resultCompletionQ_;
@@ -50,9 +113,20 @@ private:
 
   AlsaConfig config_;
   AlsaInterface alsa_;
+  unsigned int serverSampleRate_ = DefaultServerSampleRate;
+  AudioEncoding encoding_ = AudioEncoding::Linear16;
+  /// @brief Only used by the recording thread
+  AudioPreprocessor preprocessor_;
+  /// @brief Only set when the audio is compressed, made for each recording
+  std::unique_ptr<AudioEncoder> encoder_;
+  std::string capturedAudio_;
+  std::string processedAudio_;
 };
 
 struct ClientCallData {
+  /// @brief Kept so it can be sent again if the server was overloaded
+  RistrettoProto::AudioData audioData;
+
   RistrettoProto::Transcript transcript;
 
   grpc::ClientContext context;
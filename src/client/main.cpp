@@ -9,7 +9,7 @@
 static constexpr auto Usage =
     R"(RistrettoClient - Automatic Speech Recognition client
 
-    Usage: RistrettoClient [--file <audio_file>] [--server <server_addr>] [--timeout <timeout_sec>]
+    Usage: RistrettoClient [--file <audio_file>] [--server <server_addr>] [--timeout <timeout_sec>] [--chunk-ms <ms>] [--sample-rate <hz>] [--encoding <codec>] [--stream] [--batch]
 
     Options:
           -h, --help     Show this screen.
@@ -17,6 +17,11 @@ static constexpr auto Usage =
           --file <audio_file>  pre-recorded audio file to send
           --timeout <timeout_sec>  how long to record for (in seconds)
           --server <server_addr>  ip and port of server   [default: 0.0.0.0:5050]
+          --chunk-ms <ms>  milliseconds of microphone audio to send at a time  [default: 200]
+          --sample-rate <hz>  rate microphone audio is resampled to if the server doesn't say  [default: 16000]
+          --encoding <codec>  pcm, flac or opus, microphone audio is compressed with it  [default: pcm]
+          --stream       stream microphone input and show temporary transcripts
+          --batch        with --file, have the server split the file and decode it in parallel
 )";
 
 /**
@@ -56,14 +61,27 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv) {
         return 1;
       }
 
-      const auto transcript = client.decodeAudioSync(audioData, 0);
-      if (transcript.empty()) {
+      const auto transcript = args[std::string("--batch")].asBool()
+                                  ? client.decodeFileSync(audioData)
+                                  : client.decodeAudioSync(audioData, 0);
+      if (transcript.text().empty()) {
         fmt::print("Response was empty!\n");
         SPDLOG_ERROR("Response was empty!");
         return 1;
       } else {
-        fmt::print("Transcript:{}\n", transcript);
-        SPDLOG_INFO("Transcript:{}", transcript);
+        for (const auto& segment : transcript.segments()) {
+          fmt::print("[{:.2f} - {:.2f}] {}\n", segment.starttime(), segment.endtime(),
+                     segment.text());
+          for (const auto& word : segment.words()) {
+            fmt::print("  [{:.2f} - {:.2f}] {} ({:.2f})\n", word.starttime(), word.endtime(),
+                       word.text(), word.confidence());
+          }
+          for (const auto& alternative : segment.alternatives()) {
+            fmt::print("  {:.2f}: {}\n", alternative.cost(), alternative.text());
+          }
+        }
+        fmt::print("Transcript:{}\n", transcript.text());
+        SPDLOG_INFO("Transcript:{}", transcript.text());
         return 0;
       }
 
@@ -74,8 +92,28 @@ int main([[maybe_unused]] int argc, [[maybe_unused]] char** argv) {
         const auto timeoutSec = std::chrono::seconds(timeout.asLong());
         client.setRecordingDuration(timeoutSec);
       }
+      client.setChunkDuration(std::chrono::milliseconds(args[std::string("--chunk-ms")].asLong()));
+      const auto encoding = mik::parseAudioEncoding(args[std::string("--encoding")].asString());
+      if (!encoding) {
+        fmt::print("Unknown encoding \"{}\"\n", args[std::string("--encoding")].asString());
+        return 1;
+      }
+      client.setAudioEncoding(*encoding);
+      if (!client.negotiateWithServer()) {
+        client.setServerSampleRate(
+            static_cast<unsigned int>(args[std::string("--sample-rate")].asLong()));
+        // Without the server's info there's no telling whether it takes compressed audio
+        if (*encoding != mik::AudioEncoding::Linear16) {
+          SPDLOG_WARN("Couldn't ask the server which encodings it takes, sending PCM instead");
+          client.setAudioEncoding(mik::AudioEncoding::Linear16);
+        }
+      }
       fmt::print("Processing microphone input\n");
-      client.decodeMicrophoneInput();
+      if (args[std::string("--stream")].asBool()) {
+        client.streamMicrophoneInput();
+      } else {
+        client.decodeMicrophoneInput();
+      }
     }
 
   } catch (const std::exception& e) {
@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <fmt/format.h>
+
+#include "AdmissionControl.hpp"
+
+namespace mik {
+namespace {
+
+/// @brief Weight of the newest sample in the moving averages of the load and real-time factor
+constexpr double SampleWeight = 0.5;
+/// @brief Jobs are much more frequent than samples so each one counts for less
+constexpr double JobWeight = 0.1;
+/// @brief Clients are never told to wait longer than this
+constexpr double MaxRetryAfterSecs = 30;
+
+} // namespace
+
+/**
+ * AdmissionController::AdmissionController
+ */
+AdmissionController::AdmissionController(AdmissionOptions options, size_t threadCount,
+                                         const Counter& audioSeconds,
+                                         const Counter& decodeSeconds)
+    : options_(options), threadCount_(static_cast<double>(std::max<size_t>(1, threadCount))),
+      audioSeconds_(audioSeconds), decodeSeconds_(decodeSeconds), lastSample_(Clock::now()),
+      lastAudioSeconds_(audioSeconds.value()), lastDecodeSeconds_(decodeSeconds.value()) {}
+
+/**
+ * AdmissionController::admit
+ */
+Admission AdmissionController::admit(bool isNewStream, size_t queuedJobs, Clock::time_point now) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  sample(now);
+  if (!isNewStream) {
+    return {};
+  }
+
+  const auto waitSecs = static_cast<double>(queuedJobs) * meanJobSeconds_ / threadCount_;
+  const auto maxWaitSecs = options_.maxQueueWaitMs / 1000.0;
+  if (options_.maxQueueWaitMs > 0 && waitSecs > maxWaitSecs) {
+    // Without anything new arriving the queue is short enough again after the difference
+    return {false, retryAfter(waitSecs - maxWaitSecs),
+            fmt::format("Server is overloaded, requests wait {:.1f} s to be decoded", waitSecs)};
+  }
+
+  // A live stream brings a second of audio every second, which takes its real-time factor to decode
+  const auto loadWithStream = load_ + realTimeFactor_ / threadCount_;
+  if (options_.maxLoad > 0 && loadWithStream > options_.maxLoad) {
+    // The load is only measured again after a sample period
+    return {false, retryAfter(2 * std::chrono::duration<double>(SamplePeriod).count()),
+            fmt::format("Server is overloaded, its decode threads are {:.0f}% busy", load_ * 100)};
+  }
+  return {};
+}
+
+/**
+ * AdmissionController::recordJob
+ */
+void AdmissionController::recordJob(double seconds) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  meanJobSeconds_ =
+      meanJobSeconds_ == 0 ? seconds : JobWeight * seconds + (1 - JobWeight) * meanJobSeconds_;
+}
+
+/**
+ * AdmissionController::load
+ */
+double AdmissionController::load() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return load_;
+}
+
+/**
+ * AdmissionController::realTimeFactor
+ */
+double AdmissionController::realTimeFactor() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return realTimeFactor_;
+}
+
+/**
+ * AdmissionController::estimatedWaitSeconds
+ */
+double AdmissionController::estimatedWaitSeconds(size_t queuedJobs) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return static_cast<double>(queuedJobs) * meanJobSeconds_ / threadCount_;
+}
+
+/**
+ * AdmissionController::sample
+ * @brief Updates the load and real-time factor from how much the totals grew since the last
+ * sample, mutex_ must be held
+ */
+void AdmissionController::sample(Clock::time_point now) {
+  if (now - lastSample_ < SamplePeriod) {
+    return;
+  }
+  const auto elapsedSecs = std::chrono::duration<double>(now - lastSample_).count();
+  const auto audioSecs = audioSeconds_.value();
+  const auto decodeSecs = decodeSeconds_.value();
+  const auto audio = audioSecs - lastAudioSeconds_;
+  const auto decoding = decodeSecs - lastDecodeSeconds_;
+
+  // A request that ran over several samples is counted in the one it finished in
+  const auto load = std::min(1.0, decoding / (elapsedSecs * threadCount_));
+  load_ = SampleWeight * load + (1 - SampleWeight) * load_;
+  if (audio > 0) {
+    realTimeFactor_ = realTimeFactor_ == 0
+                          ? decoding / audio
+                          : SampleWeight * decoding / audio + (1 - SampleWeight) * realTimeFactor_;
+  }
+
+  lastSample_ = now;
+  lastAudioSeconds_ = audioSecs;
+  lastDecodeSeconds_ = decodeSecs;
+}
+
+/**
+ * AdmissionController::retryAfter
+ */
+std::chrono::milliseconds AdmissionController::retryAfter(double seconds) const {
+  const auto milliseconds = std::ceil(std::min(seconds, MaxRetryAfterSecs) * 1000);
+  return std::chrono::milliseconds(
+      std::max(static_cast<int64_t>(milliseconds), int64_t{options_.minRetryAfterMs}));
+}
+
+} // namespace mik
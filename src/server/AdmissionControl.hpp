@@ -0,0 +1,95 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <string>
+
+#include "Metrics.hpp"
+
+namespace mik {
+
+/**
+ * AdmissionOptions
+ * @brief When the server stops taking on more work
+ */
+struct AdmissionOptions {
+  /// @brief New streams are refused once a new job is expected to wait longer than this for a
+  /// decode thread, 0 disables it
+  int maxQueueWaitMs = 2000;
+  /// @brief New streams are refused once they'd keep the decode threads busy for more than this
+  /// share of the time, 0 disables it
+  double maxLoad = 0.9;
+  /// @brief Clients are never told to retry sooner than this
+  int minRetryAfterMs = 500;
+};
+
+/**
+ * Admission
+ * @brief Whether a request may go ahead, and if not, when the client should try again
+ */
+struct Admission {
+  bool admitted = true;
+  std::chrono::milliseconds retryAfter{0};
+  /// @brief Why it was refused, sent back to the client
+  std::string reason;
+};
+
+/**
+ * AdmissionController
+ * @brief Refuses work that the decode threads can't keep up with, instead of letting the queue
+ * grow until every request is late. Both limits only refuse new streams, audio of a stream that
+ * was admitted is never refused since a refused chunk would leave a gap in its transcript:
+ * - How long a new job would wait for a thread, from the queue depth and how long jobs take
+ * - The measured load, the share of the threads' time spent decoding. A new stream adds its
+ *   real-time factor divided by the thread count to it
+ */
+class AdmissionController {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  /// @param audioSeconds,decodeSeconds Totals the decoders add to, their rates give the load
+  AdmissionController(AdmissionOptions options, size_t threadCount, const Counter& audioSeconds,
+                      const Counter& decodeSeconds);
+
+  /**
+   * @param isNewStream The request starts decoding audio that wasn't admitted before. Only those
+   * are checked, anything else is always admitted
+   * @param queuedJobs Jobs waiting for a decode thread
+   */
+  [[nodiscard]] Admission admit(bool isNewStream, size_t queuedJobs,
+                                Clock::time_point now = Clock::now());
+
+  /// @brief Called with how long each decode job ran, they're averaged to estimate the wait
+  void recordJob(double seconds);
+
+  /// @brief Share of the decode threads' time spent decoding, averaged over the last few seconds
+  [[nodiscard]] double load() const;
+  /// @brief Seconds spent decoding per second of audio, averaged over the last few seconds
+  [[nodiscard]] double realTimeFactor() const;
+  /// @brief Seconds a job that's submitted now is expected to wait for a thread
+  [[nodiscard]] double estimatedWaitSeconds(size_t queuedJobs) const;
+
+private:
+  /// @brief The counters are only updated when requests finish, so they're sampled this often
+  static constexpr auto SamplePeriod = std::chrono::seconds(1);
+
+  void sample(Clock::time_point now);
+  [[nodiscard]] std::chrono::milliseconds retryAfter(double seconds) const;
+
+  const AdmissionOptions options_;
+  const double threadCount_;
+  const Counter& audioSeconds_;
+  const Counter& decodeSeconds_;
+
+  mutable std::mutex mutex_;
+  Clock::time_point lastSample_;
+  double lastAudioSeconds_ = 0;
+  double lastDecodeSeconds_ = 0;
+  /// @brief Moving averages, 0 until there's been something to measure
+  double load_ = 0;
+  double realTimeFactor_ = 0;
+  double meanJobSeconds_ = 0;
+};
+
+} // namespace mik
@@ -0,0 +1,267 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#include <spdlog/spdlog.h>
+
+#include "AudioCodec.hpp"
+
+namespace mik {
+namespace {
+
+/// @brief Every Opus packet is preceded by its length
+constexpr size_t OpusLengthBytes = 2;
+/// @brief Longest audio that a single Opus packet can hold
+constexpr unsigned int OpusMaxPacketMs = 120;
+constexpr std::array<unsigned int, 5> OpusSampleRates = {8000, 12000, 16000, 24000, 48000};
+
+} // namespace
+
+/**
+ * isEncodingSupported
+ */
+bool isEncodingSupported(AudioEncoding encoding, unsigned int sampleRate) noexcept {
+  switch (encoding) {
+  case AudioEncoding::Linear16:
+  case AudioEncoding::Flac:
+    return true;
+  case AudioEncoding::Opus:
+    return std::find(OpusSampleRates.begin(), OpusSampleRates.end(), sampleRate) !=
+           OpusSampleRates.end();
+  }
+  return false;
+}
+
+/**
+ * makeAudioDecoder
+ */
+std::unique_ptr<AudioDecoder> makeAudioDecoder(AudioEncoding encoding, unsigned int sampleRate) {
+  if (!isEncodingSupported(encoding, sampleRate)) {
+    SPDLOG_ERROR("Encoding {} isn't supported at {} Hz", static_cast<int>(encoding), sampleRate);
+    return nullptr;
+  }
+  switch (encoding) {
+  case AudioEncoding::Flac:
+    return std::make_unique<FlacAudioDecoder>(sampleRate);
+  case AudioEncoding::Opus:
+    return std::make_unique<OpusAudioDecoder>(sampleRate);
+  case AudioEncoding::Linear16:
+    break;
+  }
+  return nullptr;
+}
+
+/**
+ * FlacAudioDecoder::FlacAudioDecoder
+ */
+FlacAudioDecoder::FlacAudioDecoder(unsigned int sampleRate)
+    : sampleRate_(sampleRate), decoder_(FLAC__stream_decoder_new()) {
+  if (decoder_ == nullptr) {
+    SPDLOG_ERROR("Couldn't allocate a FLAC decoder");
+    return;
+  }
+  const auto status = FLAC__stream_decoder_init_stream(
+      decoder_, &FlacAudioDecoder::readCallback, nullptr, nullptr, nullptr, nullptr,
+      &FlacAudioDecoder::writeCallback, nullptr, &FlacAudioDecoder::errorCallback, this);
+  if (status != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
+    SPDLOG_ERROR("Couldn't initialize the FLAC decoder:{}",
+                 FLAC__StreamDecoderInitStatusString[status]);
+    FLAC__stream_decoder_delete(decoder_);
+    decoder_ = nullptr;
+  }
+}
+
+/**
+ * FlacAudioDecoder::~FlacAudioDecoder
+ */
+FlacAudioDecoder::~FlacAudioDecoder() {
+  if (decoder_ != nullptr) {
+    FLAC__stream_decoder_delete(decoder_);
+  }
+}
+
+/**
+ * FlacAudioDecoder::decode
+ * @brief Decodes frame after frame until the read callback runs out of input and aborts. Since
+ * the input ends between two frames, flushing afterwards doesn't lose anything and leaves the
+ * decoder looking for the next frame's sync code
+ */
+bool FlacAudioDecoder::decode(std::string_view input, std::string* output) {
+  if (decoder_ == nullptr) {
+    return false;
+  } else if (input.empty()) {
+    // Flushing before the header arrived would make the decoder skip looking for it
+    return true;
+  }
+  input_ = input;
+  output_ = output;
+  failed_ = false;
+
+  while (FLAC__stream_decoder_process_single(decoder_)) {
+    // One metadata block or frame at a time, the write callback appends the frames
+  }
+
+  const auto state = FLAC__stream_decoder_get_state(decoder_);
+  if (state == FLAC__STREAM_DECODER_ABORTED) {
+    FLAC__stream_decoder_flush(decoder_);
+  } else {
+    SPDLOG_ERROR("FLAC decoder stopped in state {}, starting over",
+                 FLAC__StreamDecoderStateString[state]);
+    failed_ = true;
+    reset();
+  }
+
+  input_ = {};
+  output_ = nullptr;
+  return !failed_;
+}
+
+/**
+ * FlacAudioDecoder::reset
+ */
+void FlacAudioDecoder::reset() {
+  if (decoder_ != nullptr) {
+    FLAC__stream_decoder_reset(decoder_);
+  }
+}
+
+/**
+ * FlacAudioDecoder::readCallback
+ * @brief Hands the decoder as much of the current input as it asks for
+ */
+FLAC__StreamDecoderReadStatus FlacAudioDecoder::readCallback(const FLAC__StreamDecoder* decoder,
+                                                             FLAC__byte buffer[], size_t* bytes,
+                                                             void* clientData) {
+  auto& self = *static_cast<FlacAudioDecoder*>(clientData);
+  if (self.input_.empty()) {
+    const auto state = FLAC__stream_decoder_get_state(decoder);
+    if (state == FLAC__STREAM_DECODER_READ_FRAME || state == FLAC__STREAM_DECODER_READ_METADATA) {
+      SPDLOG_ERROR("FLAC audio ended in the middle of a frame, the frame is dropped");
+      self.failed_ = true;
+    }
+    *bytes = 0;
+    return FLAC__STREAM_DECODER_READ_STATUS_ABORT;
+  }
+
+  const auto count = std::min(*bytes, self.input_.size());
+  std::memcpy(buffer, self.input_.data(), count);
+  self.input_.remove_prefix(count);
+  *bytes = count;
+  return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+}
+
+/**
+ * FlacAudioDecoder::writeCallback
+ * @brief Appends a decoded frame, it has to be in the format the model takes
+ */
+FLAC__StreamDecoderWriteStatus
+FlacAudioDecoder::writeCallback([[maybe_unused]] const FLAC__StreamDecoder* decoder,
+                                const FLAC__Frame* frame, const FLAC__int32* const buffer[],
+                                void* clientData) {
+  auto& self = *static_cast<FlacAudioDecoder*>(clientData);
+  const auto& header = frame->header;
+  if (header.channels != 1 || header.bits_per_sample != 16 ||
+      header.sample_rate != self.sampleRate_) {
+    SPDLOG_ERROR("FLAC audio has to be 16-bit mono at {} Hz, got {}-bit with {} channels at {} Hz",
+                 self.sampleRate_, header.bits_per_sample, header.channels, header.sample_rate);
+    self.failed_ = true;
+    return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+  }
+
+  const auto offset = self.output_->size();
+  self.output_->resize(offset + header.blocksize * sizeof(int16_t));
+  auto* output = self.output_->data() + offset;
+  for (size_t i = 0; i < header.blocksize; ++i) {
+    const auto sample = static_cast<int16_t>(buffer[0][i]);
+    std::memcpy(output + i * sizeof(int16_t), &sample, sizeof(int16_t));
+  }
+  return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+}
+
+/**
+ * FlacAudioDecoder::errorCallback
+ */
+void FlacAudioDecoder::errorCallback([[maybe_unused]] const FLAC__StreamDecoder* decoder,
+                                     FLAC__StreamDecoderErrorStatus status, void* clientData) {
+  SPDLOG_WARN("FLAC decoding error:{}", FLAC__StreamDecoderErrorStatusString[status]);
+  static_cast<FlacAudioDecoder*>(clientData)->failed_ = true;
+}
+
+/**
+ * OpusAudioDecoder::OpusAudioDecoder
+ */
+OpusAudioDecoder::OpusAudioDecoder(unsigned int sampleRate)
+    : samples_(sampleRate * OpusMaxPacketMs / 1000) {
+  int error = OPUS_OK;
+  decoder_ = opus_decoder_create(static_cast<opus_int32>(sampleRate), 1, &error);
+  if (error != OPUS_OK) {
+    SPDLOG_ERROR("Couldn't create an Opus decoder at {} Hz:{}", sampleRate, opus_strerror(error));
+    decoder_ = nullptr;
+  }
+}
+
+/**
+ * OpusAudioDecoder::~OpusAudioDecoder
+ */
+OpusAudioDecoder::~OpusAudioDecoder() {
+  if (decoder_ != nullptr) {
+    opus_decoder_destroy(decoder_);
+  }
+}
+
+/**
+ * OpusAudioDecoder::decode
+ */
+bool OpusAudioDecoder::decode(std::string_view input, std::string* output) {
+  if (decoder_ == nullptr) {
+    return false;
+  }
+  std::string_view packets = input;
+  if (!partialPacket_.empty()) {
+    partialPacket_.append(input);
+    packets = partialPacket_;
+  }
+
+  bool ok = true;
+  size_t position = 0;
+  while (packets.size() - position >= OpusLengthBytes) {
+    const auto length = static_cast<size_t>(static_cast<uint8_t>(packets[position])) |
+                        static_cast<size_t>(static_cast<uint8_t>(packets[position + 1])) << 8;
+    if (packets.size() - position - OpusLengthBytes < length) {
+      break;
+    }
+    position += OpusLengthBytes;
+
+    // An empty packet would be decoded as a lost one and filled in with made up audio
+    if (length > 0) {
+      const int sampleCount = opus_decode(
+          decoder_, reinterpret_cast<const unsigned char*>(packets.data() + position),
+          static_cast<opus_int32>(length), samples_.data(), static_cast<int>(samples_.size()), 0);
+      if (sampleCount < 0) {
+        SPDLOG_ERROR("Couldn't decode an Opus packet:{}", opus_strerror(sampleCount));
+        ok = false;
+      } else {
+        output->append(reinterpret_cast<const char*>(samples_.data()),
+                       static_cast<size_t>(sampleCount) * sizeof(int16_t));
+      }
+    }
+    position += length;
+  }
+
+  // packets may be a view into partialPacket_, so the rest is copied out before it's overwritten
+  std::string rest(packets.substr(position));
+  partialPacket_ = std::move(rest);
+  return ok;
+}
+
+/**
+ * OpusAudioDecoder::reset
+ */
+void OpusAudioDecoder::reset() {
+  if (decoder_ != nullptr) {
+    opus_decoder_ctl(decoder_, OPUS_RESET_STATE);
+  }
+  partialPacket_.clear();
+}
+
+} // namespace mik
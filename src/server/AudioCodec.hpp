@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <FLAC/stream_decoder.h>
+#include <opus/opus.h>
+
+namespace mik {
+
+/// @brief How the audio in a request is encoded, mirrors RistrettoProto::AudioEncoding
+enum class AudioEncoding { Linear16, Flac, Opus };
+
+/// @brief Whether audio at the model's sample rate can be sent in this encoding
+[[nodiscard]] bool isEncodingSupported(AudioEncoding encoding, unsigned int sampleRate) noexcept;
+
+/**
+ * AudioDecoder
+ * @brief Turns a stream of compressed audio back into the little-endian int16 PCM the feature
+ * pipeline takes. The stream arrives in pieces and is decoded as each one comes in, so the state
+ * between them is kept until reset()
+ */
+class AudioDecoder {
+public:
+  virtual ~AudioDecoder() = default;
+
+  /// @brief Appends the decoded mono PCM to output
+  /// @return false if some of the input couldn't be decoded, whatever could be is still appended
+  virtual bool decode(std::string_view input, std::string* output) = 0;
+  /// @brief Drops the stream so that a new one can be decoded
+  virtual void reset() = 0;
+};
+
+/**
+ * FlacAudioDecoder
+ * @brief Lossless FLAC. The first piece starts with the stream's header, and every piece has to
+ * end on a frame boundary, which is how the encoder hands out its frames anyway
+ */
+class FlacAudioDecoder : public AudioDecoder {
+public:
+  explicit FlacAudioDecoder(unsigned int sampleRate);
+  FlacAudioDecoder(const FlacAudioDecoder&) = delete;
+  FlacAudioDecoder& operator=(const FlacAudioDecoder&) = delete;
+  ~FlacAudioDecoder() override;
+
+  bool decode(std::string_view input, std::string* output) override;
+  void reset() override;
+
+private:
+  static FLAC__StreamDecoderReadStatus readCallback(const FLAC__StreamDecoder* decoder,
+                                                    FLAC__byte buffer[], size_t* bytes,
+                                                    void* clientData);
+  static FLAC__StreamDecoderWriteStatus writeCallback(const FLAC__StreamDecoder* decoder,
+                                                      const FLAC__Frame* frame,
+                                                      const FLAC__int32* const buffer[],
+                                                      void* clientData);
+  static void errorCallback(const FLAC__StreamDecoder* decoder,
+                            FLAC__StreamDecoderErrorStatus status, void* clientData);
+
+  const unsigned int sampleRate_;
+  FLAC__StreamDecoder* decoder_;
+  /// @brief What the callbacks read from and write to during decode()
+  std::string_view input_;
+  std::string* output_ = nullptr;
+  bool failed_ = false;
+};
+
+/**
+ * OpusAudioDecoder
+ * @brief Low bitrate Opus. Each packet is preceded by its length as a little-endian uint16, a
+ * packet that's split between pieces is put back together
+ */
+class OpusAudioDecoder : public AudioDecoder {
+public:
+  explicit OpusAudioDecoder(unsigned int sampleRate);
+  OpusAudioDecoder(const OpusAudioDecoder&) = delete;
+  OpusAudioDecoder& operator=(const OpusAudioDecoder&) = delete;
+  ~OpusAudioDecoder() override;
+
+  bool decode(std::string_view input, std::string* output) override;
+  void reset() override;
+
+private:
+  OpusDecoder* decoder_;
+  /// @brief Room for the longest packet Opus allows, 120 ms
+  std::vector<int16_t> samples_;
+  /// @brief Start of a packet whose end hasn't arrived yet
+  std::string partialPacket_;
+};
+
+/// @return nullptr for Linear16, which doesn't need decoding, or an encoding that's not supported
+std::unique_ptr<AudioDecoder> makeAudioDecoder(AudioEncoding encoding, unsigned int sampleRate);
+
+} // namespace mik
@@ -0,0 +1,110 @@
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MIK_HAS_X86_SIMD 1
+#endif
+
+#include "AudioConversion.hpp"
+
+namespace mik {
+namespace {
+
+/// @brief Reads the sample at index i, unaligned since protobuf makes no promises about alignment
+inline int16_t loadSample(const char* input, size_t i) noexcept {
+  int16_t sample;
+  std::memcpy(&sample, input + i * sizeof(int16_t), sizeof(int16_t));
+  return sample;
+}
+
+/// @brief Converts samples [begin, sampleCount) and the trailing odd byte, if there is one
+void convertTail(std::string_view input, float* output, size_t begin) noexcept {
+  const size_t sampleCount = input.size() / 2;
+  for (size_t i = begin; i < sampleCount; ++i) {
+    output[i] = static_cast<float>(loadSample(input.data(), i));
+  }
+  if (input.size() % 2 != 0) {
+    output[sampleCount] = static_cast<float>(static_cast<uint8_t>(input.back()));
+  }
+}
+
+#ifdef MIK_HAS_X86_SIMD
+__attribute__((target("sse2"))) void convertSse2(std::string_view input, float* output) noexcept {
+  const size_t sampleCount = input.size() / 2;
+  const auto* in = reinterpret_cast<const __m128i*>(input.data());
+  size_t i = 0;
+  for (; i + 8 <= sampleCount; i += 8, ++in) {
+    const __m128i samples = _mm_loadu_si128(in);
+    // Put each int16 in the top half of an int32 then shift it back down to sign extend it
+    const __m128i low = _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16);
+    const __m128i high = _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16);
+    _mm_storeu_ps(output + i, _mm_cvtepi32_ps(low));
+    _mm_storeu_ps(output + i + 4, _mm_cvtepi32_ps(high));
+  }
+  convertTail(input, output, i);
+}
+
+__attribute__((target("avx2"))) void convertAvx2(std::string_view input, float* output) noexcept {
+  const size_t sampleCount = input.size() / 2;
+  const auto* in = reinterpret_cast<const __m128i*>(input.data());
+  size_t i = 0;
+  for (; i + 16 <= sampleCount; i += 16, in += 2) {
+    const __m256i low = _mm256_cvtepi16_epi32(_mm_loadu_si128(in));
+    const __m256i high = _mm256_cvtepi16_epi32(_mm_loadu_si128(in + 1));
+    _mm256_storeu_ps(output + i, _mm256_cvtepi32_ps(low));
+    _mm256_storeu_ps(output + i + 8, _mm256_cvtepi32_ps(high));
+  }
+  convertTail(input, output, i);
+}
+#endif
+
+} // namespace
+
+/**
+ * detectSimdLevel
+ */
+SimdLevel detectSimdLevel() noexcept {
+#ifdef MIK_HAS_X86_SIMD
+  static const SimdLevel simdLevel = [] {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      return SimdLevel::Avx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+      return SimdLevel::Sse2;
+    }
+    return SimdLevel::Scalar;
+  }();
+  return simdLevel;
+#else
+  return SimdLevel::Scalar;
+#endif
+}
+
+/**
+ * int16ToFloat
+ */
+void int16ToFloat(std::string_view input, float* output) noexcept {
+  int16ToFloat(input, output, detectSimdLevel());
+}
+
+/**
+ * int16ToFloat
+ */
+void int16ToFloat(std::string_view input, float* output, SimdLevel simdLevel) noexcept {
+  switch (simdLevel) {
+#ifdef MIK_HAS_X86_SIMD
+  case SimdLevel::Avx2:
+    convertAvx2(input, output);
+    return;
+  case SimdLevel::Sse2:
+    convertSse2(input, output);
+    return;
+#endif
+  default:
+    convertTail(input, output, 0);
+    return;
+  }
+}
+
+} // namespace mik
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+namespace mik {
+
+/// @brief Instruction sets that the PCM conversion can be done with
+enum class SimdLevel { Scalar, Sse2, Avx2 };
+
+/// @brief Best instruction set supported by the CPU this is running on, checked once
+[[nodiscard]] SimdLevel detectSimdLevel() noexcept;
+
+/**
+ * @brief Converts little-endian int16 PCM straight from the raw bytes into floats. A trailing odd
+ * byte becomes the low half of a final sample whose high half is 0
+ * @param output Must have room for (input.size() + 1) / 2 floats
+ */
+void int16ToFloat(std::string_view input, float* output) noexcept;
+
+/// @brief Same as above but with a specific instruction set, it must be supported by the CPU
+void int16ToFloat(std::string_view input, float* output, SimdLevel simdLevel) noexcept;
+
+} // namespace mik
@@ -0,0 +1,81 @@
+#include <algorithm>
+
+#include <spdlog/spdlog.h>
+
+#include "AudioReorder.hpp"
+
+namespace mik {
+
+/**
+ * AudioReorderBuffer::push
+ */
+bool AudioReorderBuffer::push(uint32_t audioId, PendingAudio audio, Clock::time_point now) {
+  if (audioId == 0) {
+    // Audio held before audioId 0 arrived belongs to the new stream
+    if (nextAudioId_ > 0 && !pendingAudio_.empty()) {
+      SPDLOG_INFO("audioId 0 starts a new stream, dropping {} held chunks of the previous one",
+                  pendingAudio_.size());
+      pendingAudio_.clear();
+    }
+    nextAudioId_ = 0;
+  } else if (audioId < nextAudioId_) {
+    SPDLOG_WARN("audioId {} was already decoded, expected audioId {}. Dropping it", audioId,
+                nextAudioId_);
+    return false;
+  }
+
+  if (!pendingAudio_.emplace(audioId, std::move(audio)).second) {
+    SPDLOG_WARN("audioId {} is already waiting to be decoded. Dropping it", audioId);
+    return false;
+  }
+  if (audioId == nextAudioId_) {
+    return true;
+  }
+  SPDLOG_DEBUG("Holding audioId {} until audioId {} is decoded", audioId, nextAudioId_);
+
+  const auto oldest = std::min_element(
+      pendingAudio_.begin(), pendingAudio_.end(),
+      [](const auto& lhs, const auto& rhs) { return lhs.second.received < rhs.second.received; });
+  const bool timedOut = readTimeoutSecs_ >= 0 && now - oldest->second.received >
+                                                     std::chrono::seconds(readTimeoutSecs_);
+  if (timedOut || pendingAudio_.size() > MaxPendingAudio) {
+    SPDLOG_WARN("Gave up waiting for audioId {}, continuing at audioId {}", nextAudioId_,
+                pendingAudio_.begin()->first);
+    nextAudioId_ = pendingAudio_.begin()->first;
+  }
+  return true;
+}
+
+/**
+ * AudioReorderBuffer::pop
+ */
+std::optional<std::pair<uint32_t, PendingAudio>> AudioReorderBuffer::pop() {
+  if (pendingAudio_.empty() || pendingAudio_.begin()->first != nextAudioId_) {
+    return std::nullopt;
+  }
+  auto node = pendingAudio_.extract(pendingAudio_.begin());
+  // Whatever happens to this audio, the audio after it is next
+  nextAudioId_ = node.key() + 1;
+  return std::make_pair(node.key(), std::move(node.mapped()));
+}
+
+/**
+ * AudioReorderBuffer::skipMissing
+ */
+void AudioReorderBuffer::skipMissing() {
+  if (!pendingAudio_.empty() && pendingAudio_.begin()->first > nextAudioId_) {
+    SPDLOG_WARN("Skipping audioId {} to {}, continuing at audioId {}", nextAudioId_,
+                pendingAudio_.begin()->first - 1, pendingAudio_.begin()->first);
+    nextAudioId_ = pendingAudio_.begin()->first;
+  }
+}
+
+/**
+ * AudioReorderBuffer::clear
+ */
+void AudioReorderBuffer::clear() {
+  nextAudioId_ = 0;
+  pendingAudio_.clear();
+}
+
+} // namespace mik
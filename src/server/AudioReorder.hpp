@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "AudioCodec.hpp"
+
+namespace mik {
+
+/**
+ * PendingAudio
+ * @brief A session's audio while it waits for its turn to be decoded
+ */
+struct PendingAudio {
+  /// @brief Null for audio that won't be decoded, it only moves the stream along
+  std::unique_ptr<std::string> audio;
+  bool endOfStream = false;
+  AudioEncoding encoding = AudioEncoding::Linear16;
+  std::chrono::steady_clock::time_point received;
+};
+
+/**
+ * AudioReorderBuffer
+ * @brief Puts a session's audio back in the order of its audioIds. Audio that arrives ahead of the
+ * audio before it is held, and given up on once too much is held or the oldest was held for longer
+ * than the read timeout. Not thread-safe, the session's lock has to be held
+ */
+class AudioReorderBuffer {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  /// @brief Audio that's held at most, once there's more the missing audio is given up on
+  static constexpr size_t MaxPendingAudio = 16;
+
+  /// @param readTimeoutSecs How long audio is held for, -1 to only give up once too much is held
+  explicit AudioReorderBuffer(int readTimeoutSecs) : readTimeoutSecs_(readTimeoutSecs) {}
+
+  /**
+   * @brief audioId 0 starts a new stream and drops what's held of the previous one
+   * @return false if the audio was dropped since it was already passed or is already held
+   */
+  bool push(uint32_t audioId, PendingAudio audio, Clock::time_point now = Clock::now());
+  /// @brief The audio that's next in line if it arrived, the one after it is next then
+  [[nodiscard]] std::optional<std::pair<uint32_t, PendingAudio>> pop();
+  /// @brief Gives up on the missing audio, decoding continues at the first audio that's held
+  void skipMissing();
+  void clear();
+
+  [[nodiscard]] uint32_t nextAudioId() const noexcept { return nextAudioId_; }
+  [[nodiscard]] size_t heldCount() const noexcept { return pendingAudio_.size(); }
+
+private:
+  const int readTimeoutSecs_;
+  /// @brief audioId that's expected to be decoded next
+  uint32_t nextAudioId_ = 0;
+  /// @brief Audio that's waiting, keyed by audioId
+  std::map<uint32_t, PendingAudio> pendingAudio_;
+};
+
+} // namespace mik
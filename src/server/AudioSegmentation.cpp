@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+
+#include "AudioSegmentation.hpp"
+
+namespace mik {
+namespace {
+
+/// @brief Length of a duration in frames, at least 1
+size_t toFrames(float secs, size_t frameLength, float sampleRate) {
+  const auto frames = std::lround(secs * sampleRate / static_cast<float>(frameLength));
+  return static_cast<size_t>(std::max(1L, frames));
+}
+
+/// @brief Mean power of every frame in dB relative to full scale
+std::vector<float> frameEnergies(std::string_view audio, size_t frameLength) {
+  const size_t sampleCount = audio.size() / sizeof(int16_t);
+  const size_t frameCount = (sampleCount + frameLength - 1) / frameLength;
+  constexpr double FullScale = -static_cast<double>(std::numeric_limits<int16_t>::min());
+  // Keeps digital silence finite
+  constexpr double PowerFloor = 1e-10;
+
+  std::vector<float> energies(frameCount);
+  for (size_t frame = 0; frame < frameCount; ++frame) {
+    const size_t begin = frame * frameLength;
+    const size_t end = std::min(begin + frameLength, sampleCount);
+    double sumOfSquares = 0;
+    for (size_t i = begin; i < end; ++i) {
+      int16_t sample;
+      std::memcpy(&sample, audio.data() + i * sizeof(int16_t), sizeof(int16_t));
+      sumOfSquares += static_cast<double>(sample) * sample;
+    }
+    const double power = sumOfSquares / static_cast<double>(end - begin) / (FullScale * FullScale);
+    energies[frame] = static_cast<float>(10 * std::log10(std::max(power, PowerFloor)));
+  }
+  return energies;
+}
+
+} // namespace
+
+/**
+ * splitAtSilence
+ * @brief Segments are cut in the middle of the first long enough silence after they've reached the
+ * minimum length, or at the quietest frame of their second half when they hit the maximum length
+ */
+std::vector<AudioSpan> splitAtSilence(std::string_view audio, const SegmentationOptions& options) {
+  const size_t sampleCount = audio.size() / sizeof(int16_t);
+  if (sampleCount == 0) {
+    return {};
+  }
+
+  const auto frameLength =
+      static_cast<size_t>(std::max(1L, std::lround(options.frameSecs * options.sampleRate)));
+  const auto energies = frameEnergies(audio, frameLength);
+  const size_t frameCount = energies.size();
+  const auto minSilenceFrames = toFrames(options.minSilenceSecs, frameLength, options.sampleRate);
+  const auto minSegmentFrames = toFrames(options.minSegmentSecs, frameLength, options.sampleRate);
+  const size_t maxSegmentFrames =
+      options.maxSegmentSecs > 0
+          ? std::max(2 * minSilenceFrames,
+                     toFrames(options.maxSegmentSecs, frameLength, options.sampleRate))
+          : std::numeric_limits<size_t>::max();
+
+  // Cuts are frame indices, each one starts a new segment
+  std::vector<size_t> cuts;
+  size_t segmentStart = 0;
+  // Start of the silence the current frame is in, or frameCount when it's not silent
+  size_t silenceStart = frameCount;
+  for (size_t frame = 0; frame < frameCount; ++frame) {
+    if (energies[frame] < options.silenceThresholdDb) {
+      silenceStart = std::min(silenceStart, frame);
+    } else if (silenceStart != frameCount) {
+      const size_t silenceLength = frame - silenceStart;
+      const size_t middle = silenceStart + silenceLength / 2;
+      if (silenceLength >= minSilenceFrames && middle - segmentStart >= minSegmentFrames) {
+        cuts.push_back(middle);
+        segmentStart = middle;
+      }
+      silenceStart = frameCount;
+    }
+
+    if (frame + 1 - segmentStart >= maxSegmentFrames) {
+      const float* searchBegin = energies.data() + segmentStart + (frame + 1 - segmentStart) / 2;
+      const float* quietest = std::min_element(searchBegin, energies.data() + frame + 1);
+      segmentStart = static_cast<size_t>(quietest - energies.data());
+      cuts.push_back(segmentStart);
+      if (silenceStart != frameCount) {
+        silenceStart = std::max(silenceStart, segmentStart);
+      }
+    }
+  }
+
+  std::vector<AudioSpan> spans;
+  spans.reserve(cuts.size() + 1);
+  size_t begin = 0;
+  for (const auto cut : cuts) {
+    const size_t end = cut * frameLength;
+    spans.push_back({begin, end});
+    begin = end;
+  }
+  spans.push_back({begin, sampleCount});
+  return spans;
+}
+
+} // namespace mik
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+namespace mik {
+
+/**
+ * SegmentationOptions
+ * @brief Where a long recording may be split so that the pieces can be decoded independently
+ */
+struct SegmentationOptions {
+  float sampleRate = 16000;
+  /// @brief Energy is measured over frames of this many seconds
+  float frameSecs = 0.01f;
+  /// @brief Frames quieter than this, in dB relative to full scale, are silence
+  float silenceThresholdDb = -45;
+  /// @brief Only silence that lasts at least this many seconds is split at
+  float minSilenceSecs = 0.3f;
+  /// @brief Segments aren't split at silence before they're this long, short ones don't give the
+  /// decoder enough context
+  float minSegmentSecs = 15;
+  /// @brief Segments that don't have a long enough silence are split at their quietest frame once
+  /// they're this long, 0 means no limit
+  float maxSegmentSecs = 60;
+};
+
+/// @brief Samples [begin, end) of a recording
+struct AudioSpan {
+  size_t begin = 0;
+  size_t end = 0;
+};
+
+/**
+ * @brief Splits little-endian int16 PCM into consecutive segments, cutting in the middle of
+ * silences. A trailing odd byte is left out
+ * @return Spans that cover every sample in order, empty if there's no audio
+ */
+[[nodiscard]] std::vector<AudioSpan> splitAtSilence(std::string_view audio,
+                                                    const SegmentationOptions& options);
+
+} // namespace mik
@@ -0,0 +1,93 @@
+#include <cctype>
+#include <fstream>
+
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+
+#include "ConfigFile.hpp"
+
+namespace mik {
+namespace {
+
+/// @brief numDecodeThreads -> num-decode-threads
+std::string toOptionName(const std::string& parameterName) {
+  std::string optionName;
+  for (const char c : parameterName) {
+    if (std::isupper(static_cast<unsigned char>(c))) {
+      optionName.push_back('-');
+      optionName.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(c))));
+    } else {
+      optionName.push_back(c);
+    }
+  }
+  return optionName;
+}
+
+bool isOption(const std::string& arg) { return arg.rfind("--", 0) == 0; }
+
+} // namespace
+
+/**
+ * readConfigFile
+ */
+std::optional<ConfigFileArgs> readConfigFile(const std::filesystem::path& path) {
+  std::ifstream file(path);
+  if (!file) {
+    SPDLOG_ERROR("Couldn't open server config {}", path.string());
+    return std::nullopt;
+  }
+
+  try {
+    const auto config = nlohmann::json::parse(file);
+    ConfigFileArgs args;
+
+    // Each parameter is its own object so that they can be described one by one
+    for (const auto& parameters : config.value("serverParameters", nlohmann::json::array())) {
+      for (const auto& [name, parameter] : parameters.items()) {
+        const auto& value = parameter.at("value");
+        const auto valueString = value.is_string() ? value.get<std::string>() : value.dump();
+        args.options.emplace_back("--" + toOptionName(name) + "=" + valueString);
+      }
+    }
+
+    for (const auto& arg : config.value("kaldiCommandLineArgs", nlohmann::json::array())) {
+      auto argString = arg.get<std::string>();
+      if (isOption(argString)) {
+        args.options.emplace_back(std::move(argString));
+      } else {
+        args.positionals.emplace_back(std::move(argString));
+      }
+    }
+    return args;
+
+  } catch (const nlohmann::json::exception& e) {
+    SPDLOG_ERROR("Invalid server config {}: {}", path.string(), e.what());
+    return std::nullopt;
+  }
+}
+
+/**
+ * mergeArgs
+ */
+std::vector<std::string> mergeArgs(const ConfigFileArgs& fileArgs,
+                                   const std::vector<std::string>& commandLine) {
+  std::vector<std::string> merged;
+  if (!commandLine.empty()) {
+    merged.push_back(commandLine.front());
+  }
+  merged.insert(merged.end(), fileArgs.options.begin(), fileArgs.options.end());
+
+  // Options come first, like Kaldi's parser expects
+  auto argIt = commandLine.begin() + (commandLine.empty() ? 0 : 1);
+  for (; argIt != commandLine.end() && isOption(*argIt); ++argIt) {
+    merged.push_back(*argIt);
+  }
+  if (argIt != commandLine.end()) {
+    merged.insert(merged.end(), argIt, commandLine.end());
+  } else {
+    merged.insert(merged.end(), fileArgs.positionals.begin(), fileArgs.positionals.end());
+  }
+  return merged;
+}
+
+} // namespace mik
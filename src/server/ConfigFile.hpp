@@ -0,0 +1,38 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace mik {
+
+/**
+ * ConfigFileArgs
+ * @brief A serverConfig.json turned into command line arguments, so that it goes through the same
+ * option parsing as the command line does
+ */
+struct ConfigFileArgs {
+  /// @brief --name=value for every server parameter followed by the Kaldi options
+  std::vector<std::string> options;
+  /// @brief Model, FST and word symbol table
+  std::vector<std::string> positionals;
+};
+
+/**
+ * @brief Reads the "serverParameters" and "kaldiCommandLineArgs" of a server config. Parameter
+ * names are camelCase versions of the command line options, e.g. numDecodeThreads is
+ * --num-decode-threads
+ * @return std::nullopt if the file can't be read or isn't laid out like a server config
+ */
+[[nodiscard]] std::optional<ConfigFileArgs> readConfigFile(const std::filesystem::path& path);
+
+/**
+ * @brief Puts the config file's arguments in front of the command line's so that the command line
+ * overrides them. The command line's positional arguments replace the file's if it has any
+ * @param commandLine Starts with the program name
+ */
+[[nodiscard]] std::vector<std::string> mergeArgs(const ConfigFileArgs& fileArgs,
+                                                 const std::vector<std::string>& commandLine);
+
+} // namespace mik
@@ -24,6 +24,7 @@
 #include "feat/wave-reader.h"
 #include "fstext/fstext-lib.h"
 #include "lat/lattice-functions.h"
+#include "lat/sausages.h"
 #include "nnet3/nnet-utils.h"
 #include "online2/online-endpoint.h"
 #include "online2/online-nnet2-feature-pipeline.h"
@@ -32,14 +33,63 @@
 #include "online2/onlinebin-util.h"
 #include "util/kaldi-thread.h"
 
-#include <cstring>
+#include <fmt/format.h>
 #include <spdlog/spdlog.h>
+#include <chrono>
 #include <string>
+#include <type_traits>
 
+#include "AudioConversion.hpp"
 #include "KaldiInterface.hpp"
+#include "MappedFst.hpp"
+#include "NnetBatchScheduler.hpp"
 
 using namespace kaldi;
 namespace mik {
+namespace {
+
+/// @brief output has to have exactly one element per (rounded up) pair of bytes
+void int16ToKaldi(std::string_view audioData, VectorBase<BaseFloat>* output) {
+  if constexpr (std::is_same_v<BaseFloat, float>) {
+    int16ToFloat(audioData, output->Data());
+  } else {
+    // Kaldi was built with double precision, there's no vectorized path for that
+    for (MatrixIndexT i = 0; i < output->Dim(); ++i) {
+      float sample;
+      int16ToFloat(audioData.substr(static_cast<size_t>(i) * 2, 2), &sample, SimdLevel::Scalar);
+      (*output)(i) = sample;
+    }
+  }
+}
+
+/// @brief Text of the index'th word, words that aren't in the symbol table become "<#index>"
+std::string wordToString(const std::vector<int32>& words, size_t index,
+                         const fst::SymbolTable& wordSyms) {
+  std::string word = wordSyms.Find(words[index]);
+  if (word.empty()) {
+    KALDI_WARN << "Word-id " << words[index] << " not in symbol table.";
+    word = "<#" + std::to_string(index) + ">";
+  }
+  return word;
+}
+
+/// @brief Words are separated and followed by a space, like the transcripts have always been
+std::string wordsToString(const std::vector<int32>& words, const fst::SymbolTable& wordSyms) {
+  std::string text;
+  for (size_t i = 0; i < words.size(); i++) {
+    text += wordToString(words, i, wordSyms);
+    text += ' ';
+  }
+  return text;
+}
+
+/// @brief Segments are joined with a single space, so they mustn't end in one
+void trimTrailingSpaces(std::string* text) {
+  const auto end = text->find_last_not_of(' ');
+  text->erase(end == std::string::npos ? 0 : end + 1);
+}
+
+} // namespace
 
 /**
  * stringToKaldiVector
@@ -49,198 +99,296 @@ Vector<BaseFloat> stringToKaldiVector(std::unique_ptr<std::string> audioDataPtr)
   if (!audioDataPtr) {
     SPDLOG_ERROR("audioDataPtr was null!");
     return {};
-  } else if (audioDataPtr->empty()) {
+  }
+  return stringToKaldiVector(std::string_view(*audioDataPtr));
+}
+
+/**
+ * stringToKaldiVector
+ * @brief Converts the bytes in a single pass without copying them anywhere first. An odd length
+ * is treated as if it had an extra 0x00 at the end
+ */
+Vector<BaseFloat> stringToKaldiVector(std::string_view audioData) {
+  if (audioData.empty()) {
     SPDLOG_ERROR("audioData was empty!");
     return {};
   }
-  if (audioDataPtr->length() % 2 != 0) {
-    // Length is odd, just add an empty value to the end so the bitshifting logic won't be broken
-    audioDataPtr->push_back(0x0);
-  }
 
-  const size_t inputLength = audioDataPtr->length();
-  const size_t outputLength = inputLength / 2;
+  const auto outputLength = static_cast<MatrixIndexT>((audioData.length() + 1) / 2);
+  Vector<BaseFloat> audio_data_float(outputLength, kUndefined);
+  int16ToKaldi(audioData, &audio_data_float);
+  return audio_data_float;
+}
 
-  std::vector<int16_t> buffer_int16(outputLength);
-  if (!std::memmove(buffer_int16.data(), audioDataPtr->data(), audioDataPtr->length())) {
-    SPDLOG_ERROR("Could not memmove audio data into int16 buffer!");
-    return {};
+/**
+ * stringToKaldiVector
+ * @brief Converts into buffer, which is only reallocated when the audio doesn't fit in it
+ * @return View of the converted audio, only valid until buffer is used again
+ */
+SubVector<BaseFloat> stringToKaldiVector(std::string_view audioData, Vector<BaseFloat>* buffer) {
+  const auto outputLength = static_cast<MatrixIndexT>((audioData.length() + 1) / 2);
+  if (buffer->Dim() < outputLength) {
+    buffer->Resize(outputLength, kUndefined);
   }
+  SubVector<BaseFloat> audio(*buffer, 0, outputLength);
+  int16ToKaldi(audioData, &audio);
+  return audio;
+}
 
-  // These vectors have the same number of elements
-  Vector<BaseFloat> audio_data_float(static_cast<MatrixIndexT>(buffer_int16.size()), kUndefined);
+/**
+ * Nnet3Data::decodeAudio
+ * @brief Feeds audio into the session's live decoder. Audio from consecutive calls is treated as
+ * one continuous stream, the utterance is only finalized on an endpoint or at the end of the stream
+ * @param audioId Position of this audio in the stream, 0 starts a new stream
+ * @param endOfStream No more audio will follow, finalize whatever is left
+ * @param encoding Compressed audio is decoded in order with the rest of the stream
+ */
+std::vector<TranscriptSegment>
+Nnet3Data::decodeAudio(const std::string& sessionToken, uint32_t audioId,
+                       std::unique_ptr<std::string> audioDataPtr, bool endOfStream,
+                       const TranscriptCallback& onTranscript, AudioEncoding encoding,
+                       DecodeError* error) {
+
+  SPDLOG_INFO("decodeAudio sessionToken:{}, audioId:{}, endOfStream:{}", sessionToken, audioId,
+              endOfStream);
+  SPDLOG_TRACE("Getting lock on mutex...");
+  // No idea how thread-safe Kaldi is so naively lock at the beginning of this method
+  std::lock_guard<std::mutex> lock(decoderMutex_);
+  SPDLOG_TRACE("Got lock");
 
-  for (int i = 0; i < audio_data_float.Dim(); ++i) {
-    // Convert each int16 into a BaseFloat
-    audio_data_float(i) = static_cast<BaseFloat>(buffer_int16[static_cast<size_t>(i)]);
+  std::vector<TranscriptSegment> segments;
+  if (audioId != 0) {
+    // Decoded after audio that was skipped, nobody got them yet
+    segments.swap(undeliveredSegments_);
   }
-
-  return audio_data_float;
+  const auto decodeError = acceptAudio(
+      audioId, {std::move(audioDataPtr), endOfStream, encoding, std::chrono::steady_clock::now()},
+      segments, onTranscript);
+  if (error) {
+    *error = decodeError;
+  }
+  return segments;
 }
 
 /**
- * Nnet3Data::decodeAudio
+ * Nnet3Data::skipAudio
+ * @brief Takes the audio's place in line without any audio, so the audio after it is decoded
+ * when its turn comes instead of after --read-timeout
  */
-std::string Nnet3Data::decodeAudio(const std::string& sessionToken, uint32_t audioId,
-                                   std::unique_ptr<std::string> audioDataPtr) {
+void Nnet3Data::skipAudio(const std::string& sessionToken, uint32_t audioId, bool endOfStream) {
+  SPDLOG_INFO("skipAudio sessionToken:{}, audioId:{}, endOfStream:{}", sessionToken, audioId,
+              endOfStream);
+  std::lock_guard<std::mutex> lock(decoderMutex_);
+  acceptAudio(audioId, {nullptr, endOfStream, AudioEncoding::Linear16,
+                        std::chrono::steady_clock::now()},
+              undeliveredSegments_, {});
+}
 
-  SPDLOG_INFO("decodeAudio sessionToken:{}, audioId:{}", sessionToken, audioId);
-  const Vector<BaseFloat> complete_audio_data = stringToKaldiVector(std::move(audioDataPtr));
-  SPDLOG_DEBUG("complete_audio_data size in bytes:{}, number of elements:{}",
-               complete_audio_data.SizeInBytes(), complete_audio_data.Dim());
+/**
+ * Nnet3Data::finishStream
+ * @brief Finalizes the current utterance since no more audio will come in for this stream. Audio
+ * that's still held won't get the audio it's missing anymore, so it's decoded first
+ */
+std::vector<TranscriptSegment> Nnet3Data::finishStream(const std::string& sessionToken,
+                                                       const TranscriptCallback& onTranscript,
+                                                       DecodeError* error) {
+  SPDLOG_INFO("finishStream sessionToken:{}", sessionToken);
+  std::lock_guard<std::mutex> lock(decoderMutex_);
+  std::vector<TranscriptSegment> segments;
+  segments.swap(undeliveredSegments_);
+  auto pendingError = DecodeError::None;
+  while (pendingAudio_.heldCount() > 0) {
+    SPDLOG_WARN("Stream ended without audioId {}, decoding the {} chunks held after it",
+                pendingAudio_.nextAudioId(), pendingAudio_.heldCount());
+    pendingAudio_.skipMissing();
+    const auto heldError = decodePendingAudio(segments, onTranscript);
+    if (pendingError == DecodeError::None) {
+      pendingError = heldError;
+    }
+  }
+  const auto finishError = decodeChunk(pendingAudio_.nextAudioId(), nullptr, true,
+                                       AudioEncoding::Linear16, segments, onTranscript);
+  if (error) {
+    *error = pendingError != DecodeError::None ? pendingError : finishError;
+  }
+  return segments;
+}
 
-  SPDLOG_DEBUG("Getting lock on mutex...");
-  // No idea how thread-safe Kaldi is so naively lock at the beginning of this method
+/**
+ * Nnet3Data::reset
+ */
+void Nnet3Data::reset() {
   std::lock_guard<std::mutex> lock(decoderMutex_);
-  SPDLOG_DEBUG("Got lock");
+  pendingAudio_.clear();
+  undeliveredSegments_.clear();
+  startStream();
+}
 
-  decoderPtr_->InitDecoding(frameOffset_);
-  SPDLOG_INFO("Initialized decoding");
+/**
+ * Nnet3Data::acceptAudio
+ * @brief Puts the audio in line and decodes whatever's next, decoderMutex_ must be held
+ * @return The first error, the rest of the audio is still decoded after it
+ */
+DecodeError Nnet3Data::acceptAudio(uint32_t audioId, PendingAudio pending,
+                                   std::vector<TranscriptSegment>& segments,
+                                   const TranscriptCallback& onTranscript) {
+  if (audioId == 0) {
+    undeliveredSegments_.clear();
+    if (sampCount > 0 || frameOffset_ > 0) {
+      SPDLOG_INFO("audioId 0 starts a new stream, dropping the previous one");
+      startStream();
+    }
+  }
+  if (!pendingAudio_.push(audioId, std::move(pending))) {
+    return DecodeError::None;
+  }
+  return decodePendingAudio(segments, onTranscript);
+}
 
-  silenceWeightingPtr_ = std::make_unique<OnlineSilenceWeighting>(
-      transModel_, featureInfoPtr_->silence_weighting_config,
-      decodableOpts_.frame_subsampling_factor);
-  SPDLOG_DEBUG("Constructed OnlineSilenceWeighting");
+/**
+ * Nnet3Data::decodePendingAudio
+ * @brief Decodes the audio that's next in line, decoderMutex_ must be held
+ * @return The first error, the rest of the audio is still decoded after it
+ */
+DecodeError Nnet3Data::decodePendingAudio(std::vector<TranscriptSegment>& segments,
+                                          const TranscriptCallback& onTranscript) {
+  auto firstError = DecodeError::None;
+  while (auto next = pendingAudio_.pop()) {
+    auto& [audioId, pending] = *next;
+    const auto error = decodeChunk(audioId, std::move(pending.audio), pending.endOfStream,
+                                   pending.encoding, segments, onTranscript);
+    if (firstError == DecodeError::None) {
+      firstError = error;
+    }
+  }
+  return firstError;
+}
 
-  // For debugging purposes
-  if (!featurePipelinePtr_) {
-    SPDLOG_ERROR("feature_pipeline_ptr was null!");
-    return {};
-  } else if (!silenceWeightingPtr_) {
-    SPDLOG_ERROR("silenceWeightingPtr_ was null!");
-    return {};
-  } else if (!decoderPtr_) {
-    SPDLOG_ERROR("decoderPtr_ was null!");
-    return {};
+/**
+ * Nnet3Data::decodeChunk
+ * @brief Decodes audio that's next in line, decoderMutex_ must be held. Final transcripts are
+ * appended to segments
+ */
+DecodeError Nnet3Data::decodeChunk(uint32_t audioId, std::unique_ptr<std::string> audioDataPtr,
+                            bool endOfStream, AudioEncoding encoding,
+                            std::vector<TranscriptSegment>& segments,
+                            const TranscriptCallback& onTranscript) {
+  SPDLOG_DEBUG("Decoding audioId:{}, endOfStream:{}", audioId, endOfStream);
+
+  const auto decodeStart = ScopedTimer::Clock::now();
+  // Converted into the session's reused buffer, the chunks fed to the decoder are views into it
+  auto audioData = audioDataPtr ? std::string_view(*audioDataPtr) : std::string_view();
+  if (encoding != AudioEncoding::Linear16) {
+    const auto pcm = decompressAudio(encoding, audioData);
+    if (!pcm) {
+      // The codec's state is unknown after corrupt audio
+      startStream();
+      return DecodeError::InvalidAudio;
+    }
+    audioData = *pcm;
   }
+  const auto complete_audio_data = stringToKaldiVector(audioData, &audioBuffer_);
+  SPDLOG_DEBUG("complete_audio_data size in bytes:{}, number of elements:{}",
+               complete_audio_data.SizeInBytes(), complete_audio_data.Dim());
+
+  const auto& wordSyms = model_->wordSymbols();
+  const auto chunkLen = model_->chunkLength();
+
   try {
-    std::string output;
-    while (true) {
-
-      // Get a usable chunk out of the audio data, this range will keep moving over the entire audio
-      // data range
-      auto samplesToRead = complete_audio_data.Dim() - sampCount;
-      // Don't read more than a chunk
-      samplesToRead = std::min(samplesToRead, static_cast<int32>(chunkLen_));
-      // Don't try to read a negative number
-      samplesToRead = std::max(0, samplesToRead);
-      SPDLOG_DEBUG("samplesToRead {} vs chunkLen_ {}", samplesToRead, chunkLen_);
-
-      if (samplesToRead == 0) {
-        SPDLOG_INFO("End of stream, no more samples left. sampCount {}", sampCount);
-        break;
+    const auto addSegment = [&segments, &onTranscript](TranscriptSegment segment) {
+      if (segment.text.empty()) {
+        return;
       }
-
-      // Equivalent to GetChunk
-      SPDLOG_DEBUG("creating SubVector with Range({},{})", sampCount, samplesToRead);
-      const auto sub_vec = complete_audio_data.Range(sampCount, samplesToRead);
-      SPDLOG_DEBUG("created SubVector dim: {}, size in bytes:{}", sub_vec.Dim(),
-                   sub_vec.SizeInBytes());
-      SPDLOG_DEBUG("creating audio_chunk copy of SubVector");
-      Vector<BaseFloat> audio_chunk(sub_vec);
-      SPDLOG_DEBUG("created audio_chunk copy of SubVector dim: {}, size in bytes:{}",
-                   audio_chunk.Dim(), audio_chunk.SizeInBytes());
-
-      featurePipelinePtr_->AcceptWaveform(sampFreq_, audio_chunk);
-      sampCount += static_cast<int32>(chunkLen_);
-      SPDLOG_INFO("Chunk length:{}, Total sample count:{}", chunkLen_, sampCount);
-
-      if (silenceWeightingPtr_->Active() && featurePipelinePtr_->IvectorFeature() != nullptr) {
-        silenceWeightingPtr_->ComputeCurrentTraceback(decoderPtr_->Decoder());
-        silenceWeightingPtr_->GetDeltaWeights(
-            featurePipelinePtr_->NumFramesReady(),
-            frameOffset_ * decodableOpts_.frame_subsampling_factor, &deltaWeights_);
-        featurePipelinePtr_->UpdateFrameWeights(deltaWeights_);
-        SPDLOG_DEBUG("Adjusted silence weighting");
+      if (onTranscript) {
+        onTranscript(segment, true);
       }
+      segments.emplace_back(std::move(segment));
+    };
+
+    AudioChunker chunks(complete_audio_data, static_cast<int32>(chunkLen));
+    while (!chunks.done()) {
+      // Equivalent to GetChunk, but it's a view into the audio instead of a copy
+      const auto audio_chunk = chunks.next();
+      {
+        ScopedTimer timer(metrics_ ? &metrics_->featureSeconds : nullptr);
+        featurePipelinePtr_->AcceptWaveform(model_->sampleFrequency(), audio_chunk);
+      }
+      sampCount += audio_chunk.Dim();
+      SPDLOG_DEBUG("Chunk length:{}, Total sample count:{}", audio_chunk.Dim(), sampCount);
+
+      updateSilenceWeighting();
 
-      SPDLOG_DEBUG("Advancing decoding...");
-      decoderPtr_->AdvanceDecoding();
-      SPDLOG_DEBUG("Decoding advanced");
+      SPDLOG_TRACE("Advancing decoding...");
+      {
+        ScopedTimer timer(metrics_ ? &metrics_->advanceSeconds : nullptr);
+        decoderPtr_->advanceDecoding();
+      }
+      SPDLOG_TRACE("Decoding advanced");
 
-      // SPDLOG_DEBUG("sampCount:{}, checkCount_:{}", sampCount, checkCount_);
       if (sampCount > checkCount_) {
-        SPDLOG_DEBUG("sampCount:{} > checkCount_:{}", sampCount, checkCount_);
-        const auto num_frames_decoded = decoderPtr_->NumFramesDecoded();
+        SPDLOG_TRACE("sampCount:{} > checkCount_:{}", sampCount, checkCount_);
+        const auto num_frames_decoded = decoderPtr_->numFramesDecoded();
         if (num_frames_decoded > 0) {
-          SPDLOG_DEBUG("decoded {} frames", num_frames_decoded);
+          SPDLOG_TRACE("decoded {} frames", num_frames_decoded);
+          ScopedTimer timer(metrics_ ? &metrics_->latticeSeconds : nullptr);
           Lattice lat;
-          decoderPtr_->GetBestPath(/* end of utt */ false, &lat);
-          TopSort(&lat); // for LatticeStateTimes(),
-          std::string msg = LatticeToString(lat, *wordSyms_);
+          decoderPtr_->getBestPath(/* end of utt */ false, &lat);
+          // The best path is linear, so its frames are counted while reading the words
+          int32 numFrames = 0;
+          std::string msg = LatticeToString(lat, wordSyms, &numFrames);
+          trimTrailingSpaces(&msg);
 
           // get time-span after previous endpoint,
-          if (produceTime_) {
-            int32 t_beg = frameOffset_;
-            int32 t_end = frameOffset_ + GetLatticeTimeSpan(lat);
-            // NOLINTNEXTLINE: Don't want to mess with Kaldi code
-            msg = GetTimeString(t_beg, t_end,
-                                frameShift_ * static_cast<BaseFloat>(frameSubsampling_)) +
-                  " " + msg;
+          const int32 t_beg = frameOffset_;
+          const int32 t_end = frameOffset_ + numFrames;
+
+          SPDLOG_DEBUG("Temporary transcript: {}", msg);
+          if (onTranscript) {
+            TranscriptSegment segment;
+            segment.text = std::move(msg);
+            segment.startTime = static_cast<BaseFloat>(t_beg) * model_->frameDuration();
+            segment.endTime = static_cast<BaseFloat>(t_end) * model_->frameDuration();
+            onTranscript(segment, false);
           }
-
-          SPDLOG_INFO("Temporary transcript: {}", msg);
         }
-        checkCount_ += checkPeriod_;
+        checkCount_ += model_->checkPeriod();
       }
 
-      if (decoderPtr_->EndpointDetected(endpointOpts_)) {
+      if (decoderPtr_->endpointDetected(model_->endpointOptions())) {
         SPDLOG_INFO("Endpoint detected");
-        decoderPtr_->FinalizeDecoding();
-        frameOffset_ += decoderPtr_->NumFramesDecoded();
-        CompactLattice lat;
-        decoderPtr_->GetLattice(true, &lat);
-        std::string msg = LatticeToString(lat, *wordSyms_);
-
-        // get time-span between endpoints,
-        if (produceTime_) {
-          int32 t_beg = frameOffset_ - decoderPtr_->NumFramesDecoded();
-          int32 t_end = frameOffset_;
-          // NOLINTNEXTLINE: Don't want to mess with Kaldi code
-          msg =
-              GetTimeString(t_beg, t_end, frameShift_ * static_cast<BaseFloat>(frameSubsampling_)) +
-              " " + msg;
-        }
-
-        SPDLOG_INFO("Endpoint, sending message: {}", msg);
-        output += msg;
-        break;
+        auto segment = finishUtterance();
+        SPDLOG_INFO("Endpoint, sending message: {}", segment.text);
+        addSegment(std::move(segment));
+        // The rest of the audio goes into a new utterance
+        startUtterance();
       }
-    } // end of while(true) loop
-
-    SPDLOG_INFO("Input finished");
-    featurePipelinePtr_->InputFinished();
-    if (silenceWeightingPtr_->Active() && featurePipelinePtr_->IvectorFeature() != nullptr) {
-      silenceWeightingPtr_->ComputeCurrentTraceback(decoderPtr_->Decoder());
-      silenceWeightingPtr_->GetDeltaWeights(featurePipelinePtr_->NumFramesReady(),
-                                            frameOffset_ * decodableOpts_.frame_subsampling_factor,
-                                            &deltaWeights_);
-      featurePipelinePtr_->UpdateFrameWeights(deltaWeights_);
-      SPDLOG_DEBUG("Adjusted silence weighting");
+    } // end of chunk loop
+    SPDLOG_DEBUG("No more samples left in audioId {}. sampCount {}", audioId, sampCount);
+
+    if (endOfStream) {
+      SPDLOG_INFO("Input finished");
+      featurePipelinePtr_->InputFinished();
+      updateSilenceWeighting();
+      decoderPtr_->advanceDecoding();
+
+      auto segment = finishUtterance();
+      SPDLOG_INFO("EndOfAudio, sending message: {}", segment.text);
+      addSegment(std::move(segment));
+      // The feature pipeline can't take any more input once it's finished
+      startStream();
     }
 
-    decoderPtr_->AdvanceDecoding();
-    decoderPtr_->FinalizeDecoding();
-    const auto numFramesDecoded = decoderPtr_->NumFramesDecoded();
-    frameOffset_ += numFramesDecoded;
-    SPDLOG_DEBUG("frameOffset:{}, NumFramesDecoded:{}", frameOffset_, numFramesDecoded);
-    if (numFramesDecoded > 0) {
-      CompactLattice lat;
-      decoderPtr_->GetLattice(true, &lat);
-      std::string msg = LatticeToString(lat, *wordSyms_);
-
-      // get time-span from previous endpoint to end of audio,
-      if (produceTime_) {
-        int32 t_beg = frameOffset_ - decoderPtr_->NumFramesDecoded();
-        int32 t_end = frameOffset_;
-        msg = GetTimeString(t_beg, t_end, frameShift_ * static_cast<BaseFloat>(frameSubsampling_)) +
-              " " + msg;
-      }
-
-      SPDLOG_INFO("EndOfAudio, sending message: {}", msg);
-      output += msg;
+    if (metrics_ && complete_audio_data.Dim() > 0) {
+      const auto audioSecs =
+          static_cast<double>(complete_audio_data.Dim()) / model_->sampleFrequency();
+      const auto decodeSecs =
+          std::chrono::duration<double>(ScopedTimer::Clock::now() - decodeStart).count();
+      metrics_->audioSeconds.add(audioSecs);
+      metrics_->decodeSeconds.add(decodeSecs);
+      metrics_->realTimeFactor.observe(decodeSecs / audioSecs);
     }
-    return output;
+
+    return DecodeError::None;
 
   } catch (const std::exception& e) {
     SPDLOG_ERROR("Caught std::exception:{}", e.what());
@@ -248,68 +396,127 @@ std::string Nnet3Data::decodeAudio(const std::string& sessionToken, uint32_t aud
     SPDLOG_ERROR("Caught unknown exception");
   }
 
-  return {};
+  // The decoder may be in a bad state, start over with the next audio
+  startStream();
+  return DecodeError::DecoderFailed;
 }
 
 /**
- * Nnet3Data::Nnet3Data
- * @brief Reads in config file and sets up Nnet3 for a session of online decoding
+ * Nnet3Data::decompressAudio
+ * @brief Decodes into decompressedAudio_, the decoder is only replaced when the encoding changes
+ * @return View of the PCM, only valid until the next call. Empty if the encoding isn't supported
+ * at the model's rate or the audio couldn't be decoded
  */
-Nnet3Data::Nnet3Data(int argc, const char** argv) // NOLINT: Easiest to use cmd line args with kaldi
-    : featureOpts_(), decodableOpts_(), decoderOpts_(), endpointOpts_() {
+std::optional<std::string_view> Nnet3Data::decompressAudio(AudioEncoding encoding,
+                                                           std::string_view audio) {
+  if (!audioDecoder_ || audioEncoding_ != encoding) {
+    audioDecoder_ =
+        makeAudioDecoder(encoding, static_cast<unsigned int>(model_->sampleFrequency()));
+    audioEncoding_ = encoding;
+  }
+  decompressedAudio_.clear();
+  if (!audioDecoder_ || !audioDecoder_->decode(audio, &decompressedAudio_)) {
+    SPDLOG_WARN("Couldn't decode the {} bytes of compressed audio", audio.size());
+    return std::nullopt;
+  }
+  return decompressedAudio_;
+}
 
-  SPDLOG_INFO("Constructing Nnet3Data");
+/**
+ * Nnet3Data::startStream
+ * @brief Sets up a fresh feature pipeline, frames are counted from the start of the stream
+ */
+void Nnet3Data::startStream() {
+  if (audioDecoder_) {
+    audioDecoder_->reset();
+  }
+  // The decoder holds onto the feature pipeline so it has to go first
+  decoderPtr_.reset();
+  featurePipelinePtr_ = std::make_unique<OnlineNnet2FeaturePipeline>(model_->featureInfo());
+  frameOffset_ = 0;
+  startUtterance();
+}
+
+/**
+ * Nnet3Data::startUtterance
+ * @brief Sets up a fresh decoder that continues on the stream's feature pipeline after the previous
+ * utterance, like online2-tcp-nnet3-decode-faster does
+ */
+void Nnet3Data::startUtterance() {
+  if (batchScheduler_) {
+    decoderPtr_ = std::make_unique<BatchedUtteranceDecoder>(
+        *model_, *batchScheduler_, featurePipelinePtr_.get(), frameOffset_);
+  } else {
+    decoderPtr_ = std::make_unique<LoopedUtteranceDecoder>(*model_, featurePipelinePtr_.get(),
+                                                           frameOffset_);
+  }
+
+  silenceWeightingPtr_ = std::make_unique<OnlineSilenceWeighting>(
+      model_->transitionModel(), model_->featureInfo().silence_weighting_config,
+      model_->decodableOptions().frame_subsampling_factor);
+
+  sampCount = 0;
+  checkCount_ = model_->checkPeriod();
+  SPDLOG_DEBUG("Started utterance at frameOffset:{}", frameOffset_);
+}
+
+/**
+ * Nnet3Data::updateSilenceWeighting
+ */
+void Nnet3Data::updateSilenceWeighting() {
+  if (silenceWeightingPtr_->Active() && featurePipelinePtr_->IvectorFeature() != nullptr) {
+    silenceWeightingPtr_->ComputeCurrentTraceback(decoderPtr_->decoder());
+    silenceWeightingPtr_->GetDeltaWeights(
+        featurePipelinePtr_->NumFramesReady(),
+        frameOffset_ * model_->decodableOptions().frame_subsampling_factor, &deltaWeights_);
+    featurePipelinePtr_->UpdateFrameWeights(deltaWeights_);
+    SPDLOG_TRACE("Adjusted silence weighting");
+  }
+}
+
+/**
+ * Nnet3Data::finishUtterance
+ * @brief Finalizes decoding of the current utterance
+ * @return Final transcript of the utterance, the text is empty if nothing was decoded
+ */
+TranscriptSegment Nnet3Data::finishUtterance() {
+  decoderPtr_->finalizeDecoding();
+  const auto numFramesDecoded = decoderPtr_->numFramesDecoded();
+  frameOffset_ += numFramesDecoded;
+  SPDLOG_DEBUG("frameOffset:{}, NumFramesDecoded:{}", frameOffset_, numFramesDecoded);
+  if (numFramesDecoded <= 0) {
+    return {};
+  }
+
+  ScopedTimer timer(metrics_ ? &metrics_->latticeSeconds : nullptr);
+  CompactLattice lat;
+  decoderPtr_->getLattice(true, &lat);
+  auto segment = LatticeToSegment(lat, model_->wordSymbols(), model_->transcriptOptions());
+
+  // The lattice starts at the previous endpoint, so its times are shifted by where that was
+  const int32 t_beg = frameOffset_ - numFramesDecoded;
+  segment.startTime = 0;
+  segment.endTime = static_cast<BaseFloat>(numFramesDecoded) * model_->frameDuration();
+  offsetSegment(&segment, static_cast<BaseFloat>(t_beg) * model_->frameDuration());
+  return segment;
+}
+
+/**
+ * Nnet3Model::Nnet3Model
+ * @brief Loads the acoustic model, FST and symbol table described by the config
+ */
+Nnet3Model::Nnet3Model(const Nnet3Config& config) : config_(config) {
 
-  chunkLengthSecs_ = 0.18f;
-  outputPeriod = 1;
-  sampFreq_ = 16000.0;
-  readTimeout_ = 3;
-  produceTime_ = false;
-  const char* usage = "Reads in audio from a network socket and performs online\n"
-                      "decoding with neural nets (nnet3 setup), with iVector-based\n"
-                      "speaker adaptation and endpointing.\n"
-                      "Note: some configuration values and inputs are set via config\n"
-                      "files whose filenames are passed as options\n"
-                      "\n"
-                      "Usage: online2-tcp-nnet3-decode-faster [options] <nnet3-in> "
-                      "<fst-in> <word-symbol-table>\n";
-  ParseOptions po(usage);
-
-  po.Register("samp-freq", &sampFreq_,
-              "Sampling frequency of the input signal (coded as 16-bit slinear).");
-  po.Register("chunk-length", &chunkLengthSecs_,
-              "Length of chunk size in seconds, that we process.");
-  po.Register("output-period", &outputPeriod,
-              "How often in seconds, do we check for changes in output.");
-  po.Register("num-threads-startup", &g_num_threads,
-              "Number of threads used when initializing iVector extractor.");
-  po.Register("read-timeout", &readTimeout_,
-              "Number of seconds of timout for TCP audio data to appear on the stream. Use -1 "
-              "for blocking.");
-  po.Register(
-      "produce-time", &produceTime_,
-      "Prepend begin/end times between endpoints (e.g. '5.46 6.81 <text_output>', in seconds)");
-
-  featureOpts_.Register(&po);
-  decodableOpts_.Register(&po);
-  decoderOpts_.Register(&po);
-  endpointOpts_.Register(&po);
-
-  po.Read(argc, argv);
-
-  if (po.NumArgs() != 3) {
-    po.PrintUsage();
-  }
-
-  const std::string nnet3_rxfilename = po.GetArg(1);
-  const std::string fst_rxfilename = po.GetArg(2);
-  const std::string word_syms_filename = po.GetArg(3);
-
-  featureInfoPtr_ = std::make_unique<OnlineNnet2FeaturePipelineInfo>(featureOpts_);
+  SPDLOG_INFO("Constructing Nnet3Model");
+
+  const std::string& nnet3_rxfilename = config_.nnet3Filename;
+  const std::string& fst_rxfilename = config_.fstFilename;
+
+  featureInfoPtr_ = std::make_unique<OnlineNnet2FeaturePipelineInfo>(config_.featureOpts);
   SPDLOG_INFO("Constructed OnlineNnet2FeaturePipelineInfo");
 
   frameShift_ = featureInfoPtr_->FrameShiftInSeconds();
-  frameSubsampling_ = decodableOpts_.frame_subsampling_factor;
+  frameSubsampling_ = config_.decodableOpts.frame_subsampling_factor;
 
   {
     SPDLOG_INFO("Loading acoustic model...");
@@ -324,33 +531,72 @@ Nnet3Data::Nnet3Data(int argc, const char** argv) // NOLINT: Easiest to use cmd
   }
 
   decodableInfoPtr_ =
-      std::make_unique<nnet3::DecodableNnetSimpleLoopedInfo>(decodableOpts_, &amNnet_);
+      std::make_unique<nnet3::DecodableNnetSimpleLoopedInfo>(config_.decodableOpts, &amNnet_);
 
   SPDLOG_INFO("Loading FST...");
-  decodeFst_ = fst::ReadFstKaldiGeneric(fst_rxfilename);
-  if (!word_syms_filename.empty()) {
-    if (!(wordSyms_ = fst::SymbolTable::ReadText(word_syms_filename))) {
-      SPDLOG_ERROR("Could not read symbol table from file {}", word_syms_filename);
+  if (config_.mmapFst) {
+    decodeFstPtr_ = readMappedFst(fst_rxfilename, config_.mmapFstCache);
+    if (!decodeFstPtr_) {
+      SPDLOG_WARN("Falling back to reading the FST into memory");
     }
   }
+  if (!decodeFstPtr_) {
+    decodeFstPtr_.reset(fst::ReadFstKaldiGeneric(fst_rxfilename));
+  }
   SPDLOG_INFO("Loaded FST");
 
-  sampCount = 0; // this is used for output refresh rate
-  chunkLen_ = static_cast<size_t>(chunkLengthSecs_ * sampFreq_);
-  checkPeriod_ = static_cast<int32>(sampFreq_ * outputPeriod);
-  checkCount_ = checkPeriod_;
-  frameOffset_ = 0;
+  if (!config_.lazyWordSyms) {
+    [[maybe_unused]] const auto& wordSyms = wordSymbols();
+  }
+
+  chunkLen_ = static_cast<size_t>(config_.chunkLengthSecs * config_.sampFreq);
+  checkPeriod_ = static_cast<int32>(config_.sampFreq * config_.outputPeriod);
+  transcriptOpts_.nbest = config_.nbest;
+  transcriptOpts_.wordConfidence = config_.wordConfidence;
+  transcriptOpts_.wordTimes = config_.wordTimes;
+  transcriptOpts_.frameDuration = frameDuration();
 
   SPDLOG_INFO("Config options:");
-  SPDLOG_INFO("  sample frequency: {} Hz", sampFreq_);
-  SPDLOG_INFO("  chunk length: {} seconds, {} samples", chunkLengthSecs_, chunkLen_);
+  SPDLOG_INFO("  sample frequency: {} Hz", config_.sampFreq);
+  SPDLOG_INFO("  chunk length: {} seconds, {} samples", config_.chunkLengthSecs, chunkLen_);
 
-  featurePipelinePtr_ = std::make_unique<OnlineNnet2FeaturePipeline>(*featureInfoPtr_);
-  SPDLOG_DEBUG("Constructed OnlineNnet2FeaturePipeline");
+  SPDLOG_INFO("Constructed Nnet3Model");
+}
 
-  decoderPtr_ = std::make_unique<SingleUtteranceNnet3Decoder>(
-      decoderOpts_, transModel_, *decodableInfoPtr_, *decodeFst_, featurePipelinePtr_.get());
-  SPDLOG_DEBUG("Constructed SingleUtteranceNnet3Decoder");
+/**
+ * Nnet3Model::wordSymbols
+ * @brief Reads the symbol table the first time it's needed when --lazy-word-syms is set
+ */
+const fst::SymbolTable& Nnet3Model::wordSymbols() const {
+  std::call_once(wordSymsFlag_, [this] {
+    const auto& word_syms_filename = config_.wordSymsFilename;
+    if (!word_syms_filename.empty()) {
+      SPDLOG_INFO("Loading symbol table...");
+      wordSymsPtr_.reset(fst::SymbolTable::ReadText(word_syms_filename));
+    }
+    if (!wordSymsPtr_) {
+      SPDLOG_ERROR("Could not read symbol table from file {}", word_syms_filename);
+      // Words will show up as empty strings instead of crashing
+      wordSymsPtr_ = std::make_unique<fst::SymbolTable>();
+    }
+  });
+  return *wordSymsPtr_;
+}
+
+/**
+ * Nnet3Data::Nnet3Data
+ * @brief Sets up the per-session state for online decoding with a shared model
+ */
+Nnet3Data::Nnet3Data(std::shared_ptr<const Nnet3Model> model,
+                     std::shared_ptr<NnetBatchScheduler> batchScheduler,
+                     std::shared_ptr<DecodeMetrics> metrics)
+    : decoderMutex_(), model_(std::move(model)), batchScheduler_(std::move(batchScheduler)),
+      metrics_(std::move(metrics)), pendingAudio_(model_->readTimeout()) {
+
+  SPDLOG_INFO("Constructing Nnet3Data");
+
+  sampCount = 0; // this is used for output refresh rate
+  startStream();
 
   SPDLOG_INFO("Constructed Nnet3Data");
 }
@@ -358,22 +604,16 @@ Nnet3Data::Nnet3Data(int argc, const char** argv) // NOLINT: Easiest to use cmd
 /**
  * LatticeToString
  */
-std::string LatticeToString(const Lattice& lat, const fst::SymbolTable& wordSyms) {
+std::string LatticeToString(const Lattice& lat, const fst::SymbolTable& wordSyms,
+                            int32* numFrames) {
   LatticeWeight weight;
   std::vector<int32> alignment;
   std::vector<int32> words;
   GetLinearSymbolSequence(lat, &alignment, &words, &weight);
-
-  std::ostringstream msg;
-  for (size_t i = 0; i < words.size(); i++) {
-    std::string s = wordSyms.Find(words[i]);
-    if (s.empty()) {
-      KALDI_WARN << "Word-id " << words[i] << " not in symbol table.";
-      msg << "<#" << std::to_string(i) << "> ";
-    } else
-      msg << s << " ";
-  }
-  return msg.str();
+  if (numFrames) {
+    *numFrames = static_cast<int32>(alignment.size());
+  }
+  return wordsToString(words, wordSyms);
 }
 
 /**
@@ -393,25 +633,103 @@ std::string LatticeToString(const CompactLattice& clat, const fst::SymbolTable&
 }
 
 /**
- * GetTimeString
+ * LatticeToSegment
+ * @brief The N best paths are searched for on the word lattice, without the alignments, and the
+ * first one is the best path so it isn't searched for a second time. The best path's words are
+ * placed in the lattice's sausages, which gives both their posteriors and the frames they span in
+ * one pass. The lattice is already scaled by the acoustic scale when it comes out of the decoder
+ * so the posteriors are too
  */
-std::string GetTimeString(int32 t_beg, int32 t_end, BaseFloat time_unit) {
-  std::array<char, 100> buffer; //
-  double t_beg2 =
-      static_cast<BaseFloat>(t_beg) * time_unit; // NOLINT: Scared to fix Kaldi code without tests
-  double t_end2 =
-      static_cast<BaseFloat>(t_end) * time_unit; // NOLINT: Scared to fix Kaldi code without tests
-  snprintf(buffer.data(), 100, "%.2f %.2f", t_beg2, t_end2);
-  return std::string(buffer.data());
+TranscriptSegment LatticeToSegment(const CompactLattice& clat, const fst::SymbolTable& wordSyms,
+                                   const TranscriptOptions& options) {
+  const auto nbest = options.nbest;
+  const bool wantWords = options.wordConfidence || options.wordTimes;
+  TranscriptSegment segment;
+  if (nbest <= 1 && !wantWords) {
+    segment.text = LatticeToString(clat, wordSyms);
+    trimTrailingSpaces(&segment.text);
+    return segment;
+  }
+  if (clat.NumStates() == 0) {
+    KALDI_WARN << "Empty lattice.";
+    return segment;
+  }
+
+  Lattice wordLat;
+  {
+    CompactLattice wordClat(clat);
+    RemoveAlignmentsFromCompactLattice(&wordClat);
+    ConvertLattice(wordClat, &wordLat);
+  }
+  Lattice nbestLat;
+  fst::ShortestPath(wordLat, &nbestLat, std::max(nbest, 1));
+  std::vector<Lattice> paths;
+  fst::ConvertNbestToVector(nbestLat, &paths);
+  if (paths.empty()) {
+    KALDI_WARN << "Lattice has no complete path.";
+    return segment;
+  }
+
+  std::vector<int32> bestWords;
+  for (size_t i = 0; i < paths.size(); ++i) {
+    LatticeWeight weight;
+    std::vector<int32> alignment;
+    std::vector<int32> words;
+    GetLinearSymbolSequence(paths[i], &alignment, &words, &weight);
+    if (i == 0) {
+      segment.text = wordsToString(words, wordSyms);
+      trimTrailingSpaces(&segment.text);
+      bestWords = words;
+    }
+    if (nbest > 1) {
+      TranscriptAlternative alternative;
+      alternative.text = wordsToString(words, wordSyms);
+      trimTrailingSpaces(&alternative.text);
+      alternative.cost = weight.Value1() + weight.Value2();
+      segment.alternatives.emplace_back(std::move(alternative));
+    }
+  }
+
+  if (wantWords && !bestWords.empty()) {
+    MinimumBayesRiskOptions mbrOptions;
+    // Only the best path's confidences and times are needed, not the MBR transcript
+    mbrOptions.decode_mbr = false;
+    const MinimumBayesRisk mbr(clat, bestWords, mbrOptions);
+    const auto& confidences = mbr.GetOneBestConfidences();
+    const auto& times = mbr.GetOneBestTimes();
+    segment.words.reserve(bestWords.size());
+    for (size_t i = 0; i < bestWords.size(); ++i) {
+      TranscriptWord word;
+      word.text = wordToString(bestWords, i, wordSyms);
+      word.confidence = i < confidences.size() ? confidences[i] : 0;
+      if (i < times.size()) {
+        word.startTime = times[i].first * options.frameDuration;
+        word.endTime = times[i].second * options.frameDuration;
+      }
+      segment.words.emplace_back(std::move(word));
+    }
+  }
+  return segment;
+}
+
+/**
+ * offsetSegment
+ */
+void offsetSegment(TranscriptSegment* segment, BaseFloat seconds) {
+  segment->startTime += seconds;
+  segment->endTime += seconds;
+  for (auto& word : segment->words) {
+    word.startTime += seconds;
+    word.endTime += seconds;
+  }
 }
 
 /**
- * GetLatticeTimeSpan
+ * GetTimeString
  */
-int32 GetLatticeTimeSpan(const Lattice& lat) {
-  std::vector<int32> times;
-  LatticeStateTimes(lat, &times);
-  return times.back();
+std::string GetTimeString(int32 t_beg, int32 t_end, BaseFloat time_unit) {
+  return fmt::format("{:.2f} {:.2f}", static_cast<BaseFloat>(t_beg) * time_unit,
+                     static_cast<BaseFloat>(t_end) * time_unit);
 }
 
 } // namespace mik
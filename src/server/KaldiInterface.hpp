@@ -22,7 +22,14 @@
 // Modified for use in Ristretto
 #pragma once
 
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <string_view>
+#include <vector>
 
 #include "feat/wave-reader.h"
 #include "fstext/fstext-lib.h"
@@ -37,58 +44,282 @@
 
 #include <spdlog/spdlog.h>
 
+#include "AudioCodec.hpp"
+#include "AudioReorder.hpp"
+#include "Metrics.hpp"
+#include "ServerConfig.hpp"
+#include "UtteranceDecoder.hpp"
+
 namespace mik {
 
+class NnetBatchScheduler;
+
 /**
- * Nnet3Data
- * @brief Catch-all class for using online decoding with nnet3. Holds a lot of Kaldi objects
+ * TranscriptWord
+ * @brief Word of the best path along with when it was said and how likely it is to be correct
  */
-class Nnet3Data {
+struct TranscriptWord {
+  std::string text;
+  /// @brief Posterior probability of the word from the lattice, between 0 and 1
+  kaldi::BaseFloat confidence = 1;
+  /// @brief Seconds since the start of the stream
+  kaldi::BaseFloat startTime = 0;
+  kaldi::BaseFloat endTime = 0;
+};
+
+/**
+ * TranscriptAlternative
+ * @brief One of the N best word sequences in the lattice
+ */
+struct TranscriptAlternative {
+  std::string text;
+  /// @brief Graph plus acoustic cost of the path, lower is better
+  kaldi::BaseFloat cost = 0;
+};
+
+/**
+ * TranscriptSegment
+ * @brief Transcript of the audio between two endpoints
+ */
+struct TranscriptSegment {
+  /// @brief Words separated by single spaces, the times are only ever in the fields below
+  std::string text;
+  /// @brief Seconds since the start of the stream
+  kaldi::BaseFloat startTime = 0;
+  kaldi::BaseFloat endTime = 0;
+  /// @brief Only filled in for final transcripts when --word-confidence or --word-times is set
+  std::vector<TranscriptWord> words;
+  /// @brief Only filled in for final transcripts when --nbest is above 1, best first
+  std::vector<TranscriptAlternative> alternatives;
+};
+
+/**
+ * TranscriptOptions
+ * @brief What's given along with the text of final transcripts
+ */
+struct TranscriptOptions {
+  /// @brief Number of alternatives to give, 1 only gives the best one
+  kaldi::int32 nbest = 1;
+  bool wordConfidence = false;
+  bool wordTimes = false;
+  /// @brief Seconds per frame of the lattice, the word times are converted with it
+  kaldi::BaseFloat frameDuration = 0;
+};
+
+/**
+ * DecodeError
+ * @brief Why audio wasn't decoded. The stream starts over after any of them
+ */
+enum class DecodeError {
+  None,
+  /// @brief Kaldi threw while decoding the audio
+  DecoderFailed,
+  /// @brief The encoding isn't supported or the compressed audio is corrupt
+  InvalidAudio,
+};
+
+/// @brief Called with each temporary (isFinal = false) and final transcript once it's available
+using TranscriptCallback = std::function<void(const TranscriptSegment& segment, bool isFinal)>;
+
+/**
+ * Nnet3Model
+ * @brief Read-only Kaldi data (acoustic model, decoding graph, symbol table and the options used to
+ * load them). This is loaded once and shared by every decoding session.
+ */
+class Nnet3Model {
 
 public:
-  // NOLINTNEXTLINE: Easiest to use cmd line args with kaldi
-  Nnet3Data(int argc, const char** argv);
+  explicit Nnet3Model(const Nnet3Config& config);
+  // Holds gigabytes of data, there should never be a reason to copy it
+  Nnet3Model(const Nnet3Model&) = delete;
+  Nnet3Model& operator=(const Nnet3Model&) = delete;
 
-  std::string decodeAudio(const std::string& sessionToken, uint32_t audioId,
-                          std::unique_ptr<std::string> audioDataPtr);
+  [[nodiscard]] const kaldi::TransitionModel& transitionModel() const noexcept {
+    return transModel_;
+  }
+  [[nodiscard]] const kaldi::nnet3::AmNnetSimple& acousticModel() const noexcept {
+    return amNnet_;
+  }
+  [[nodiscard]] const kaldi::nnet3::DecodableNnetSimpleLoopedInfo& decodableInfo() const noexcept {
+    return *decodableInfoPtr_;
+  }
+  [[nodiscard]] const kaldi::OnlineNnet2FeaturePipelineInfo& featureInfo() const noexcept {
+    return *featureInfoPtr_;
+  }
+  [[nodiscard]] const fst::Fst<fst::StdArc>& decodeFst() const noexcept { return *decodeFstPtr_; }
+  [[nodiscard]] const fst::SymbolTable& wordSymbols() const;
 
-private:
-  std::mutex decoderMutex_;
+  [[nodiscard]] const kaldi::nnet3::NnetSimpleLoopedComputationOptions&
+  decodableOptions() const noexcept {
+    return config_.decodableOpts;
+  }
+  [[nodiscard]] const kaldi::LatticeFasterDecoderConfig& decoderOptions() const noexcept {
+    return config_.decoderOpts;
+  }
+  [[nodiscard]] const kaldi::OnlineEndpointConfig& endpointOptions() const noexcept {
+    return config_.endpointOpts;
+  }
 
-  // Kaldi data
-  kaldi::OnlineNnet2FeaturePipelineConfig featureOpts_;
-  kaldi::nnet3::NnetSimpleLoopedComputationOptions decodableOpts_;
-  kaldi::LatticeFasterDecoderConfig decoderOpts_;
-  kaldi::OnlineEndpointConfig endpointOpts_;
+  [[nodiscard]] kaldi::BaseFloat sampleFrequency() const noexcept { return config_.sampFreq; }
+  /// @brief Number of samples that are fed into the feature pipeline at a time
+  [[nodiscard]] size_t chunkLength() const noexcept { return chunkLen_; }
+  /// @brief Number of samples between each temporary transcript
+  [[nodiscard]] kaldi::int32 checkPeriod() const noexcept { return checkPeriod_; }
+  [[nodiscard]] bool produceTime() const noexcept { return config_.produceTime; }
+  [[nodiscard]] const TranscriptOptions& transcriptOptions() const noexcept {
+    return transcriptOpts_;
+  }
+  /// @brief Seconds that audio which arrived early is held for the audio before it, -1 holds it
+  /// until it's pushed out by later audio or the end of the stream
+  [[nodiscard]] int readTimeout() const noexcept { return config_.readTimeout; }
+  /// @brief Duration of a decoded frame in seconds, takes frame subsampling into account
+  [[nodiscard]] kaldi::BaseFloat frameDuration() const noexcept {
+    return frameShift_ * static_cast<kaldi::BaseFloat>(frameSubsampling_);
+  }
+
+private:
+  const Nnet3Config config_;
   kaldi::BaseFloat frameShift_;
   kaldi::int32 frameSubsampling_;
   kaldi::TransitionModel transModel_;
   kaldi::nnet3::AmNnetSimple amNnet_;
-  fst::Fst<fst::StdArc>* decodeFst_;
-  fst::SymbolTable* wordSyms_;
-  kaldi::BaseFloat chunkLengthSecs_;
-  kaldi::BaseFloat outputPeriod;
-  kaldi::BaseFloat sampFreq_;
-  int readTimeout_;
-  bool produceTime_;
-  kaldi::int32 sampCount;
+  std::unique_ptr<fst::Fst<fst::StdArc>> decodeFstPtr_;
+  mutable std::once_flag wordSymsFlag_;
+  mutable std::unique_ptr<fst::SymbolTable> wordSymsPtr_;
   size_t chunkLen_;
   kaldi::int32 checkPeriod_;
+  TranscriptOptions transcriptOpts_;
+  std::unique_ptr<kaldi::OnlineNnet2FeaturePipelineInfo> featureInfoPtr_;
+  std::unique_ptr<kaldi::nnet3::DecodableNnetSimpleLoopedInfo> decodableInfoPtr_;
+};
+
+/**
+ * Nnet3Data
+ * @brief Per-session decoding state. Only holds what's needed to decode a single stream of audio,
+ * everything read-only comes from the shared Nnet3Model
+ */
+class Nnet3Data {
+
+public:
+  /// @param batchScheduler Evaluates the acoustic model together with other sessions, if not null
+  /// @param metrics Where decoding times are recorded, if not null
+  explicit Nnet3Data(std::shared_ptr<const Nnet3Model> model,
+                     std::shared_ptr<NnetBatchScheduler> batchScheduler = nullptr,
+                     std::shared_ptr<DecodeMetrics> metrics = nullptr);
+
+  /**
+   * @brief Audio that arrives ahead of the audio before it is held without blocking, whichever
+   * call decodes the missing audio also decodes what was held after it
+   * @return Final transcripts of everything this call decoded, these are also passed to
+   * onTranscript. Empty when the audio was held, its transcripts come with the call that decodes it.
+   * Transcripts that skipAudio decoded come first
+   * @param error Set to the first error of the audio this call decoded, if not null
+   */
+  std::vector<TranscriptSegment>
+  decodeAudio(const std::string& sessionToken, uint32_t audioId,
+              std::unique_ptr<std::string> audioDataPtr, bool endOfStream,
+              const TranscriptCallback& onTranscript = {},
+              AudioEncoding encoding = AudioEncoding::Linear16, DecodeError* error = nullptr);
+  /**
+   * @brief Audio of a call that nobody waits for anymore. It isn't decoded, but the audio after it
+   * doesn't wait for it either. What the held audio after it decodes to comes with the session's
+   * next decodeAudio call
+   */
+  void skipAudio(const std::string& sessionToken, uint32_t audioId, bool endOfStream);
+  /// @param error Set to the first error of the audio this call decoded, if not null
+  std::vector<TranscriptSegment> finishStream(const std::string& sessionToken,
+                                              const TranscriptCallback& onTranscript = {},
+                                              DecodeError* error = nullptr);
+  /// @brief Drops the current stream so that this can be reused for another session
+  void reset();
+
+private:
+  DecodeError acceptAudio(uint32_t audioId, PendingAudio pending,
+                          std::vector<TranscriptSegment>& segments,
+                          const TranscriptCallback& onTranscript);
+  DecodeError decodePendingAudio(std::vector<TranscriptSegment>& segments,
+                                 const TranscriptCallback& onTranscript);
+  DecodeError decodeChunk(uint32_t audioId, std::unique_ptr<std::string> audioDataPtr,
+                          bool endOfStream, AudioEncoding encoding,
+                          std::vector<TranscriptSegment>& segments,
+                          const TranscriptCallback& onTranscript);
+  std::optional<std::string_view> decompressAudio(AudioEncoding encoding, std::string_view audio);
+  void startStream();
+  void startUtterance();
+  void updateSilenceWeighting();
+  TranscriptSegment finishUtterance();
+
+  std::mutex decoderMutex_;
+
+  std::shared_ptr<const Nnet3Model> model_;
+  std::shared_ptr<NnetBatchScheduler> batchScheduler_;
+  std::shared_ptr<DecodeMetrics> metrics_;
+
+  AudioReorderBuffer pendingAudio_;
+  /// @brief Decoded by skipAudio, they're returned by the next call to decodeAudio
+  std::vector<TranscriptSegment> undeliveredSegments_;
+
+  /// @brief Samples fed into the current utterance
+  kaldi::int32 sampCount;
   kaldi::int32 checkCount_;
+  /// @brief Frames decoded in the previous utterances of this stream
   kaldi::int32 frameOffset_;
   std::unique_ptr<kaldi::OnlineNnet2FeaturePipeline> featurePipelinePtr_;
-  std::unique_ptr<kaldi::SingleUtteranceNnet3Decoder> decoderPtr_;
+  std::unique_ptr<UtteranceDecoder> decoderPtr_;
   std::unique_ptr<kaldi::OnlineSilenceWeighting> silenceWeightingPtr_;
-  std::unique_ptr<kaldi::OnlineNnet2FeaturePipelineInfo> featureInfoPtr_;
-  std::unique_ptr<kaldi::nnet3::DecodableNnetSimpleLoopedInfo> decodableInfoPtr_;
   std::vector<std::pair<kaldi::int32, kaldi::BaseFloat>> deltaWeights_;
+  /// @brief Reused for each request's audio so that steady-state decoding doesn't allocate for it
+  kaldi::Vector<kaldi::BaseFloat> audioBuffer_;
+  /// @brief Only set once compressed audio was sent, it keeps its state for the whole stream
+  std::unique_ptr<AudioDecoder> audioDecoder_;
+  AudioEncoding audioEncoding_ = AudioEncoding::Linear16;
+  /// @brief Reused for the PCM that compressed audio is decoded into
+  std::string decompressedAudio_;
+};
+
+/**
+ * AudioChunker
+ * @brief Walks over audio in chunks of at most chunkLength samples. The chunks are views into the
+ * audio so nothing is copied or allocated
+ */
+class AudioChunker {
+public:
+  AudioChunker(const kaldi::VectorBase<kaldi::BaseFloat>& audio, kaldi::int32 chunkLength)
+      : audio_(audio), chunkLength_(std::max(1, chunkLength)) {}
+
+  [[nodiscard]] bool done() const noexcept { return samplesRead_ >= audio_.Dim(); }
+
+  /// @brief Must not be called once done()
+  [[nodiscard]] kaldi::SubVector<kaldi::BaseFloat> next() {
+    const auto length = std::min(chunkLength_, audio_.Dim() - samplesRead_);
+    kaldi::SubVector<kaldi::BaseFloat> chunk(audio_, samplesRead_, length);
+    samplesRead_ += length;
+    return chunk;
+  }
+
+private:
+  const kaldi::VectorBase<kaldi::BaseFloat>& audio_;
+  const kaldi::int32 chunkLength_;
+  kaldi::int32 samplesRead_ = 0;
 };
 
 kaldi::Vector<kaldi::BaseFloat> stringToKaldiVector(std::unique_ptr<std::string> audioDataPtr);
+kaldi::Vector<kaldi::BaseFloat> stringToKaldiVector(std::string_view audioData);
+kaldi::SubVector<kaldi::BaseFloat> stringToKaldiVector(std::string_view audioData,
+                                                       kaldi::Vector<kaldi::BaseFloat>* buffer);
 
-std::string LatticeToString(const kaldi::Lattice& lat, const fst::SymbolTable& wordSyms);
+/// @param numFrames Set to the number of frames in the lattice, if not null
+std::string LatticeToString(const kaldi::Lattice& lat, const fst::SymbolTable& wordSyms,
+                            kaldi::int32* numFrames = nullptr);
 std::string GetTimeString(kaldi::int32 tBeg, kaldi::int32 tEnd, kaldi::BaseFloat timeUnit);
-kaldi::int32 GetLatticeTimeSpan(const kaldi::Lattice& lat);
 std::string LatticeToString(const kaldi::CompactLattice& clat, const fst::SymbolTable& wordSyms);
+/// @brief Best path of the lattice along with its N best alternatives and the best path's words,
+/// each one only when it's asked for. The texts don't end in a space. Times are from the start of
+/// the lattice, the segment's are left for the caller to fill in
+TranscriptSegment LatticeToSegment(const kaldi::CompactLattice& clat,
+                                   const fst::SymbolTable& wordSyms,
+                                   const TranscriptOptions& options);
+/// @brief Moves the segment and its words later by seconds, to place them in a longer recording
+void offsetSegment(TranscriptSegment* segment, kaldi::BaseFloat seconds);
 
 } // namespace mik
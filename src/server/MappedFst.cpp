@@ -0,0 +1,119 @@
+#include <filesystem>
+#include <fstream>
+
+#include <spdlog/spdlog.h>
+
+#include "util/kaldi-io.h"
+
+#include "MappedFst.hpp"
+
+namespace mik {
+namespace {
+
+using MappableFst = fst::ConstFst<fst::StdArc>;
+
+/// @brief Whether the file is a ConstFst that was written aligned, which is what mapping needs
+bool isMappable(const std::string& filename) {
+  std::ifstream strm(filename, std::ios_base::in | std::ios_base::binary);
+  int32_t magicNumber = 0;
+  // Check the magic number first so that text FSTs don't make OpenFst log errors
+  if (!strm.read(reinterpret_cast<char*>(&magicNumber), sizeof(magicNumber)) ||
+      magicNumber != fst::kFstMagicNumber) {
+    return false;
+  }
+  strm.seekg(0);
+
+  fst::FstHeader header;
+  if (!header.Read(strm, filename)) {
+    return false;
+  }
+  return header.FstType() == MappableFst().Type() && header.ArcType() == fst::StdArc::Type() &&
+         (header.GetFlags() & fst::FstHeader::IS_ALIGNED) != 0;
+}
+
+/// @brief Whether the cache was written after the graph was last changed
+bool isCacheFresh(const std::string& fstFilename, const std::string& cacheFilename) {
+  std::error_code error;
+  const auto cacheTime = std::filesystem::last_write_time(cacheFilename, error);
+  if (error) {
+    return false;
+  }
+  const auto fstTime = std::filesystem::last_write_time(fstFilename, error);
+  return !error && cacheTime >= fstTime && isMappable(cacheFilename);
+}
+
+/// @brief Converts the graph into an aligned ConstFst at cacheFilename
+bool writeMappable(const std::string& fstFilename, const std::string& cacheFilename) {
+  SPDLOG_INFO("Converting {} into a mappable FST at {}, this only has to be done once", fstFilename,
+              cacheFilename);
+  std::unique_ptr<fst::Fst<fst::StdArc>> graph;
+  try {
+    graph.reset(fst::ReadFstKaldiGeneric(fstFilename));
+  } catch (const std::exception& e) {
+    SPDLOG_ERROR("Could not read FST from {}: {}", fstFilename, e.what());
+    return false;
+  }
+  const MappableFst mappable(*graph);
+
+  // Written under another name first so that a crash never leaves a truncated cache behind
+  const auto tempFilename = cacheFilename + ".tmp";
+  {
+    std::ofstream strm(tempFilename, std::ios_base::out | std::ios_base::binary);
+    fst::FstWriteOptions writeOptions(tempFilename);
+    writeOptions.align = true;
+    if (!strm || !mappable.Write(strm, writeOptions)) {
+      SPDLOG_ERROR("Could not write mappable FST to {}", tempFilename);
+      return false;
+    }
+  }
+
+  std::error_code error;
+  std::filesystem::rename(tempFilename, cacheFilename, error);
+  if (error) {
+    SPDLOG_ERROR("Could not move {} to {}: {}", tempFilename, cacheFilename, error.message());
+    return false;
+  }
+  return true;
+}
+
+} // namespace
+
+/**
+ * readMappedFst
+ */
+std::unique_ptr<fst::Fst<fst::StdArc>> readMappedFst(const std::string& fstFilename,
+                                                     std::string cacheFilename) {
+  if (kaldi::ClassifyRxfilename(fstFilename) != kaldi::kFileInput) {
+    SPDLOG_WARN("Can only map a plain file, not {}", fstFilename);
+    return nullptr;
+  }
+  std::error_code error;
+  if (!std::filesystem::is_regular_file(fstFilename, error)) {
+    SPDLOG_WARN("Can't map {}, it isn't a file", fstFilename);
+    return nullptr;
+  }
+  if (cacheFilename.empty()) {
+    cacheFilename = fstFilename + ".mapped";
+  }
+
+  std::string mappedFilename = fstFilename;
+  if (!isMappable(fstFilename)) {
+    if (!isCacheFresh(fstFilename, cacheFilename) && !writeMappable(fstFilename, cacheFilename)) {
+      return nullptr;
+    }
+    mappedFilename = cacheFilename;
+  }
+
+  std::ifstream strm(mappedFilename, std::ios_base::in | std::ios_base::binary);
+  fst::FstReadOptions readOptions(mappedFilename);
+  readOptions.mode = fst::FstReadOptions::MAP;
+  std::unique_ptr<fst::Fst<fst::StdArc>> mapped(MappableFst::Read(strm, readOptions));
+  if (!mapped) {
+    SPDLOG_ERROR("Could not map FST from {}", mappedFilename);
+    return nullptr;
+  }
+  SPDLOG_INFO("Mapped FST from {}", mappedFilename);
+  return mapped;
+}
+
+} // namespace mik
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "fstext/fstext-lib.h"
+
+namespace mik {
+
+/**
+ * @brief Memory maps the decoding graph instead of reading it into the heap, so loading it is
+ * almost instant and every server process on the machine shares the same pages. A graph that
+ * isn't already an aligned ConstFst is converted once and written to cacheFilename, later runs map
+ * that file for as long as it's newer than the graph
+ * @param fstFilename Has to be a plain file, Kaldi's pipes, offsets and standard input can't be
+ * mapped
+ * @param cacheFilename Where to write the converted graph, defaults to fstFilename + ".mapped"
+ * @return nullptr if the graph couldn't be mapped for any reason, including it not existing or not
+ * being a plain file. Nothing is thrown so the caller can fall back to reading it normally
+ */
+std::unique_ptr<fst::Fst<fst::StdArc>> readMappedFst(const std::string& fstFilename,
+                                                     std::string cacheFilename = {});
+
+} // namespace mik
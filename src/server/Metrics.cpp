@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <string_view>
+
+#include <fmt/format.h>
+
+#include "Metrics.hpp"
+
+namespace mik {
+namespace {
+
+/// @brief Prometheus spells infinity and NaN its own way, everything else is the shortest repr
+std::string formatValue(double value) {
+  if (std::isnan(value)) {
+    return "NaN";
+  } else if (std::isinf(value)) {
+    return value > 0 ? "+Inf" : "-Inf";
+  }
+  return fmt::format("{}", value);
+}
+
+void appendHeader(std::string& output, const std::string& name, const std::string& help,
+                  std::string_view type) {
+  fmt::format_to(std::back_inserter(output), "# HELP {} {}\n# TYPE {} {}\n", name, help, name,
+                 type);
+}
+
+} // namespace
+
+/**
+ * Counter::add
+ */
+void Counter::add(double amount) noexcept {
+  auto current = value_.load(std::memory_order_relaxed);
+  while (!value_.compare_exchange_weak(current, current + amount, std::memory_order_relaxed)) {
+  }
+}
+
+/**
+ * Histogram::Histogram
+ */
+Histogram::Histogram(std::vector<double> bounds)
+    : bounds_(std::move(bounds)),
+      counts_(std::make_unique<std::atomic<uint64_t>[]>(bounds_.size() + 1)) {}
+
+/**
+ * Histogram::observe
+ */
+void Histogram::observe(double value) noexcept {
+  const auto bucket = std::lower_bound(bounds_.begin(), bounds_.end(), value) - bounds_.begin();
+  counts_[static_cast<size_t>(bucket)].fetch_add(1, std::memory_order_relaxed);
+  sum_.add(value);
+}
+
+/**
+ * Histogram::cumulativeCounts
+ */
+std::vector<uint64_t> Histogram::cumulativeCounts() const {
+  std::vector<uint64_t> counts(bounds_.size() + 1);
+  uint64_t total = 0;
+  for (size_t i = 0; i < counts.size(); ++i) {
+    total += counts_[i].load(std::memory_order_relaxed);
+    counts[i] = total;
+  }
+  return counts;
+}
+
+/**
+ * latencyBuckets
+ */
+std::vector<double> latencyBuckets() {
+  return {0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60};
+}
+
+/**
+ * MetricsRegistry::addCounter
+ */
+Counter& MetricsRegistry::addCounter(std::string name, std::string help) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& metric = metrics_.emplace_back(
+      Metric{std::move(name), std::move(help), std::make_unique<Counter>(), nullptr, {}});
+  return *metric.counter;
+}
+
+/**
+ * MetricsRegistry::addHistogram
+ */
+Histogram& MetricsRegistry::addHistogram(std::string name, std::string help,
+                                         std::vector<double> bounds) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& metric = metrics_.emplace_back(Metric{std::move(name), std::move(help), nullptr,
+                                              std::make_unique<Histogram>(std::move(bounds)), {}});
+  return *metric.histogram;
+}
+
+/**
+ * MetricsRegistry::addGauge
+ */
+void MetricsRegistry::addGauge(std::string name, std::string help, std::function<double()> read) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  metrics_.emplace_back(
+      Metric{std::move(name), std::move(help), nullptr, nullptr, std::move(read)});
+}
+
+/**
+ * MetricsRegistry::render
+ * @brief Text exposition format version 0.0.4
+ */
+std::string MetricsRegistry::render() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::string output;
+  for (const auto& metric : metrics_) {
+    if (metric.counter) {
+      appendHeader(output, metric.name, metric.help, "counter");
+      fmt::format_to(std::back_inserter(output), "{} {}\n", metric.name,
+                     formatValue(metric.counter->value()));
+    } else if (metric.histogram) {
+      appendHeader(output, metric.name, metric.help, "histogram");
+      const auto& bounds = metric.histogram->bounds();
+      const auto counts = metric.histogram->cumulativeCounts();
+      for (size_t i = 0; i < bounds.size(); ++i) {
+        fmt::format_to(std::back_inserter(output), "{}_bucket{{le=\"{}\"}} {}\n", metric.name,
+                       formatValue(bounds[i]), counts[i]);
+      }
+      fmt::format_to(std::back_inserter(output), "{}_bucket{{le=\"+Inf\"}} {}\n", metric.name,
+                     counts.back());
+      fmt::format_to(std::back_inserter(output), "{}_sum {}\n{}_count {}\n", metric.name,
+                     formatValue(metric.histogram->sum()), metric.name, counts.back());
+    } else {
+      appendHeader(output, metric.name, metric.help, "gauge");
+      fmt::format_to(std::back_inserter(output), "{} {}\n", metric.name,
+                     formatValue(metric.gauge()));
+    }
+  }
+  return output;
+}
+
+/**
+ * DecodeMetrics::DecodeMetrics
+ */
+DecodeMetrics::DecodeMetrics(MetricsRegistry& registry)
+    : featureSeconds(registry.addHistogram(
+          "ristretto_feature_extraction_seconds",
+          "Time spent computing features for one chunk of audio.", latencyBuckets())),
+      advanceSeconds(registry.addHistogram("ristretto_advance_decoding_seconds",
+                                           "Time spent decoding one chunk of audio.",
+                                           latencyBuckets())),
+      latticeSeconds(registry.addHistogram(
+          "ristretto_lattice_seconds",
+          "Time spent getting a temporary or final transcript out of the decoder.",
+          latencyBuckets())),
+      realTimeFactor(registry.addHistogram(
+          "ristretto_request_real_time_factor",
+          "Time spent decoding a request over the length of its audio.",
+          {0.05, 0.1, 0.2, 0.3, 0.5, 0.75, 1, 1.5, 2, 5})),
+      audioSeconds(registry.addCounter("ristretto_audio_seconds_total",
+                                       "Length of all the audio that was decoded.")),
+      decodeSeconds(registry.addCounter("ristretto_decode_seconds_total",
+                                        "Time spent decoding audio. Divided by "
+                                        "ristretto_audio_seconds_total it's the real-time "
+                                        "factor.")) {}
+
+} // namespace mik
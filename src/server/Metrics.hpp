@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace mik {
+
+/**
+ * Counter
+ * @brief Value that only goes up, e.g. seconds of audio decoded
+ */
+class Counter {
+public:
+  void add(double amount) noexcept;
+  [[nodiscard]] double value() const noexcept { return value_.load(std::memory_order_relaxed); }
+
+private:
+  std::atomic<double> value_ = 0;
+};
+
+/**
+ * Histogram
+ * @brief Counts observations into buckets with fixed upper bounds, e.g. how long each chunk took
+ */
+class Histogram {
+public:
+  /// @param bounds Upper bounds of the buckets in increasing order, +Inf is implied
+  explicit Histogram(std::vector<double> bounds);
+
+  void observe(double value) noexcept;
+
+  /// @brief Number of observations that are <= each bound, the last one is for +Inf
+  [[nodiscard]] std::vector<uint64_t> cumulativeCounts() const;
+  [[nodiscard]] const std::vector<double>& bounds() const noexcept { return bounds_; }
+  [[nodiscard]] double sum() const noexcept { return sum_.value(); }
+
+private:
+  const std::vector<double> bounds_;
+  /// @brief Not cumulative, one more than there are bounds
+  std::unique_ptr<std::atomic<uint64_t>[]> counts_;
+  Counter sum_;
+};
+
+/// @brief Buckets for durations from a millisecond up to a minute
+[[nodiscard]] std::vector<double> latencyBuckets();
+
+/**
+ * MetricsRegistry
+ * @brief Owns every metric and renders them in the Prometheus text exposition format. Metrics are
+ * registered once up front and then updated from any thread without locking
+ */
+class MetricsRegistry {
+public:
+  /// @return Stays valid for as long as the registry
+  Counter& addCounter(std::string name, std::string help);
+  Histogram& addHistogram(std::string name, std::string help, std::vector<double> bounds);
+  /// @brief The value is read when the metrics are rendered
+  void addGauge(std::string name, std::string help, std::function<double()> read);
+
+  [[nodiscard]] std::string render() const;
+
+private:
+  struct Metric {
+    std::string name;
+    std::string help;
+    std::unique_ptr<Counter> counter;
+    std::unique_ptr<Histogram> histogram;
+    std::function<double()> gauge;
+  };
+
+  mutable std::mutex mutex_;
+  std::vector<Metric> metrics_;
+};
+
+/**
+ * DecodeMetrics
+ * @brief Timings recorded by the decoders, they're shared by every session
+ */
+struct DecodeMetrics {
+  explicit DecodeMetrics(MetricsRegistry& registry);
+
+  /// @brief Per chunk
+  Histogram& featureSeconds;
+  Histogram& advanceSeconds;
+  /// @brief Per temporary or final transcript
+  Histogram& latticeSeconds;
+  /// @brief Per request, the time spent decoding over the length of its audio
+  Histogram& realTimeFactor;
+  /// @brief Their rates give the real-time factor over any period
+  Counter& audioSeconds;
+  Counter& decodeSeconds;
+};
+
+/**
+ * ScopedTimer
+ * @brief Observes how long it was alive into a histogram, does nothing without one
+ */
+class ScopedTimer {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit ScopedTimer(Histogram* histogram) noexcept
+      : histogram_(histogram), start_(histogram ? Clock::now() : Clock::time_point()) {}
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+  ~ScopedTimer() {
+    if (histogram_) {
+      histogram_->observe(std::chrono::duration<double>(Clock::now() - start_).count());
+    }
+  }
+
+private:
+  Histogram* histogram_;
+  Clock::time_point start_;
+};
+
+} // namespace mik
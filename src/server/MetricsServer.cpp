@@ -0,0 +1,145 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <string_view>
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include "MetricsServer.hpp"
+
+namespace mik {
+namespace {
+
+/// @brief How often the serving thread checks whether it should stop
+constexpr int PollTimeoutMs = 200;
+/// @brief Scrapers send small requests, anything bigger is cut off
+constexpr size_t MaxRequestSize = 8192;
+
+void sendAll(int fd, std::string_view data) {
+  while (!data.empty()) {
+    const auto sent = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+    if (sent <= 0) {
+      if (sent < 0 && errno == EINTR) {
+        continue;
+      }
+      return;
+    }
+    data.remove_prefix(static_cast<size_t>(sent));
+  }
+}
+
+std::string makeResponse(std::string_view status, std::string_view contentType,
+                         std::string_view body) {
+  return fmt::format("HTTP/1.1 {}\r\nContent-Type: {}\r\nContent-Length: {}\r\n"
+                     "Connection: close\r\n\r\n{}",
+                     status, contentType, body.size(), body);
+}
+
+} // namespace
+
+/**
+ * MetricsServer::MetricsServer
+ */
+MetricsServer::MetricsServer(const std::string& address, uint16_t port, Render render)
+    : render_(std::move(render)) {
+  sockaddr_in socketAddress{};
+  socketAddress.sin_family = AF_INET;
+  socketAddress.sin_port = htons(port);
+  if (::inet_pton(AF_INET, address.c_str(), &socketAddress.sin_addr) != 1) {
+    SPDLOG_ERROR("Invalid metrics address \"{}\"", address);
+    return;
+  }
+
+  const int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    SPDLOG_ERROR("Couldn't create the metrics socket: {}", std::strerror(errno));
+    return;
+  }
+  const int reuse = 1;
+  ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  // NOLINTNEXTLINE: sockaddr_in is meant to be passed as a sockaddr
+  if (::bind(fd, reinterpret_cast<sockaddr*>(&socketAddress), sizeof(socketAddress)) != 0 ||
+      ::listen(fd, SOMAXCONN) != 0) {
+    SPDLOG_ERROR("Couldn't serve metrics on {}:{}: {}", address, port, std::strerror(errno));
+    ::close(fd);
+    return;
+  }
+
+  socklen_t addressLength = sizeof(socketAddress);
+  // NOLINTNEXTLINE: sockaddr_in is meant to be passed as a sockaddr
+  ::getsockname(fd, reinterpret_cast<sockaddr*>(&socketAddress), &addressLength);
+  listenFd_ = fd;
+  port_ = ntohs(socketAddress.sin_port);
+  serveThread_ = std::thread(&MetricsServer::serveLoop, this);
+  SPDLOG_INFO("Serving metrics on http://{}:{}/metrics", address, port_);
+}
+
+/**
+ * MetricsServer::~MetricsServer
+ */
+MetricsServer::~MetricsServer() {
+  isShuttingDown_ = true;
+  if (serveThread_.joinable()) {
+    serveThread_.join();
+  }
+  if (listenFd_ >= 0) {
+    ::close(listenFd_);
+  }
+}
+
+/**
+ * MetricsServer::serveLoop
+ * @brief Polls with a timeout instead of blocking in accept() so that it notices shutdown
+ */
+void MetricsServer::serveLoop() {
+  pollfd listenPoll{listenFd_, POLLIN, 0};
+  while (!isShuttingDown_) {
+    const int ready = ::poll(&listenPoll, 1, PollTimeoutMs);
+    if (ready <= 0) {
+      continue;
+    }
+    const int connectionFd = ::accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (connectionFd < 0) {
+      continue;
+    }
+    handleConnection(connectionFd);
+    ::close(connectionFd);
+  }
+}
+
+/**
+ * MetricsServer::handleConnection
+ */
+void MetricsServer::handleConnection(int connectionFd) {
+  // Don't let a client that never finishes its request hold up scrapes
+  timeval timeout{1, 0};
+  ::setsockopt(connectionFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  std::string request;
+  std::array<char, 1024> buffer{};
+  while (request.find("\r\n\r\n") == std::string::npos && request.size() < MaxRequestSize) {
+    const auto received = ::recv(connectionFd, buffer.data(), buffer.size(), 0);
+    if (received <= 0) {
+      break;
+    }
+    request.append(buffer.data(), static_cast<size_t>(received));
+  }
+
+  const auto requestLine = std::string_view(request).substr(0, request.find("\r\n"));
+  if (requestLine.rfind("GET /metrics ", 0) == 0 || requestLine.rfind("GET / ", 0) == 0) {
+    sendAll(connectionFd,
+            makeResponse("200 OK", "text/plain; version=0.0.4; charset=utf-8", render_()));
+  } else {
+    SPDLOG_DEBUG("Metrics server got an unexpected request: {}", requestLine);
+    sendAll(connectionFd, makeResponse("404 Not Found", "text/plain", "Not found\n"));
+  }
+}
+
+} // namespace mik
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+
+namespace mik {
+
+/**
+ * MetricsServer
+ * @brief Bare-bones HTTP server that answers GET /metrics with whatever render returns, so that
+ * Prometheus can scrape the server. Requests are handled one at a time on its own thread
+ */
+class MetricsServer {
+public:
+  using Render = std::function<std::string()>;
+
+  /// @param port 0 picks any free port, see port()
+  MetricsServer(const std::string& address, uint16_t port, Render render);
+  MetricsServer(const MetricsServer&) = delete;
+  MetricsServer(MetricsServer&&) = delete;
+  ~MetricsServer();
+
+  /// @return false if the address couldn't be bound, nothing is served then
+  [[nodiscard]] bool isListening() const noexcept { return listenFd_ >= 0; }
+  [[nodiscard]] uint16_t port() const noexcept { return port_; }
+
+private:
+  void serveLoop();
+  void handleConnection(int connectionFd);
+
+  const Render render_;
+  int listenFd_ = -1;
+  uint16_t port_ = 0;
+  std::atomic<bool> isShuttingDown_ = false;
+  std::thread serveThread_;
+};
+
+} // namespace mik
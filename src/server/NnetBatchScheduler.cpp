@@ -0,0 +1,109 @@
+#include <algorithm>
+
+#include <spdlog/spdlog.h>
+
+#include "nnet3/nnet-utils.h"
+
+#include "KaldiInterface.hpp"
+#include "NnetBatchScheduler.hpp"
+
+using namespace kaldi;
+namespace mik {
+namespace {
+
+/// @brief The batch options have to agree with the looped decoding options on these
+nnet3::NnetBatchComputerOptions batchOptions(const Nnet3Config& config) {
+  auto options = config.batchOpts;
+  options.acoustic_scale = config.decodableOpts.acoustic_scale;
+  options.frame_subsampling_factor = config.decodableOpts.frame_subsampling_factor;
+  return options;
+}
+
+} // namespace
+
+/**
+ * NnetBatchScheduler::NnetBatchScheduler
+ */
+NnetBatchScheduler::NnetBatchScheduler(const Nnet3Model& model, const Nnet3Config& config)
+    : options_(batchOptions(config)), frameSubsampling_(options_.frame_subsampling_factor),
+      chunkFrames_(std::max(1, options_.frames_per_chunk / frameSubsampling_)),
+      maxWait_(config.batchMaxWaitMs),
+      // Log priors are subtracted and the acoustic scale is applied by the computer
+      computer_(options_, model.acousticModel().GetNnet(), model.acousticModel().Priors()) {
+
+  nnet3::ComputeSimpleNnetContext(model.acousticModel().GetNnet(), &leftContext_, &rightContext_);
+  leftContext_ += options_.extra_left_context;
+  rightContext_ += options_.extra_right_context;
+
+  schedulerThread_ = std::thread(&NnetBatchScheduler::schedulerLoop, this);
+  SPDLOG_INFO("Started NnetBatchScheduler with minibatch size {}, {} frames per chunk, context "
+              "{}/{}",
+              options_.minibatch_size, chunkFrames_, leftContext_, rightContext_);
+}
+
+/**
+ * NnetBatchScheduler::~NnetBatchScheduler
+ */
+NnetBatchScheduler::~NnetBatchScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    isShuttingDown_ = true;
+  }
+  taskCv_.notify_all();
+  if (schedulerThread_.joinable()) {
+    schedulerThread_.join();
+  }
+}
+
+/**
+ * NnetBatchScheduler::compute
+ */
+void NnetBatchScheduler::compute(std::vector<nnet3::NnetInferenceTask>* tasks) {
+  for (auto& task : *tasks) {
+    computer_.AcceptTask(&task);
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pendingTasks_ += tasks->size();
+  }
+  taskCv_.notify_one();
+
+  for (auto& task : *tasks) {
+    task.semaphore.Wait();
+  }
+}
+
+/**
+ * NnetBatchScheduler::schedulerLoop
+ */
+void NnetBatchScheduler::schedulerLoop() {
+  const auto minibatchSize = static_cast<size_t>(std::max(1, options_.minibatch_size));
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    taskCv_.wait(lock, [this] { return isShuttingDown_ || pendingTasks_ > 0; });
+    if (pendingTasks_ == 0) {
+      // Only gets here when shutting down, every task has been evaluated
+      return;
+    }
+
+    // Give other sessions a moment to add their chunks so that they end up in the same minibatch
+    taskCv_.wait_for(lock, maxWait_, [this, minibatchSize] {
+      return isShuttingDown_ || pendingTasks_ >= minibatchSize;
+    });
+    // Anything added after this is picked up in the next round, if it hasn't been already
+    const auto tasksSeen = pendingTasks_;
+    lock.unlock();
+
+    // Full minibatches first, then whatever is left over
+    while (computer_.Compute(false)) {
+    }
+    while (computer_.Compute(true)) {
+    }
+
+    lock.lock();
+    pendingTasks_ -= tasksSeen;
+  }
+}
+
+} // namespace mik
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "nnet3/nnet-batch-compute.h"
+
+#include "ServerConfig.hpp"
+
+namespace mik {
+
+class Nnet3Model;
+
+/**
+ * NnetBatchScheduler
+ * @brief Evaluates the shared acoustic model for many sessions at once. Sessions hand over chunks
+ * of features, a single thread groups whatever has arrived into minibatches and evaluates each one
+ * as a single large computation instead of one small computation per session
+ */
+class NnetBatchScheduler {
+public:
+  NnetBatchScheduler(const Nnet3Model& model, const Nnet3Config& config);
+  NnetBatchScheduler(const NnetBatchScheduler&) = delete;
+  NnetBatchScheduler(NnetBatchScheduler&&) = delete;
+  ~NnetBatchScheduler();
+
+  /// @brief Evaluates the tasks along with other sessions' tasks, blocks until all are done
+  void compute(std::vector<kaldi::nnet3::NnetInferenceTask>* tasks);
+
+  /// @brief Input frames needed before the first frame of a chunk
+  [[nodiscard]] kaldi::int32 leftContext() const noexcept { return leftContext_; }
+  /// @brief Input frames needed after the last frame of a chunk
+  [[nodiscard]] kaldi::int32 rightContext() const noexcept { return rightContext_; }
+  /// @brief Output frames in each chunk, every session uses the same size so they can be batched
+  [[nodiscard]] kaldi::int32 chunkFrames() const noexcept { return chunkFrames_; }
+  [[nodiscard]] kaldi::int32 frameSubsampling() const noexcept { return frameSubsampling_; }
+
+private:
+  void schedulerLoop();
+
+  const kaldi::nnet3::NnetBatchComputerOptions options_;
+  kaldi::int32 leftContext_ = 0;
+  kaldi::int32 rightContext_ = 0;
+  const kaldi::int32 frameSubsampling_;
+  const kaldi::int32 chunkFrames_;
+  /// @brief How long to wait for other sessions before evaluating a partial minibatch
+  const std::chrono::milliseconds maxWait_;
+
+  kaldi::nnet3::NnetBatchComputer computer_;
+
+  std::mutex mutex_;
+  std::condition_variable taskCv_;
+  /// @brief Tasks that were handed to computer_ and may not have been evaluated yet
+  size_t pendingTasks_ = 0;
+  bool isShuttingDown_ = false;
+  std::thread schedulerThread_;
+};
+
+} // namespace mik
@@ -1,78 +1,311 @@
+#include <fmt/format.h>
 #include <grpc++/grpc++.h>
 #include <grpc/support/log.h>
 #include <nlohmann/json.hpp>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <cstdint>
 #include <fstream>
 #include <memory>
 
 #include "RistrettoServer.hpp"
 namespace mik {
+namespace {
 
-/// @brief Placeholder name for the first decoding session
-const std::string firstSessionToken = "firstSession";
+/// @brief Returned to clients when there's no room for another session
+const grpc::Status sessionLimitStatus(grpc::StatusCode::RESOURCE_EXHAUSTED,
+                                      "Server is at its session limit, try again later");
+
+/// @brief Returned when nobody is waiting for the transcript anymore, the client doesn't see it
+const grpc::Status expiredStatus(grpc::StatusCode::DEADLINE_EXCEEDED,
+                                 "Deadline passed before the audio was decoded");
+
+/// @brief Returned when the audio's encoding isn't supported or the compressed audio is corrupt
+const grpc::Status invalidAudioStatus(grpc::StatusCode::INVALID_ARGUMENT,
+                                      "Couldn't decode the audio");
+
+/// @brief Metadata that tells a refused client how many milliseconds to wait before trying again
+constexpr char RetryAfterKey[] = "retry-after-ms";
 
 /**
- * RistrettoServer::RistrettoServer
+ * overloadStatus
+ * @brief Sends the retry-after hint in the trailing metadata, which clients read along with the
+ * status
  */
-// NOLINTNEXTLINE: Passing command line args to Kaldi
-RistrettoServer::RistrettoServer(int argc, const char** argv)
-    : sessionMapMutex_(), sessionMap_(), argc_(argc), argv_(argv) {
+grpc::Status overloadStatus(grpc::ServerContext& ctx, const Admission& admission) {
+  ctx.AddTrailingMetadata(RetryAfterKey, std::to_string(admission.retryAfter.count()));
+  return grpc::Status(grpc::StatusCode::RESOURCE_EXHAUSTED, admission.reason);
+}
 
-  SPDLOG_INFO("Inserting firstSessionToken placeholder");
-  // Create an Nnet3Data in anticipation of a session
-  sessionMap_.emplace(
-      std::piecewise_construct, std::forward_as_tuple(firstSessionToken),
-      std::forward_as_tuple(argc_, argv_)); // NOLINT: Passing command line args to Kaldi
+/**
+ * toJobPriority
+ * @param defaultPriority What the RPC gets when the client didn't ask for one
+ */
+JobPriority toJobPriority(RistrettoProto::Priority priority, JobPriority defaultPriority) {
+  switch (priority) {
+  case RistrettoProto::INTERACTIVE:
+    return JobPriority::Interactive;
+  case RistrettoProto::BATCH:
+    return JobPriority::Batch;
+  default:
+    return defaultPriority;
+  }
+}
 
-  SPDLOG_INFO("Constructed RistrettoServer");
+/**
+ * toAudioEncoding
+ */
+AudioEncoding toAudioEncoding(RistrettoProto::AudioEncoding encoding) {
+  switch (encoding) {
+  case RistrettoProto::FLAC:
+    return AudioEncoding::Flac;
+  case RistrettoProto::OPUS:
+    return AudioEncoding::Opus;
+  default:
+    return AudioEncoding::Linear16;
+  }
 }
 
-void RistrettoServer::updateSessionMap(const std::string& sessionToken) {
+/**
+ * addSegment
+ * @brief Appends the segment to the transcript's segments and text
+ * @param produceTime Prefix the segment's times to it in the transcript's text, the segment's own
+ * text never has them
+ */
+void addSegment(const TranscriptSegment& segment, bool produceTime,
+                RistrettoProto::Transcript* transcript) {
+  auto* protoSegment = transcript->add_segments();
+  protoSegment->set_text(segment.text);
+  protoSegment->set_starttime(segment.startTime);
+  protoSegment->set_endtime(segment.endTime);
+  for (const auto& word : segment.words) {
+    auto* protoWord = protoSegment->add_words();
+    protoWord->set_text(word.text);
+    protoWord->set_confidence(word.confidence);
+    protoWord->set_starttime(word.startTime);
+    protoWord->set_endtime(word.endTime);
+  }
+  for (const auto& alternative : segment.alternatives) {
+    auto* protoAlternative = protoSegment->add_alternatives();
+    protoAlternative->set_text(alternative.text);
+    protoAlternative->set_cost(alternative.cost);
+  }
 
-  std::lock_guard<std::mutex> lock(sessionMapMutex_);
+  auto* text = transcript->mutable_text();
+  if (!text->empty()) {
+    text->push_back(' ');
+  }
+  if (produceTime) {
+    text->append(fmt::format("{:.2f} {:.2f} ", segment.startTime, segment.endTime));
+  }
+  text->append(segment.text);
+}
+
+} // namespace
 
-  // If the first session token is available, use that
+/**
+ * RistrettoServer::RistrettoServer
+ */
+RistrettoServer::RistrettoServer(const ServerConfig& config)
+    : config_(config), decodeMetrics_(std::make_shared<DecodeMetrics>(metrics_)),
+      queueWaitSeconds_(metrics_.addHistogram(
+          "ristretto_queue_wait_seconds",
+          "Time a request waited for a decode thread after it arrived.", latencyBuckets())),
+      requestSeconds_(metrics_.addHistogram(
+          "ristretto_request_seconds",
+          "Time from a request's audio arriving until its transcript was ready.",
+          latencyBuckets())),
+      refusedSessions_(metrics_.addCounter("ristretto_refused_sessions_total",
+                                           "New sessions refused because of --max-sessions.")),
+      overloadRefusals_(metrics_.addCounter(
+          "ristretto_overload_refusals_total",
+          "Requests refused because of --max-queue-wait-ms or --max-load.")),
+      expiredRequests_(metrics_.addCounter(
+          "ristretto_expired_requests_total",
+          "Requests and streamed audio that weren't decoded since they were cancelled or their "
+          "deadline passed.")),
+      model_(std::make_shared<const Nnet3Model>(config_.nnet3)),
+      batchScheduler_(config_.nnet3.batchInference
+                          ? std::make_shared<NnetBatchScheduler>(*model_, config_.nnet3)
+                          : nullptr),
+      sessions_(
+          [model = model_, batchScheduler = batchScheduler_, decodeMetrics = decodeMetrics_] {
+            return std::make_unique<Nnet3Data>(model, batchScheduler, decodeMetrics);
+          },
+          static_cast<size_t>(config_.maxSessions),
+          std::chrono::seconds(config_.sessionIdleTimeoutSecs),
+          static_cast<size_t>(config_.pooledDecoderCount)),
+      workerPool_(static_cast<size_t>(config_.decodeThreadCount)),
+      admission_(config_.admission, workerPool_.threadCount(), decodeMetrics_->audioSeconds,
+                 decodeMetrics_->decodeSeconds) {
 
-  const auto isFirstSessionTokenPresent = sessionMap_.find(firstSessionToken) != sessionMap_.end();
-  const auto isCurrentSessionFound = sessionMap_.find(sessionToken) != sessionMap_.end();
+  metrics_.addGauge("ristretto_active_sessions", "Sessions that currently have a decoder.",
+                    [this] { return static_cast<double>(sessions_.activeSessions()); });
+  metrics_.addGauge("ristretto_pooled_decoders", "Decoders ready for new sessions.",
+                    [this] { return static_cast<double>(sessions_.pooledDecoders()); });
+  metrics_.addGauge("ristretto_worker_queue_depth", "Jobs waiting for a decode thread.",
+                    [this] { return static_cast<double>(workerPool_.queueDepth()); });
+  metrics_.addGauge("ristretto_decode_threads", "Number of decode threads.",
+                    [this] { return static_cast<double>(workerPool_.threadCount()); });
+  metrics_.addGauge("ristretto_decode_load",
+                    "Share of the decode threads' time spent decoding, as admission sees it.",
+                    [this] { return admission_.load(); });
 
-  if (isFirstSessionTokenPresent) {
-    // New session!
-    // We're able to use the first slot in the map!
-    auto mapNode = sessionMap_.extract(firstSessionToken);
-    // Overwrite the firstSession key
-    mapNode.key() = sessionToken;
-    sessionMap_.insert(std::move(mapNode));
+  if (config_.metricsPort > 0) {
+    metricsServer_ = std::make_unique<MetricsServer>(
+        config_.metricsAddress, static_cast<uint16_t>(config_.metricsPort),
+        [this] { return metrics_.render(); });
+  }
 
-  } else if (isCurrentSessionFound) {
-    // Session is found in the map
-    SPDLOG_INFO("Found session token \"{}\" in sessionMap", sessionToken);
+  SPDLOG_INFO("Constructed RistrettoServer");
+}
 
-  } else if (!isCurrentSessionFound) {
-    // Session is not found, add it
-    SPDLOG_INFO("First appearance of session token \"{}\"", sessionToken);
-    sessionMap_.emplace(std::piecewise_construct, std::forward_as_tuple(sessionToken),
-                        std::forward_as_tuple(argc_, argv_));
+/**
+ * RistrettoServer::acquireSession
+ */
+std::shared_ptr<Nnet3Data> RistrettoServer::acquireSession(const std::string& sessionToken) {
+  auto session = sessions_.acquire(sessionToken);
+  if (!session) {
+    refusedSessions_.add(1);
   }
+  return session;
 }
 
-std::string RistrettoServer::decodeAudio(const std::string& sessionToken, uint32_t audioId,
-                                         std::unique_ptr<std::string> audioDataPtr) {
+/**
+ * RistrettoServer::admit
+ */
+Admission RistrettoServer::admit(bool isNewStream) {
+  auto admission = admission_.admit(isNewStream, workerPool_.queueDepth());
+  if (!admission.admitted) {
+    overloadRefusals_.add(1);
+    SPDLOG_DEBUG("Refusing request, retry after {} ms:{}", admission.retryAfter.count(),
+                 admission.reason);
+  }
+  return admission;
+}
 
-  this->updateSessionMap(sessionToken);
+/**
+ * RistrettoServer::submitDecodeJob
+ */
+void RistrettoServer::submitDecodeJob(WorkerPool::Job job, JobPriority priority,
+                                      WorkerPool::Clock::time_point deadline) {
+  workerPool_.submit(
+      [this, job = std::move(job), queued = std::chrono::steady_clock::now()] {
+        const auto started = std::chrono::steady_clock::now();
+        queueWaitSeconds_.observe(std::chrono::duration<double>(started - queued).count());
+        job();
+        admission_.recordJob(
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count());
+      },
+      priority, deadline);
+}
 
-  // Note: I tried just deferencing with sessionMap_[sessionToken].decodeAudio() but that somehow
-  // compiled into a copy
-  const auto sessionIt = sessionMap_.find(sessionToken);
-  return sessionIt->second.decodeAudio(sessionToken, audioId, std::move(audioDataPtr));
+/**
+ * RistrettoServer::recordRequestLatency
+ */
+void RistrettoServer::recordRequestLatency(
+    std::chrono::steady_clock::time_point received) noexcept {
+  requestSeconds_.observe(
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - received).count());
 }
+
 /**
  * RistrettoServer::~RistrettoServer
  */
 RistrettoServer::~RistrettoServer() {
-  server_->Shutdown();
-  completionQueue_->Shutdown();
+  if (server_) {
+    server_->Shutdown();
+  }
+  // Let any in-flight decoding finish before the completion queues go away
+  workerPool_.shutdown();
+  for (auto& completionQueue : completionQueues_) {
+    completionQueue->Shutdown();
+  }
+  for (auto& pollingThread : pollingThreads_) {
+    if (pollingThread.joinable()) {
+      pollingThread.join();
+    }
+  }
+}
+
+/**
+ * RistrettoServer::takeFileDecoder
+ * @brief Only taken through FileDecoder so it always comes back
+ */
+std::unique_ptr<Nnet3Data> RistrettoServer::takeFileDecoder() {
+  {
+    std::lock_guard<std::mutex> lock(fileDecoderMutex_);
+    if (!fileDecoders_.empty()) {
+      auto decoder = std::move(fileDecoders_.back());
+      fileDecoders_.pop_back();
+      return decoder;
+    }
+  }
+  SPDLOG_INFO("Constructing a decoder for DecodeFile");
+  return std::make_unique<Nnet3Data>(model_, batchScheduler_, decodeMetrics_);
+}
+
+/**
+ * RistrettoServer::returnFileDecoder
+ * @brief Keeps the decoder for the next piece. Decoding a piece ends its stream, even when it fails
+ */
+void RistrettoServer::returnFileDecoder(std::unique_ptr<Nnet3Data> decoder) {
+  std::lock_guard<std::mutex> lock(fileDecoderMutex_);
+  fileDecoders_.emplace_back(std::move(decoder));
+}
+
+/**
+ * steadyDeadline
+ */
+WorkerPool::Clock::time_point steadyDeadline(std::chrono::system_clock::time_point deadline) {
+  const auto now = std::chrono::system_clock::now();
+  // Without a deadline it's the end of time, which doesn't fit on the other clock
+  if (deadline - now > std::chrono::hours(24 * 365)) {
+    return WorkerPool::Clock::time_point::max();
+  }
+  return WorkerPool::Clock::now() +
+         std::chrono::duration_cast<WorkerPool::Clock::duration>(deadline - now);
+}
+
+/**
+ * hasExpired
+ */
+bool hasExpired(const std::atomic<bool>& isCancelled, WorkerPool::Clock::time_point deadline) {
+  return isCancelled.load() || WorkerPool::Clock::now() > deadline;
+}
+
+/**
+ * modelServerInfo
+ */
+RistrettoProto::ServerInfo modelServerInfo(unsigned int sampleRate, uint32_t chunkSamples,
+                                           float frameDuration) {
+  RistrettoProto::ServerInfo info;
+  info.set_samplerate(sampleRate);
+  info.set_chunksamples(chunkSamples);
+  info.set_frameduration(frameDuration);
+  info.add_encodings(RistrettoProto::LINEAR16);
+  if (isEncodingSupported(AudioEncoding::Flac, sampleRate)) {
+    info.add_encodings(RistrettoProto::FLAC);
+  }
+  if (isEncodingSupported(AudioEncoding::Opus, sampleRate)) {
+    info.add_encodings(RistrettoProto::OPUS);
+  }
+  return info;
+}
+
+/**
+ * RistrettoServer::serverInfo
+ */
+RistrettoProto::ServerInfo RistrettoServer::serverInfo() const {
+  auto info = modelServerInfo(static_cast<unsigned int>(model_->sampleFrequency()),
+                              static_cast<uint32_t>(model_->chunkLength()),
+                              model_->frameDuration());
+  info.set_activesessions(static_cast<uint32_t>(sessions_.activeSessions()));
+  info.set_maxsessions(static_cast<uint32_t>(config_.maxSessions));
+  info.set_queuedjobs(static_cast<uint32_t>(workerPool_.queueDepth()));
+  info.set_decodethreads(static_cast<uint32_t>(workerPool_.threadCount()));
+  return info;
 }
 
 /**
@@ -80,35 +313,51 @@ RistrettoServer::~RistrettoServer() {
  */
 void RistrettoServer::run() {
   SPDLOG_DEBUG("run() start");
+  start();
+  for (auto& pollingThread : pollingThreads_) {
+    pollingThread.join();
+  }
+}
 
-  const auto serverAddress = static_cast<std::string>(DefaultServerAddress);
+/**
+ * RistrettoServer::start
+ */
+void RistrettoServer::start() {
+  const auto& serverAddress = config_.address;
 
   grpc::ServerBuilder builder;
   builder.AddListeningPort(serverAddress, grpc::InsecureServerCredentials());
   builder.RegisterService(&service_);
-  completionQueue_ = builder.AddCompletionQueue();
+  for (int i = 0; i < config_.completionQueueCount; ++i) {
+    completionQueues_.emplace_back(builder.AddCompletionQueue());
+  }
   server_ = builder.BuildAndStart();
   fmt::print("Server started. Listening on {}\n", serverAddress);
 
-  handleRpcs();
+  for (auto& completionQueue : completionQueues_) {
+    pollingThreads_.emplace_back(&RistrettoServer::handleRpcs, this, completionQueue.get());
+  }
+  SPDLOG_INFO("Polling {} completion queues, decoding on {} threads", completionQueues_.size(),
+              workerPool_.threadCount());
 }
 
 /**
  * RistrettoServer::handleRpcs
  */
-void RistrettoServer::handleRpcs() {
-  new AsyncCallData(&service_, completionQueue_.get(), getServerReference());
+void RistrettoServer::handleRpcs(grpc::ServerCompletionQueue* completionQueue) {
+  new AsyncCallData(&service_, completionQueue, getServerReference());
+  new StreamCallData(&service_, completionQueue, getServerReference());
+  new FileCallData(&service_, completionQueue, getServerReference());
+  new ServerInfoCallData(&service_, completionQueue, getServerReference());
   void* tag;
   bool ok;
   SPDLOG_DEBUG("about to process Rpcs");
 
-  while (true) {
-
-    GPR_ASSERT(completionQueue_->Next(&tag, &ok));
-    GPR_ASSERT(ok);
-
-    static_cast<AsyncCallData*>(tag)->proceed();
+  // Next() only returns false once the queue has been shut down and drained
+  while (completionQueue->Next(&tag, &ok)) {
+    static_cast<CallData*>(tag)->proceed(ok);
   }
+  SPDLOG_DEBUG("Completion queue was shut down");
 }
 
 /**
@@ -116,40 +365,553 @@ void RistrettoServer::handleRpcs() {
  */
 AsyncCallData::AsyncCallData(RistrettoProto::Decoder::AsyncService* service,
                              grpc::ServerCompletionQueue* cq, RistrettoServer& serverRef)
-    : service_(service), completionQueue_(cq), responder_(&ctx_), status_(CREATE),
-      serverRef_(serverRef) {
+    : service_(service), completionQueue_(cq), doneTag_(*this), responder_(&ctx_),
+      status_(CREATE), serverRef_(serverRef) {
   SPDLOG_DEBUG("Constructing AsyncCallData");
-  proceed();
+  proceed(true);
 }
 
 /**
  * AsyncCallData::proceed
  */
-void AsyncCallData::proceed() {
+void AsyncCallData::proceed(bool ok) {
   SPDLOG_DEBUG("Running AsyncCallData state machine with state:{}", static_cast<int>(status_));
+  if (!ok && status_ == PROCESS) {
+    // Outstanding requests are cancelled when the server is shutting down, they never started so
+    // the done tag doesn't come back either
+    SPDLOG_DEBUG("Dropping AsyncCallData since the operation was not ok");
+    delete this;
+    return;
+  }
+
   if (status_ == CREATE) {
     status_ = PROCESS;
 
+    ctx_.AsyncNotifyWhenDone(&doneTag_);
     service_->RequestDecodeAudio(&ctx_, &audioData_, &responder_, completionQueue_,
                                  completionQueue_, this);
   } else if (status_ == PROCESS) {
     new AsyncCallData(service_, completionQueue_, serverRef_);
 
-    SPDLOG_DEBUG("Starting decoding...");
-    const auto text =
-        serverRef_.decodeAudio(audioData_.sessiontoken(), audioData_.audioid(),
-                               std::unique_ptr<std::string>(audioData_.release_audio()));
-    transcript_.set_text(text);
-    transcript_.set_audioid(audioData_.audioid());
-    transcript_.set_sessiontoken(audioData_.sessiontoken());
+    // Refused before anything is queued. Audio of a session that's already decoding is never
+    // refused, a gap in the middle of the stream would garble its transcript
+    const auto admission =
+        serverRef_.admit(!serverRef_.hasSession(audioData_.sessiontoken()));
+    if (!admission.admitted) {
+      status_ = FINISH;
+      responder_.FinishWithError(overloadStatus(ctx_, admission), this);
+      return;
+    }
+
+    // Decoding can take a while, let a worker do it so this completion queue can keep polling
+    deadline_ = steadyDeadline(ctx_.deadline());
+    const auto priority = toJobPriority(audioData_.priority(), JobPriority::Interactive);
+    serverRef_.submitDecodeJob([this, received = std::chrono::steady_clock::now()] {
+      if (hasExpired(isCancelled_, deadline_)) {
+        // Otherwise the session's later audio would wait for this audioId until --read-timeout.
+        // A session isn't started just for that, it would take a decoder for nothing
+        if (serverRef_.hasSession(audioData_.sessiontoken())) {
+          if (const auto session = serverRef_.acquireSession(audioData_.sessiontoken())) {
+            session->skipAudio(audioData_.sessiontoken(), audioData_.audioid(),
+                               audioData_.endofstream());
+          }
+        }
+        serverRef_.recordExpiredRequest();
+        status_ = FINISH;
+        responder_.FinishWithError(expiredStatus, this);
+        return;
+      }
+
+      const auto session = serverRef_.acquireSession(audioData_.sessiontoken());
+      if (!session) {
+        status_ = FINISH;
+        responder_.FinishWithError(sessionLimitStatus, this);
+        return;
+      }
+
+      SPDLOG_DEBUG("Starting decoding...");
+      auto error = DecodeError::None;
+      const auto segments = session->decodeAudio(
+          audioData_.sessiontoken(), audioData_.audioid(),
+          std::unique_ptr<std::string>(audioData_.release_audio()), audioData_.endofstream(), {},
+          toAudioEncoding(audioData_.encoding()), &error);
+      if (error == DecodeError::InvalidAudio) {
+        status_ = FINISH;
+        responder_.FinishWithError(invalidAudioStatus, this);
+        return;
+      }
+      for (const auto& segment : segments) {
+        addSegment(segment, serverRef_.produceTime(), &transcript_);
+      }
+      transcript_.set_audioid(audioData_.audioid());
+      transcript_.set_sessiontoken(audioData_.sessiontoken());
+      serverRef_.recordRequestLatency(received);
+
+      // Set before calling Finish() since the completion may be handled on another thread
+      status_ = FINISH;
+      SPDLOG_DEBUG("Responding with transcript: {}", transcript_.text());
+      responder_.Finish(transcript_, grpc::Status::OK, this);
+    }, priority, deadline_);
+  } else {
+    GPR_ASSERT(status_ == FINISH);
+    isFinished_ = true;
+    if (isDone_) {
+      delete this;
+    }
+  }
+}
+
+/**
+ * AsyncCallData::onDone
+ */
+void AsyncCallData::onDone() {
+  isCancelled_ = ctx_.IsCancelled();
+  isDone_ = true;
+  if (isFinished_) {
+    delete this;
+  }
+}
+
+/**
+ * FileCallData::FileCallData
+ */
+FileCallData::FileCallData(RistrettoProto::Decoder::AsyncService* service,
+                           grpc::ServerCompletionQueue* cq, RistrettoServer& serverRef)
+    : service_(service), completionQueue_(cq), doneTag_(*this), responder_(&ctx_),
+      status_(CREATE), serverRef_(serverRef) {
+  SPDLOG_DEBUG("Constructing FileCallData");
+  proceed(true);
+}
+
+/**
+ * FileCallData::proceed
+ */
+void FileCallData::proceed(bool ok) {
+  if (!ok && status_ == PROCESS) {
+    SPDLOG_DEBUG("Dropping FileCallData since the operation was not ok");
+    delete this;
+    return;
+  }
+
+  if (status_ == CREATE) {
+    status_ = PROCESS;
+    ctx_.AsyncNotifyWhenDone(&doneTag_);
+    service_->RequestDecodeFile(&ctx_, &audioData_, &responder_, completionQueue_,
+                                completionQueue_, this);
+  } else if (status_ == PROCESS) {
+    new FileCallData(service_, completionQueue_, serverRef_);
+    receivedAt_ = std::chrono::steady_clock::now();
+
+    const auto admission = serverRef_.admit(true);
+    if (!admission.admitted) {
+      status_ = FINISH;
+      responder_.FinishWithError(overloadStatus(ctx_, admission), this);
+      return;
+    }
+
+    // The recording is only split once it's PCM, it's all here so it's decoded in one go
+    if (audioData_.encoding() != RistrettoProto::LINEAR16) {
+      auto decoder = makeAudioDecoder(
+          toAudioEncoding(audioData_.encoding()),
+          static_cast<unsigned int>(serverRef_.segmentationOptions().sampleRate));
+      std::string pcm;
+      if (!decoder || !decoder->decode(audioData_.audio(), &pcm)) {
+        status_ = FINISH;
+        responder_.FinishWithError(invalidAudioStatus, this);
+        return;
+      }
+      *audioData_.mutable_audio() = std::move(pcm);
+    }
+
+    spans_ = splitAtSilence(audioData_.audio(), serverRef_.segmentationOptions());
+    SPDLOG_INFO("DecodeFile split {} bytes of audio into {} pieces", audioData_.audio().size(),
+                spans_.size());
+    if (spans_.empty()) {
+      respond();
+      return;
+    }
 
+    spanTranscripts_.resize(spans_.size());
+    remainingSpans_ = spans_.size();
+    deadline_ = steadyDeadline(ctx_.deadline());
+    const auto priority = toJobPriority(audioData_.priority(), JobPriority::Batch);
+    for (size_t i = 0; i < spans_.size(); ++i) {
+      serverRef_.submitDecodeJob([this, i] { decodeSegment(i); }, priority, deadline_);
+    }
+  } else {
+    GPR_ASSERT(status_ == FINISH);
+    isFinished_ = true;
+    if (isDone_) {
+      delete this;
+    }
+  }
+}
+
+/**
+ * FileCallData::onDone
+ */
+void FileCallData::onDone() {
+  isCancelled_ = ctx_.IsCancelled();
+  isDone_ = true;
+  if (isFinished_) {
+    delete this;
+  }
+}
+
+/**
+ * FileCallData::decodeSegment
+ * @brief Decodes one piece of the recording from a fresh stream, then shifts its times by where the
+ * piece starts. Runs on a worker
+ */
+void FileCallData::decodeSegment(size_t index) {
+  // Once nobody is waiting, the pieces that are left are skipped and respond() tells the client
+  if (hasExpired(isCancelled_, deadline_)) {
+    if (--remainingSpans_ == 0) {
+      respond();
+    }
+    return;
+  }
+
+  const auto& span = spans_[index];
+  const auto& audio = audioData_.audio();
+  const auto begin = span.begin * sizeof(int16_t);
+  const auto end = std::min(audio.size(), span.end * sizeof(int16_t));
+
+  try {
+    FileDecoder decoder(serverRef_);
+    auto error = DecodeError::None;
+    auto segments = decoder->decodeAudio(audioData_.sessiontoken(), 0,
+                                         std::make_unique<std::string>(audio, begin, end - begin),
+                                         true, {}, AudioEncoding::Linear16, &error);
+    if (error != DecodeError::None) {
+      SPDLOG_ERROR("Couldn't decode piece {} of the file", index);
+      pieceFailed_ = true;
+    }
+
+    const auto offsetSecs =
+        static_cast<float>(span.begin) / serverRef_.segmentationOptions().sampleRate;
+    for (auto& segment : segments) {
+      offsetSegment(&segment, offsetSecs);
+    }
+    spanTranscripts_[index] = std::move(segments);
+  } catch (const std::exception& e) {
+    SPDLOG_ERROR("Couldn't decode piece {} of the file:{}", index, e.what());
+    pieceFailed_ = true;
+  }
+
+  // The last piece to finish responds, the decrement orders every piece's writes before it
+  if (--remainingSpans_ == 0) {
+    respond();
+  }
+}
+
+/**
+ * FileCallData::respond
+ * @brief Stitches the pieces' transcripts together in order, fails if any piece couldn't be decoded
+ */
+void FileCallData::respond() {
+  if (hasExpired(isCancelled_, deadline_)) {
+    serverRef_.recordExpiredRequest();
+    status_ = FINISH;
+    responder_.FinishWithError(expiredStatus, this);
+    return;
+  }
+  // A transcript with a piece missing from the middle would pass for the whole recording
+  if (pieceFailed_) {
     status_ = FINISH;
-    SPDLOG_DEBUG("Responding with transcript: {}", text);
-    responder_.Finish(transcript_, grpc::Status::OK, this);
+    responder_.FinishWithError(
+        grpc::Status(grpc::StatusCode::INTERNAL, "Couldn't decode part of the audio"), this);
+    return;
+  }
+
+  for (const auto& segments : spanTranscripts_) {
+    for (const auto& segment : segments) {
+      addSegment(segment, serverRef_.produceTime(), &transcript_);
+    }
+  }
+  transcript_.set_audioid(audioData_.audioid());
+  transcript_.set_sessiontoken(audioData_.sessiontoken());
+  transcript_.set_isfinal(true);
+  serverRef_.recordRequestLatency(receivedAt_);
+
+  status_ = FINISH;
+  SPDLOG_DEBUG("Responding with file transcript: {}", transcript_.text());
+  responder_.Finish(transcript_, grpc::Status::OK, this);
+}
+
+/**
+ * ServerInfoCallData::ServerInfoCallData
+ */
+ServerInfoCallData::ServerInfoCallData(RistrettoProto::Decoder::AsyncService* service,
+                                       grpc::ServerCompletionQueue* cq, RistrettoServer& serverRef)
+    : service_(service), completionQueue_(cq), responder_(&ctx_), status_(CREATE),
+      serverRef_(serverRef) {
+  SPDLOG_DEBUG("Constructing ServerInfoCallData");
+  proceed(true);
+}
+
+/**
+ * ServerInfoCallData::proceed
+ */
+void ServerInfoCallData::proceed(bool ok) {
+  if (!ok) {
+    SPDLOG_DEBUG("Dropping ServerInfoCallData since the operation was not ok");
+    delete this;
+    return;
+  }
+
+  if (status_ == CREATE) {
+    status_ = PROCESS;
+    service_->RequestGetServerInfo(&ctx_, &request_, &responder_, completionQueue_,
+                                   completionQueue_, this);
+  } else if (status_ == PROCESS) {
+    new ServerInfoCallData(service_, completionQueue_, serverRef_);
+    status_ = FINISH;
+    responder_.Finish(serverRef_.serverInfo(), grpc::Status::OK, this);
   } else {
     GPR_ASSERT(status_ == FINISH);
     delete this;
   }
 }
 
-} // namespace mik
\ No newline at end of file
+/**
+ * StreamCallData::StreamCallData
+ */
+StreamCallData::StreamCallData(RistrettoProto::Decoder::AsyncService* service,
+                               grpc::ServerCompletionQueue* cq, RistrettoServer& serverRef)
+    : service_(service), completionQueue_(cq), stream_(&ctx_),
+      connectOp_(*this, &StreamCallData::onConnect),
+      metadataOp_(*this, &StreamCallData::onMetadataSent), readOp_(*this, &StreamCallData::onRead),
+      writeOp_(*this, &StreamCallData::onWrite), finishOp_(*this, &StreamCallData::onFinish),
+      doneOp_(*this, &StreamCallData::onDone), serverRef_(serverRef) {
+  SPDLOG_DEBUG("Constructing StreamCallData");
+  ctx_.AsyncNotifyWhenDone(&doneOp_);
+  service_->RequestDecodeStream(&ctx_, &stream_, completionQueue_, completionQueue_, &connectOp_);
+}
+
+/**
+ * StreamCallData::onConnect
+ */
+void StreamCallData::onConnect(bool ok) {
+  if (!ok) {
+    // The server is shutting down, the stream never started so doneOp_ doesn't come back either
+    delete this;
+    return;
+  }
+  // Let another client connect
+  new StreamCallData(service_, completionQueue_, serverRef_);
+  deadline_ = steadyDeadline(ctx_.deadline());
+
+  const auto admission = serverRef_.admit(true);
+  if (!admission.admitted) {
+    // The client waits for the initial metadata before it sends anything, so the hint goes in
+    // there too. Nothing was read, so there's nothing else to wait for
+    ctx_.AddInitialMetadata(RetryAfterKey, std::to_string(admission.retryAfter.count()));
+    {
+      std::lock_guard<std::mutex> lock(writeMutex_);
+      readsDone_ = true;
+      finishStatus_ = overloadStatus(ctx_, admission);
+      isFinishing_ = true;
+    }
+    finish();
+    return;
+  }
+
+  SPDLOG_INFO("DecodeStream started");
+  // Tells the client that it was admitted, reading starts once that's sent
+  stream_.SendInitialMetadata(&metadataOp_);
+}
+
+/**
+ * StreamCallData::onMetadataSent
+ */
+void StreamCallData::onMetadataSent([[maybe_unused]] bool ok) {
+  // If the client went away the read fails, which finishes the RPC
+  startRead();
+}
+
+/**
+ * StreamCallData::startRead
+ */
+void StreamCallData::startRead() { stream_.Read(&audioData_, &readOp_); }
+
+/**
+ * StreamCallData::onRead
+ */
+void StreamCallData::onRead(bool ok) {
+  if (!ok) {
+    // The client is done sending audio. Nothing is being decoded since the next read only starts
+    // after the previous audio was decoded
+    SPDLOG_INFO("DecodeStream client finished sending audio");
+    serverRef_.submitDecodeJob([this] {
+      // Nobody is left to send the last transcripts to when the client cancelled
+      auto error = DecodeError::None;
+      if (session_ && !isCancelled_) {
+        // Flush out whatever is left in the decoder, held audio included
+        [[maybe_unused]] const auto segments = session_->finishStream(
+            sessionToken_,
+            [this](const TranscriptSegment& segment, bool isFinal) {
+              queueTranscript(segment, isFinal);
+            },
+            &error);
+      }
+      bool canFinish = false;
+      {
+        std::lock_guard<std::mutex> lock(writeMutex_);
+        readsDone_ = true;
+        if (error == DecodeError::InvalidAudio) {
+          finishStatus_ = invalidAudioStatus;
+        }
+        canFinish = shouldFinish();
+      }
+      if (canFinish) {
+        finish();
+      }
+    }, JobPriority::Interactive, deadline_);
+    return;
+  }
+
+  // Decode on a worker, the next read is started once this audio has been fed to the decoder
+  const auto priority = toJobPriority(audioData_.priority(), JobPriority::Interactive);
+  serverRef_.submitDecodeJob([this, received = std::chrono::steady_clock::now()] {
+    if (hasExpired(isCancelled_, deadline_)) {
+      // The read fails now that the stream is over, which finishes it
+      serverRef_.recordExpiredRequest();
+      startRead();
+      return;
+    }
+    if (!session_ || sessionToken_ != audioData_.sessiontoken()) {
+      sessionToken_ = audioData_.sessiontoken();
+      session_ = serverRef_.acquireSession(sessionToken_);
+      if (!session_) {
+        finishWithError(sessionLimitStatus);
+        return;
+      }
+    }
+    const auto audioId = audioData_.audioid();
+    SPDLOG_DEBUG("Decoding streamed audioId:{}", audioId);
+    auto error = DecodeError::None;
+    [[maybe_unused]] const auto segments = session_->decodeAudio(
+        sessionToken_, audioId, std::unique_ptr<std::string>(audioData_.release_audio()),
+        audioData_.endofstream(),
+        [this](const TranscriptSegment& segment, bool isFinal) {
+          queueTranscript(segment, isFinal);
+        },
+        toAudioEncoding(audioData_.encoding()), &error);
+    serverRef_.recordRequestLatency(received);
+    if (error == DecodeError::InvalidAudio) {
+      finishWithError(invalidAudioStatus);
+      return;
+    }
+    startRead();
+  }, priority, deadline_);
+}
+
+/**
+ * StreamCallData::queueTranscript
+ * @brief Writes the transcript right away if possible, otherwise it's written once the current
+ * write finishes
+ */
+void StreamCallData::queueTranscript(const TranscriptSegment& segment, bool isFinal) {
+  if (segment.text.empty()) {
+    return;
+  }
+  RistrettoProto::Transcript transcript;
+  addSegment(segment, serverRef_.produceTime(), &transcript);
+  transcript.set_audioid(audioData_.audioid());
+  transcript.set_sessiontoken(sessionToken_);
+  transcript.set_isfinal(isFinal);
+
+  std::lock_guard<std::mutex> lock(writeMutex_);
+  writeQueue_.emplace_back(std::move(transcript));
+  if (!isWriting_) {
+    isWriting_ = true;
+    stream_.Write(writeQueue_.front(), &writeOp_);
+  }
+}
+
+/**
+ * StreamCallData::onWrite
+ */
+void StreamCallData::onWrite(bool ok) {
+  bool canFinish = false;
+  {
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    writeQueue_.pop_front();
+    if (!ok) {
+      // The client went away, there's nobody to send the rest to
+      SPDLOG_WARN("DecodeStream write failed, dropping {} transcripts", writeQueue_.size());
+      writeQueue_.clear();
+    }
+
+    if (writeQueue_.empty()) {
+      isWriting_ = false;
+      canFinish = shouldFinish();
+    } else {
+      stream_.Write(writeQueue_.front(), &writeOp_);
+    }
+  }
+  if (canFinish) {
+    finish();
+  }
+}
+
+/**
+ * StreamCallData::shouldFinish
+ * @brief The RPC can be finished once the client is done sending and every transcript was written.
+ * Only returns true once, writeMutex_ must be held
+ */
+bool StreamCallData::shouldFinish() {
+  if (readsDone_ && !isWriting_ && !isFinishing_) {
+    isFinishing_ = true;
+    return true;
+  }
+  return false;
+}
+
+/**
+ * StreamCallData::finish
+ * @brief Must be called without holding writeMutex_, this may be deleted as soon as it returns
+ */
+void StreamCallData::finish() { stream_.Finish(finishStatus_, &finishOp_); }
+
+/**
+ * StreamCallData::finishWithError
+ * @brief Stops reading and ends the RPC with the status once pending writes are done
+ */
+void StreamCallData::finishWithError(const grpc::Status& status) {
+  bool canFinish = false;
+  {
+    std::lock_guard<std::mutex> lock(writeMutex_);
+    readsDone_ = true;
+    finishStatus_ = status;
+    canFinish = shouldFinish();
+  }
+  if (canFinish) {
+    finish();
+  }
+}
+
+/**
+ * StreamCallData::onFinish
+ */
+void StreamCallData::onFinish([[maybe_unused]] bool ok) {
+  SPDLOG_INFO("DecodeStream finished");
+  isFinished_ = true;
+  if (isDone_) {
+    delete this;
+  }
+}
+
+/**
+ * StreamCallData::onDone
+ */
+void StreamCallData::onDone([[maybe_unused]] bool ok) {
+  isCancelled_ = ctx_.IsCancelled();
+  isDone_ = true;
+  if (isFinished_) {
+    delete this;
+  }
+}
+
+} // namespace mik
@@ -1,15 +1,28 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <deque>
 #include <filesystem>
-#include <map>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include <fmt/core.h>
 #include <grpc++/grpc++.h>
 #include <grpc/support/log.h>
 #include <spdlog/spdlog.h>
 
+#include "AdmissionControl.hpp"
+#include "AudioSegmentation.hpp"
 #include "KaldiInterface.hpp"
+#include "Metrics.hpp"
+#include "MetricsServer.hpp"
+#include "NnetBatchScheduler.hpp"
+#include "ServerConfig.hpp"
+#include "SessionManager.hpp"
+#include "WorkerPool.hpp"
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wuseless-cast" // NOLINT: Clang-tidy is not aware of the warning,
@@ -21,6 +34,22 @@
 
 namespace mik {
 
+using SessionManager = BasicSessionManager<Nnet3Data>;
+
+/// @brief The client's deadline on the workers' clock, max if it didn't set one
+[[nodiscard]] WorkerPool::Clock::time_point
+steadyDeadline(std::chrono::system_clock::time_point deadline);
+/// @brief Nobody is waiting for the result of a call that was cancelled or is past its deadline,
+/// decoding it would only take time away from live users
+[[nodiscard]] bool hasExpired(const std::atomic<bool>& isCancelled,
+                              WorkerPool::Clock::time_point deadline);
+
+/// @brief What GetServerInfo says about the audio the model takes, PCM first and then the
+/// encodings that can be decoded at its rate. The load is left for the server to fill in
+[[nodiscard]] RistrettoProto::ServerInfo modelServerInfo(unsigned int sampleRate,
+                                                         uint32_t chunkSamples,
+                                                         float frameDuration);
+
 /**
  * RistrettoServer
  * @brief Top level class that's to be instantiated in main() and ran
@@ -29,60 +58,330 @@ namespace mik {
  */
 class RistrettoServer {
 public:
-  // NOLINTNEXTLINE: Passing command line args to Kaldi
-  explicit RistrettoServer(int argc, const char** argv);
+  explicit RistrettoServer(const ServerConfig& config);
   // There should only be one, ensure that this is not copied
   RistrettoServer(const RistrettoServer&) = delete;
   RistrettoServer(RistrettoServer&&) = delete;
   virtual ~RistrettoServer();
 
+  /// @brief Starts serving and blocks for as long as the server runs
   void run();
+  /// @brief Starts serving without blocking, the server stops when it's destroyed
+  void start();
 
   // Give AsyncCallData objects the ability to use the single server instance
   [[nodiscard]] RistrettoServer& getServerReference() { return *this; }
 
-  // Any async call should be able to call this function
-  [[nodiscard]] std::string decodeAudio(const std::string& sessionToken, uint32_t audioId,
-                                        std::unique_ptr<std::string> audioDataPtr);
+  /**
+   * @brief Any async call should be able to call this function. The session stays alive for as
+   * long as the returned pointer is held
+   * @return nullptr when the server is at its session limit
+   */
+  [[nodiscard]] std::shared_ptr<Nnet3Data> acquireSession(const std::string& sessionToken);
+
+  /// @brief Whether the decode threads can take on the request, checked before anything is queued
+  /// @param isNewStream The request starts a session or stream instead of continuing one, requests
+  /// that continue one are always admitted
+  [[nodiscard]] Admission admit(bool isNewStream);
+  [[nodiscard]] bool hasSession(const std::string& sessionToken) {
+    return sessions_.contains(sessionToken);
+  }
+
+  /// @brief Runs a job on one of the decoding threads so the completion queue can keep polling
+  /// @param deadline Of the client's call, jobs with earlier ones run first
+  void submitDecodeJob(
+      WorkerPool::Job job, JobPriority priority = JobPriority::Interactive,
+      WorkerPool::Clock::time_point deadline = WorkerPool::Clock::time_point::max());
+  /// @brief Counts audio that wasn't decoded since nobody was waiting for it anymore
+  void recordExpiredRequest() noexcept { expiredRequests_.add(1); }
+
+  /// @brief Records how long a request took since its audio arrived
+  void recordRequestLatency(std::chrono::steady_clock::time_point received) noexcept;
+
+  /// @brief Whether transcripts' text starts each segment with its times
+  [[nodiscard]] bool produceTime() const noexcept { return config_.nnet3.produceTime; }
+
+  [[nodiscard]] const SegmentationOptions& segmentationOptions() const noexcept {
+    return config_.segmentation;
+  }
+
+  /// @brief What the model takes and the current load, answers GetServerInfo
+  [[nodiscard]] RistrettoProto::ServerInfo serverInfo() const;
 
 private:
-  static constexpr std::string_view DefaultServerAddress = "0.0.0.0:5050";
-  void updateSessionMap(const std::string& sessionToken);
+  friend class FileDecoder;
+  [[nodiscard]] std::unique_ptr<Nnet3Data> takeFileDecoder();
+  void returnFileDecoder(std::unique_ptr<Nnet3Data> decoder);
 
-  void handleRpcs();
-  std::unique_ptr<grpc::ServerCompletionQueue> completionQueue_;
+  void handleRpcs(grpc::ServerCompletionQueue* completionQueue);
+  std::vector<std::unique_ptr<grpc::ServerCompletionQueue>> completionQueues_;
+  /// @brief One thread per completion queue
+  std::vector<std::thread> pollingThreads_;
   RistrettoProto::Decoder::AsyncService service_;
   std::unique_ptr<grpc::Server> server_;
 
-  std::mutex sessionMapMutex_;
-  /// @brief SessionToken mapped to Nnet3Data
-  std::map<std::string, mik::Nnet3Data> sessionMap_;
+  const ServerConfig config_;
+
+  /// @brief Has to outlive everything that records into it
+  MetricsRegistry metrics_;
+  std::shared_ptr<DecodeMetrics> decodeMetrics_;
+  Histogram& queueWaitSeconds_;
+  Histogram& requestSeconds_;
+  Counter& refusedSessions_;
+  Counter& overloadRefusals_;
+  Counter& expiredRequests_;
+
+  /// @brief Acoustic model, FST and symbol table shared by every session
+  std::shared_ptr<const mik::Nnet3Model> model_;
+  /// @brief Only set with --batch-inference
+  std::shared_ptr<NnetBatchScheduler> batchScheduler_;
+
+  /// @brief SessionToken mapped to Nnet3Data, idle sessions are evicted
+  SessionManager sessions_;
+
+  /// @brief Decoders for DecodeFile pieces. Pieces are only decoded on the workers so there's at
+  /// most one per decode thread
+  std::mutex fileDecoderMutex_;
+  std::vector<std::unique_ptr<Nnet3Data>> fileDecoders_;
+
+  /// @brief Runs the decoding so that a long utterance doesn't block the completion queues
+  WorkerPool workerPool_;
+  /// @brief Measures how busy workerPool_ is
+  AdmissionController admission_;
+  /// @brief Only set with --metrics-port, it's stopped first since it reads everything above
+  std::unique_ptr<MetricsServer> metricsServer_;
+};
+
+/**
+ * FileDecoder
+ * @brief Decoder for one piece of a DecodeFile recording, not tied to any session. It goes back to
+ * the server for the next piece when this goes out of scope, even if decoding the piece threw
+ */
+class FileDecoder {
+public:
+  explicit FileDecoder(RistrettoServer& serverRef)
+      : serverRef_(serverRef), decoder_(serverRef.takeFileDecoder()) {}
+  FileDecoder(const FileDecoder&) = delete;
+  FileDecoder& operator=(const FileDecoder&) = delete;
+  ~FileDecoder() { serverRef_.returnFileDecoder(std::move(decoder_)); }
+
+  Nnet3Data* operator->() const noexcept { return decoder_.get(); }
+
+private:
+  RistrettoServer& serverRef_;
+  std::unique_ptr<Nnet3Data> decoder_;
+};
+
+/**
+ * CallData
+ * @brief Anything that's used as a tag on the completion queue
+ */
+class CallData {
+public:
+  virtual ~CallData() = default;
+  /// @param ok Whether the completion queue operation was successful
+  virtual void proceed(bool ok) = 0;
+};
+
+/**
+ * DoneTag
+ * @brief Tag for AsyncNotifyWhenDone. It comes back once the RPC is over, whether it was finished
+ * or cancelled, and only then can the call's IsCancelled() be used. It isn't returned for calls
+ * that never started
+ */
+template <typename Call>
+class DoneTag : public CallData {
+public:
+  explicit DoneTag(Call& call) : call_(call) {}
+  void proceed([[maybe_unused]] bool ok) override { call_.onDone(); }
 
-  // Kaldi cmd line args
-  const int argc_;    // NOLINT: Passing command line args to Kaldi
-  const char** argv_; // NOLINT: Passing command line args to Kaldi
+private:
+  Call& call_;
 };
 
-class AsyncCallData {
+/**
+ * AsyncCallData
+ * @brief Handles a single unary DecodeAudio RPC
+ */
+class AsyncCallData : public CallData {
 public:
   AsyncCallData(RistrettoProto::Decoder::AsyncService* service, grpc::ServerCompletionQueue* cq,
                 RistrettoServer& serverRef);
-  void proceed();
+  void proceed(bool ok) override;
+
+private:
+  friend class DoneTag<AsyncCallData>;
+  void onDone();
+
+  RistrettoProto::Decoder::AsyncService* service_;
+  grpc::ServerCompletionQueue* completionQueue_;
+  grpc::ServerContext ctx_;
+  DoneTag<AsyncCallData> doneTag_;
+  /// @brief Set by the done tag, read by the worker before decoding
+  std::atomic<bool> isCancelled_ = false;
+  WorkerPool::Clock::time_point deadline_;
+  /// @brief This is deleted once both the finish and the done tag came back
+  bool isFinished_ = false;
+  bool isDone_ = false;
+
+  RistrettoProto::AudioData audioData_;
+  RistrettoProto::Transcript transcript_;
+
+  grpc::ServerAsyncResponseWriter<RistrettoProto::Transcript> responder_;
+
+  enum CallStatus { CREATE, PROCESS, FINISH };
+  CallStatus status_;
+
+  RistrettoServer& serverRef_;
+};
+
+/**
+ * FileCallData
+ * @brief Handles a single unary DecodeFile RPC. The recording is split at silences and every piece
+ * is decoded as its own job, whichever job finishes last puts the transcript together and responds
+ */
+class FileCallData : public CallData {
+public:
+  FileCallData(RistrettoProto::Decoder::AsyncService* service, grpc::ServerCompletionQueue* cq,
+               RistrettoServer& serverRef);
+  void proceed(bool ok) override;
 
 private:
+  friend class DoneTag<FileCallData>;
+  void onDone();
+  void decodeSegment(size_t index);
+  void respond();
+
   RistrettoProto::Decoder::AsyncService* service_;
   grpc::ServerCompletionQueue* completionQueue_;
   grpc::ServerContext ctx_;
+  DoneTag<FileCallData> doneTag_;
+  /// @brief Set by the done tag, pieces aren't decoded anymore once it's set
+  std::atomic<bool> isCancelled_ = false;
+  WorkerPool::Clock::time_point deadline_;
+  /// @brief This is deleted once both the finish and the done tag came back
+  bool isFinished_ = false;
+  bool isDone_ = false;
 
   RistrettoProto::AudioData audioData_;
   RistrettoProto::Transcript transcript_;
 
   grpc::ServerAsyncResponseWriter<RistrettoProto::Transcript> responder_;
 
+  /// @brief Pieces of audioData_'s audio, in samples
+  std::vector<AudioSpan> spans_;
+  /// @brief Transcript of each span, every job only writes to its own
+  std::vector<std::vector<TranscriptSegment>> spanTranscripts_;
+  std::atomic<size_t> remainingSpans_ = 0;
+  /// @brief Set when a piece couldn't be decoded, the RPC fails instead of leaving a gap
+  std::atomic<bool> pieceFailed_ = false;
+  std::chrono::steady_clock::time_point receivedAt_;
+
+  enum CallStatus { CREATE, PROCESS, FINISH };
+  CallStatus status_;
+
+  RistrettoServer& serverRef_;
+};
+
+/**
+ * ServerInfoCallData
+ * @brief Handles a single unary GetServerInfo RPC. There's nothing to decode so it's answered
+ * straight from the completion queue thread
+ */
+class ServerInfoCallData : public CallData {
+public:
+  ServerInfoCallData(RistrettoProto::Decoder::AsyncService* service,
+                     grpc::ServerCompletionQueue* cq, RistrettoServer& serverRef);
+  void proceed(bool ok) override;
+
+private:
+  RistrettoProto::Decoder::AsyncService* service_;
+  grpc::ServerCompletionQueue* completionQueue_;
+  grpc::ServerContext ctx_;
+
+  RistrettoProto::ServerInfoRequest request_;
+  grpc::ServerAsyncResponseWriter<RistrettoProto::ServerInfo> responder_;
+
   enum CallStatus { CREATE, PROCESS, FINISH };
   CallStatus status_;
 
   RistrettoServer& serverRef_;
 };
 
+/**
+ * StreamCallData
+ * @brief Handles a single bidirectional DecodeStream RPC. Audio is read in one message at a time
+ * and decoded on a worker, transcripts are written back as soon as the decoder produces them
+ */
+class StreamCallData {
+public:
+  StreamCallData(RistrettoProto::Decoder::AsyncService* service, grpc::ServerCompletionQueue* cq,
+                 RistrettoServer& serverRef);
+
+private:
+  /**
+   * Operation
+   * @brief Reads and writes can be outstanding at the same time so each one needs its own tag
+   */
+  class Operation : public CallData {
+  public:
+    using Handler = void (StreamCallData::*)(bool);
+    Operation(StreamCallData& call, Handler handler) : call_(call), handler_(handler) {}
+    void proceed(bool ok) override { (call_.*handler_)(ok); }
+
+  private:
+    StreamCallData& call_;
+    Handler handler_;
+  };
+
+  void onConnect(bool ok);
+  void onMetadataSent(bool ok);
+  void onRead(bool ok);
+  void onWrite(bool ok);
+  void onFinish(bool ok);
+  void onDone(bool ok);
+
+  void startRead();
+  void queueTranscript(const TranscriptSegment& segment, bool isFinal);
+  bool shouldFinish();
+  void finish();
+  void finishWithError(const grpc::Status& status);
+
+  RistrettoProto::Decoder::AsyncService* service_;
+  grpc::ServerCompletionQueue* completionQueue_;
+  grpc::ServerContext ctx_;
+
+  grpc::ServerAsyncReaderWriter<RistrettoProto::Transcript, RistrettoProto::AudioData> stream_;
+
+  Operation connectOp_;
+  Operation metadataOp_;
+  Operation readOp_;
+  Operation writeOp_;
+  Operation finishOp_;
+  Operation doneOp_;
+
+  /// @brief Only read into by the single outstanding Read()
+  RistrettoProto::AudioData audioData_;
+  std::string sessionToken_;
+  /// @brief Held for the whole stream so the session can't be evicted in between reads
+  std::shared_ptr<Nnet3Data> session_;
+  /// @brief Set by doneOp_, audio isn't decoded anymore once it's set
+  std::atomic<bool> isCancelled_ = false;
+  WorkerPool::Clock::time_point deadline_;
+  /// @brief This is deleted once both finishOp_ and doneOp_ came back
+  bool isFinished_ = false;
+  bool isDone_ = false;
+
+  /// @brief Guards everything needed for writing, transcripts come from worker threads
+  std::mutex writeMutex_;
+  /// @brief Only one write may be outstanding at a time, the rest wait in here
+  std::deque<RistrettoProto::Transcript> writeQueue_;
+  bool isWriting_ = false;
+  bool readsDone_ = false;
+  bool isFinishing_ = false;
+  grpc::Status finishStatus_ = grpc::Status::OK;
+
+  RistrettoServer& serverRef_;
+};
+
 } // namespace mik
@@ -0,0 +1,204 @@
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "util/kaldi-thread.h"
+
+#include "ConfigFile.hpp"
+#include "ServerConfig.hpp"
+
+using namespace kaldi;
+namespace mik {
+
+/**
+ * Nnet3Config::Register
+ */
+void Nnet3Config::Register(OptionsItf* opts) {
+  opts->Register("samp-freq", &sampFreq,
+                 "Sampling frequency of the input signal (coded as 16-bit slinear).");
+  opts->Register("chunk-length", &chunkLengthSecs,
+                 "Length of chunk size in seconds, that we process.");
+  opts->Register("output-period", &outputPeriod,
+                 "How often in seconds, do we check for changes in output.");
+  opts->Register("num-threads-startup", &g_num_threads,
+                 "Number of threads used when initializing iVector extractor.");
+  opts->Register("read-timeout", &readTimeout,
+                 "Number of seconds that audio which arrived ahead of the audio before it is held "
+                 "for. Once it's held for longer, the missing audio is skipped when more audio "
+                 "arrives. Use -1 to only skip it once too much audio is held.");
+  opts->Register(
+      "produce-time", &produceTime,
+      "Prepend begin/end times between endpoints to the transcript's text (e.g. '5.46 6.81 "
+      "<text_output>', in seconds). Every segment has its times in its own fields either way and "
+      "its text never has them, --word-times gives them for each word.");
+  opts->Register("nbest", &nbest,
+                 "Number of alternative transcripts to give along with each final transcript, "
+                 "best first. 1 only gives the best one.");
+  opts->Register("word-confidence", &wordConfidence,
+                 "Give the posterior probability of each word in final transcripts, computed "
+                 "from the lattice like lattice-mbr-decode does.");
+  opts->Register("word-times", &wordTimes,
+                 "Give the start and end time of each word in final transcripts, in seconds since "
+                 "the start of the stream.");
+
+  opts->Register("batch-inference", &batchInference,
+                 "Evaluate the acoustic model on chunks from many sessions in one batched "
+                 "computation instead of separately for each session. It's configured with the "
+                 "--batch.* options, the acoustic scale and frame subsampling are taken from the "
+                 "regular options. Sessions wait for their chunks on the decode threads, so use "
+                 "at least as many --num-decode-threads as sessions that should share a "
+                 "minibatch.");
+  opts->Register("batch-max-wait-ms", &batchMaxWaitMs,
+                 "With --batch-inference, milliseconds to wait for a full minibatch before "
+                 "evaluating a partial one.");
+
+  opts->Register("mmap-fst", &mmapFst,
+                 "Memory map the decoding graph so startup is fast and server processes on the "
+                 "same machine share it. A graph that isn't an aligned ConstFst is converted once "
+                 "and written to --mmap-fst-cache. Pipes and other rxfilenames that aren't plain "
+                 "files are read into memory as usual.");
+  opts->Register("mmap-fst-cache", &mmapFstCache,
+                 "Where --mmap-fst writes the converted graph. Defaults to <fst-in>.mapped");
+  opts->Register("lazy-word-syms", &lazyWordSyms,
+                 "Read the word symbol table when the first transcript is made instead of at "
+                 "startup.");
+
+  featureOpts.Register(opts);
+  decodableOpts.Register(opts);
+  decoderOpts.Register(opts);
+  endpointOpts.Register(opts);
+  // These share names with the looped decoding options so they need a prefix
+  ParseOptions batchParser("batch", opts);
+  batchOpts.Register(&batchParser);
+}
+
+/**
+ * ServerConfig::Register
+ */
+void ServerConfig::Register(OptionsItf* opts) {
+  opts->Register("ip-and-port", &address, "Address and port that clients connect to.");
+  opts->Register("num-decode-threads", &decodeThreadCount,
+                 "Number of threads that run decoding jobs. 0 uses one per hardware thread.");
+  opts->Register("num-completion-queues", &completionQueueCount,
+                 "Number of gRPC completion queues, each one is polled by its own thread.");
+  opts->Register("max-sessions", &maxSessions,
+                 "New sessions are refused with RESOURCE_EXHAUSTED once there are this many. 0 "
+                 "means no limit.");
+  opts->Register("session-idle-timeout", &sessionIdleTimeoutSecs,
+                 "Seconds without any audio before a session is evicted. 0 disables eviction.");
+  opts->Register("num-pooled-decoders", &pooledDecoderCount,
+                 "Number of decoders constructed at startup and recycled when sessions are "
+                 "evicted.");
+  opts->Register("max-queue-wait-ms", &admission.maxQueueWaitMs,
+                 "New sessions and streams are refused with RESOURCE_EXHAUSTED and a "
+                 "retry-after-ms hint once they're expected to wait longer than this for a decode "
+                 "thread. Audio of admitted sessions is never refused. 0 disables it.");
+  opts->Register("max-load", &admission.maxLoad,
+                 "New sessions and streams are refused with RESOURCE_EXHAUSTED and a "
+                 "retry-after-ms hint once the measured real-time factor says they'd keep the "
+                 "decode threads busy for more than this share of the time. 0 disables it.");
+  opts->Register("min-retry-after-ms", &admission.minRetryAfterMs,
+                 "Refused clients are never told to retry sooner than this.");
+  opts->Register("log-level", &logging.level,
+                 "Least severe messages that are logged: trace, debug, info, warning, error, "
+                 "critical or off. Release builds compile out debug and trace messages.");
+  opts->Register("log-async", &logging.async,
+                 "Write the log on a background thread so decoding never waits on the log file. "
+                 "Needs a build with ENABLE_ASYNC_LOGGING.");
+  opts->Register("log-queue-size", &logging.queueSize,
+                 "With --log-async, how many messages can wait to be written before the oldest "
+                 "are dropped.");
+  opts->Register("metrics-port", &metricsPort,
+                 "Serve decoding metrics in the Prometheus text format at "
+                 "http://<metrics-address>:<metrics-port>/metrics. 0 disables it.");
+  opts->Register("metrics-address", &metricsAddress,
+                 "Address the metrics are served on, use 0.0.0.0 to allow scraping from other "
+                 "machines.");
+  opts->Register("segment-silence-db", &segmentation.silenceThresholdDb,
+                 "DecodeFile splits recordings at silence so that the pieces can be decoded in "
+                 "parallel. Audio quieter than this many dB relative to full scale is silence.");
+  opts->Register("segment-min-silence", &segmentation.minSilenceSecs,
+                 "Seconds of silence needed before DecodeFile splits a recording there.");
+  opts->Register("segment-min-length", &segmentation.minSegmentSecs,
+                 "DecodeFile doesn't split off pieces shorter than this many seconds.");
+  opts->Register("segment-max-length", &segmentation.maxSegmentSecs,
+                 "DecodeFile splits pieces without enough silence at their quietest point once "
+                 "they're this many seconds long. 0 means no limit.");
+
+  nnet3.Register(opts);
+}
+
+/**
+ * ServerConfig::fromCommandLine
+ * @brief Parses the command line a single time into a ServerConfig
+ */
+// NOLINTNEXTLINE: Easiest to use cmd line args with kaldi
+ServerConfig ServerConfig::fromCommandLine(int argc, const char** argv) {
+  const char* usage = "Reads in audio from gRPC clients and performs online\n"
+                      "decoding with neural nets (nnet3 setup), with iVector-based\n"
+                      "speaker adaptation and endpointing.\n"
+                      "Note: some configuration values and inputs are set via config\n"
+                      "files whose filenames are passed as options\n"
+                      "\n"
+                      "Usage: RistrettoServer [options] <nnet3-in> <fst-in> <word-symbol-table>\n"
+                      "   or: RistrettoServer --server-config=serverConfig.json [options]\n";
+  ParseOptions po(usage);
+
+  ServerConfig config;
+  config.Register(&po);
+  std::string configFile;
+  po.Register("server-config", &configFile,
+              "JSON file with the server parameters and Kaldi arguments, see serverConfig.json. "
+              "Options on the command line override it.");
+
+  // The file is turned into arguments so everything is parsed once, by the same parser
+  std::vector<std::string> args(argv, argv + argc);
+  const std::string configFlag = "--server-config=";
+  const auto configArg = std::find_if(args.begin(), args.end(), [&configFlag](const auto& arg) {
+    return arg.rfind(configFlag, 0) == 0;
+  });
+  if (configArg != args.end()) {
+    const auto fileArgs = readConfigFile(configArg->substr(configFlag.size()));
+    if (!fileArgs) {
+      KALDI_ERR << "Couldn't read " << *configArg;
+    }
+    args = mergeArgs(*fileArgs, args);
+  }
+  std::vector<const char*> mergedArgv;
+  mergedArgv.reserve(args.size());
+  for (const auto& arg : args) {
+    mergedArgv.push_back(arg.c_str());
+  }
+
+  po.Read(static_cast<int>(mergedArgv.size()), mergedArgv.data());
+
+  if (po.NumArgs() != 3) {
+    po.PrintUsage();
+  }
+
+  config.nnet3.nnet3Filename = po.GetArg(1);
+  config.nnet3.fstFilename = po.GetArg(2);
+  config.nnet3.wordSymsFilename = po.GetArg(3);
+
+  if (config.decodeThreadCount <= 0) {
+    config.decodeThreadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  }
+  config.completionQueueCount = std::max(1, config.completionQueueCount);
+  config.maxSessions = std::max(0, config.maxSessions);
+  config.sessionIdleTimeoutSecs = std::max(0, config.sessionIdleTimeoutSecs);
+  config.pooledDecoderCount = std::max(0, config.pooledDecoderCount);
+  config.admission.maxQueueWaitMs = std::max(0, config.admission.maxQueueWaitMs);
+  config.admission.maxLoad = std::max(0.0, config.admission.maxLoad);
+  config.admission.minRetryAfterMs = std::max(0, config.admission.minRetryAfterMs);
+  config.metricsPort = std::clamp(config.metricsPort, 0, 65535);
+  config.segmentation.sampleRate = config.nnet3.sampFreq;
+
+  SPDLOG_INFO("Server config: listening on {}, {} decode threads, {} completion queues",
+              config.address, config.decodeThreadCount, config.completionQueueCount);
+  return config;
+}
+
+} // namespace mik
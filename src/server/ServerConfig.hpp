@@ -0,0 +1,91 @@
+#pragma once
+
+#include <string>
+
+#include "AdmissionControl.hpp"
+#include "AudioSegmentation.hpp"
+#include "Utils.hpp"
+#include "nnet3/nnet-batch-compute.h"
+#include "nnet3/nnet-utils.h"
+#include "online2/online-endpoint.h"
+#include "online2/online-nnet2-feature-pipeline.h"
+#include "online2/online-nnet3-decoding.h"
+#include "util/parse-options.h"
+
+namespace mik {
+
+/**
+ * Nnet3Config
+ * @brief Everything needed to load an Nnet3Model, registered with Kaldi's option parser
+ */
+struct Nnet3Config {
+  kaldi::OnlineNnet2FeaturePipelineConfig featureOpts;
+  kaldi::nnet3::NnetSimpleLoopedComputationOptions decodableOpts;
+  kaldi::LatticeFasterDecoderConfig decoderOpts;
+  kaldi::OnlineEndpointConfig endpointOpts;
+  kaldi::nnet3::NnetBatchComputerOptions batchOpts;
+
+  kaldi::BaseFloat chunkLengthSecs = 0.18f;
+  kaldi::BaseFloat outputPeriod = 1;
+  kaldi::BaseFloat sampFreq = 16000.0;
+  int readTimeout = 3;
+  bool produceTime = false;
+  /// @brief Number of alternative transcripts for each final transcript, 1 only gives the best
+  kaldi::int32 nbest = 1;
+  /// @brief Give the posterior probability of each word in final transcripts
+  bool wordConfidence = false;
+  /// @brief Give when each word in final transcripts starts and ends
+  bool wordTimes = false;
+  /// @brief Evaluate the acoustic model for many sessions at once instead of separately
+  bool batchInference = false;
+  int batchMaxWaitMs = 5;
+  /// @brief Memory map the decoding graph instead of reading it into the heap
+  bool mmapFst = false;
+  /// @brief Where the graph is converted to when it can't be mapped as is
+  std::string mmapFstCache;
+  /// @brief Read the symbol table when the first transcript is made instead of at startup
+  bool lazyWordSyms = false;
+
+  std::string nnet3Filename;
+  std::string fstFilename;
+  std::string wordSymsFilename;
+
+  void Register(kaldi::OptionsItf* opts);
+};
+
+/**
+ * ServerConfig
+ * @brief Top-level server configuration, holds the Kaldi config along with the server's own knobs
+ */
+struct ServerConfig {
+  /// @brief Address and port that gRPC listens on
+  std::string address = "0.0.0.0:5050";
+  /// @brief Number of threads that run decoding jobs, 0 means one per hardware thread
+  int decodeThreadCount = 0;
+  /// @brief Number of gRPC completion queues, each one is polled by its own thread
+  int completionQueueCount = 1;
+  /// @brief New sessions are refused once there are this many, 0 means no limit
+  int maxSessions = 64;
+  /// @brief Sessions that haven't sent audio for this many seconds are evicted, 0 disables eviction
+  int sessionIdleTimeoutSecs = 300;
+  /// @brief Number of decoders constructed ahead of time and recycled when sessions are evicted
+  int pooledDecoderCount = 1;
+  /// @brief When requests are refused because the decode threads can't keep up
+  AdmissionOptions admission;
+  /// @brief Where DecodeFile splits recordings to decode them in parallel
+  SegmentationOptions segmentation;
+  /// @brief Port that metrics are served on for Prometheus, 0 disables it
+  int metricsPort = 0;
+  std::string metricsAddress = "127.0.0.1";
+  LoggingConfig logging;
+
+  Nnet3Config nnet3;
+
+  void Register(kaldi::OptionsItf* opts);
+
+  /// @brief Reads --server-config first if it's given, the command line overrides what's in it
+  // NOLINTNEXTLINE: Easiest to use cmd line args with kaldi
+  static ServerConfig fromCommandLine(int argc, const char** argv);
+};
+
+} // namespace mik
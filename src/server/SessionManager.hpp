@@ -0,0 +1,270 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+namespace mik {
+
+/**
+ * BasicSessionManager
+ * @brief Maps session tokens to decoders. Sessions that haven't been used for a while are evicted
+ * and their decoders are reset and kept in a pool so that new sessions don't have to construct one.
+ * The map is split into shards with their own locks, and decoders are constructed without holding
+ * any lock, so a session being created never holds up lookups of existing sessions.
+ * Templated on the decoder so that it can be tested without loading a model.
+ * @tparam Decoder Needs a reset() method that prepares it for a new session
+ */
+template <typename Decoder>
+class BasicSessionManager {
+public:
+  using DecoderFactory = std::function<std::unique_ptr<Decoder>()>;
+  using Clock = std::chrono::steady_clock;
+
+  static constexpr size_t DefaultShardCount = 16;
+
+  /**
+   * @param maxSessions Sessions beyond this are refused, 0 means no limit
+   * @param idleTimeout Sessions that were unused for this long are evicted, 0 disables eviction
+   * @param pooledCount Number of pre-constructed decoders to keep around for new sessions
+   * @param shardCount Number of independently locked parts the session map is split into
+   */
+  BasicSessionManager(DecoderFactory factory, size_t maxSessions, std::chrono::seconds idleTimeout,
+                      size_t pooledCount, size_t shardCount = DefaultShardCount)
+      : factory_(std::move(factory)), maxSessions_(maxSessions), idleTimeout_(idleTimeout),
+        pooledCount_(pooledCount), shards_(std::max<size_t>(1, shardCount)) {
+
+    SPDLOG_INFO("Pre-constructing {} decoders", pooledCount_);
+    decoderPool_.reserve(pooledCount_);
+    for (size_t i = 0; i < pooledCount_; ++i) {
+      decoderPool_.emplace_back(factory_());
+    }
+
+    if (idleTimeout_.count() > 0) {
+      evictionThread_ = std::thread(&BasicSessionManager::evictionLoop, this);
+    }
+  }
+  BasicSessionManager(const BasicSessionManager&) = delete;
+  BasicSessionManager(BasicSessionManager&&) = delete;
+
+  ~BasicSessionManager() {
+    {
+      std::lock_guard<std::mutex> lock(evictionMutex_);
+      isShuttingDown_ = true;
+    }
+    evictionCv_.notify_all();
+    if (evictionThread_.joinable()) {
+      evictionThread_.join();
+    }
+  }
+
+  /**
+   * @brief Finds the session's decoder, or gives it one if this is the first time it was seen
+   * @return nullptr if the session is new and there's no capacity left for it
+   */
+  [[nodiscard]] std::shared_ptr<Decoder> acquire(const std::string& sessionToken) {
+    auto& shard = shardFor(sessionToken);
+    if (auto decoder = findSession(shard, sessionToken)) {
+      return decoder;
+    }
+
+    if (!reserveSession()) {
+      // Make room if anything has gone idle in the meantime
+      evictIdleSessions();
+      if (!reserveSession()) {
+        SPDLOG_WARN("At capacity with {} sessions, refusing session \"{}\"", activeSessions(),
+                    sessionToken);
+        return nullptr;
+      }
+    }
+
+    // Constructing a decoder is slow, so it's done without holding any lock
+    std::shared_ptr<Decoder> decoder = takeFromPool();
+    if (decoder) {
+      SPDLOG_INFO("Using a pooled decoder for session \"{}\"", sessionToken);
+    } else {
+      SPDLOG_INFO("Pool is empty, constructing a decoder for session \"{}\"", sessionToken);
+      try {
+        decoder = factory_();
+      } catch (...) {
+        --sessionCount_;
+        throw;
+      }
+    }
+
+    std::unique_lock<std::mutex> lock(shard.mutex);
+    // Another thread may have added the session while the lock wasn't held
+    const auto [sessionIt, wasInserted] =
+        shard.sessions.try_emplace(sessionToken, Session{decoder, Clock::now()});
+    if (!wasInserted) {
+      sessionIt->second.lastUsed = Clock::now();
+      auto existing = sessionIt->second.decoder;
+      lock.unlock();
+      --sessionCount_;
+      // Never used so it doesn't need to be reset
+      returnToPool(std::move(decoder));
+      return existing;
+    }
+    return decoder;
+  }
+
+  /**
+   * @brief Removes every session that has been idle for longer than the timeout. Sessions that are
+   * still being decoded are left alone
+   * @return Number of sessions that were evicted
+   */
+  size_t evictIdleSessions() {
+    if (idleTimeout_.count() <= 0) {
+      return 0;
+    }
+
+    std::vector<std::shared_ptr<Decoder>> evicted;
+    for (auto& shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      const auto now = Clock::now();
+      for (auto sessionIt = shard.sessions.begin(); sessionIt != shard.sessions.end();) {
+        const auto& session = sessionIt->second;
+        // The map holds the only reference when nobody is decoding with it
+        const bool isUnused = session.decoder.use_count() == 1;
+        if (isUnused && now - session.lastUsed >= idleTimeout_) {
+          SPDLOG_INFO("Evicting idle session \"{}\"", sessionIt->first);
+          evicted.emplace_back(std::move(sessionIt->second.decoder));
+          sessionIt = shard.sessions.erase(sessionIt);
+          --sessionCount_;
+        } else {
+          ++sessionIt;
+        }
+      }
+    }
+
+    // Resetting takes a while so do it without holding any lock, anything that doesn't fit in the
+    // pool is destroyed when this returns
+    const auto evictedCount = evicted.size();
+    for (auto& decoder : evicted) {
+      if (pooledDecoders() >= pooledCount_) {
+        break;
+      }
+      decoder->reset();
+      returnToPool(std::move(decoder));
+    }
+    return evictedCount;
+  }
+
+  /// @brief Whether the session has a decoder, it isn't marked as used
+  [[nodiscard]] bool contains(const std::string& sessionToken) {
+    auto& shard = shardFor(sessionToken);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.sessions.count(sessionToken) > 0;
+  }
+
+  [[nodiscard]] size_t activeSessions() const noexcept { return sessionCount_.load(); }
+
+  [[nodiscard]] size_t pooledDecoders() const {
+    std::lock_guard<std::mutex> lock(poolMutex_);
+    return decoderPool_.size();
+  }
+
+  [[nodiscard]] size_t maxSessions() const noexcept { return maxSessions_; }
+
+private:
+  struct Session {
+    std::shared_ptr<Decoder> decoder;
+    Clock::time_point lastUsed;
+  };
+
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_map<std::string, Session> sessions;
+  };
+
+  [[nodiscard]] Shard& shardFor(const std::string& sessionToken) {
+    return shards_[std::hash<std::string>{}(sessionToken) % shards_.size()];
+  }
+
+  [[nodiscard]] static std::shared_ptr<Decoder> findSession(Shard& shard,
+                                                            const std::string& sessionToken) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    const auto sessionIt = shard.sessions.find(sessionToken);
+    if (sessionIt == shard.sessions.end()) {
+      return nullptr;
+    }
+    sessionIt->second.lastUsed = Clock::now();
+    return sessionIt->second.decoder;
+  }
+
+  /// @brief Claims room for one more session, has to be given back if it isn't used
+  [[nodiscard]] bool reserveSession() noexcept {
+    auto count = sessionCount_.load();
+    do {
+      if (maxSessions_ > 0 && count >= maxSessions_) {
+        return false;
+      }
+    } while (!sessionCount_.compare_exchange_weak(count, count + 1));
+    return true;
+  }
+
+  [[nodiscard]] std::shared_ptr<Decoder> takeFromPool() {
+    std::lock_guard<std::mutex> lock(poolMutex_);
+    if (decoderPool_.empty()) {
+      return nullptr;
+    }
+    auto decoder = std::move(decoderPool_.back());
+    decoderPool_.pop_back();
+    return decoder;
+  }
+
+  /// @brief Keeps a ready-to-use decoder if there's room for it
+  void returnToPool(std::shared_ptr<Decoder> decoder) {
+    std::lock_guard<std::mutex> lock(poolMutex_);
+    if (decoderPool_.size() < pooledCount_) {
+      decoderPool_.emplace_back(std::move(decoder));
+    }
+  }
+
+  void evictionLoop() {
+    // Check often enough that a session doesn't outlive its timeout by much
+    const auto checkPeriod =
+        std::clamp(idleTimeout_ / 2, std::chrono::seconds(1), std::chrono::seconds(30));
+
+    std::unique_lock<std::mutex> lock(evictionMutex_);
+    while (!isShuttingDown_) {
+      evictionCv_.wait_for(lock, checkPeriod, [this] { return isShuttingDown_; });
+      if (isShuttingDown_) {
+        return;
+      }
+      lock.unlock();
+      evictIdleSessions();
+      lock.lock();
+    }
+  }
+
+  const DecoderFactory factory_;
+  const size_t maxSessions_;
+  const std::chrono::seconds idleTimeout_;
+  const size_t pooledCount_;
+
+  std::vector<Shard> shards_;
+  /// @brief Includes sessions that are still having their decoder constructed
+  std::atomic<size_t> sessionCount_ = 0;
+
+  mutable std::mutex poolMutex_;
+  /// @brief Ready-to-use decoders that aren't assigned to a session
+  std::vector<std::shared_ptr<Decoder>> decoderPool_;
+
+  std::mutex evictionMutex_;
+  bool isShuttingDown_ = false;
+  std::condition_variable evictionCv_;
+  std::thread evictionThread_;
+};
+
+} // namespace mik
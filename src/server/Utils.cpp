@@ -1,12 +1,17 @@
+#include <algorithm>
+
 #include <nlohmann/json.hpp>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/spdlog.h>
+#ifdef RISTRETTO_ASYNC_LOGGING
+#include <spdlog/async.h>
+#endif
 
 #include "Utils.hpp"
 
 namespace mik {
 
-void Utils::createLogger() {
+void Utils::createLogger(const LoggingConfig& config) {
   static std::atomic<bool> hasBeenCalled(false);
   if (hasBeenCalled.load()) {
     return;
@@ -17,11 +22,36 @@ void Utils::createLogger() {
   // [log level] has color enabled
   // [D/M/YR Hour:Month:Second.ms]     [thread id] [log level] [file::func():line] message
   spdlog::set_pattern("[%D %H:%M:%S.%e] [tid %t] [%^%l%$] [%s::%!():%#] %v");
-  auto logger = spdlog::basic_logger_mt("RistrettoServerLogger", "logs/ristretto-server.log", true);
+  constexpr auto LoggerName = "RistrettoServerLogger";
+  constexpr auto LogFile = "logs/ristretto-server.log";
+  std::shared_ptr<spdlog::logger> logger;
+#ifdef RISTRETTO_ASYNC_LOGGING
+  if (config.async) {
+    // A single thread keeps the messages in order, when it falls behind the oldest are dropped
+    // instead of blocking decoding
+    spdlog::init_thread_pool(static_cast<size_t>(std::max(1, config.queueSize)), 1);
+    logger = spdlog::basic_logger_mt<spdlog::async_factory_nonblock>(LoggerName, LogFile, true);
+  }
+#endif
+  if (!logger) {
+    logger = spdlog::basic_logger_mt(LoggerName, LogFile, true);
+  }
   spdlog::set_default_logger(logger);
   spdlog::flush_every(std::chrono::seconds(1));
-  spdlog::set_level(spdlog::level::debug);
+
+  const auto level = spdlog::level::from_str(config.level);
+  if (level == spdlog::level::off && config.level != "off") {
+    spdlog::set_level(spdlog::level::debug);
+    SPDLOG_WARN("Unknown log level \"{}\", using debug", config.level);
+  } else {
+    spdlog::set_level(level);
+  }
   SPDLOG_DEBUG("Debug-level logging enabled");
+#ifndef RISTRETTO_ASYNC_LOGGING
+  if (config.async) {
+    SPDLOG_INFO("Built without ENABLE_ASYNC_LOGGING, logging synchronously");
+  }
+#endif
 }
 
-} // namespace mik
\ No newline at end of file
+} // namespace mik
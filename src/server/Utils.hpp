@@ -3,14 +3,30 @@
 #include <filesystem>
 #include <fstream>
 #include <memory>
+#include <string>
 #include <string_view>
 #include <vector>
 
 namespace mik {
 
+/**
+ * LoggingConfig
+ * @brief How the server logs. Messages below SPDLOG_ACTIVE_LEVEL are compiled out regardless of the
+ * level set here
+ */
+struct LoggingConfig {
+  /// @brief spdlog level name: trace, debug, info, warning, error, critical or off
+  std::string level = "debug";
+  /// @brief Format and write messages on a background thread so decoding threads never wait on the
+  /// file. Only has an effect when built with ENABLE_ASYNC_LOGGING
+  bool async = true;
+  /// @brief Messages the background thread can fall behind by, the oldest are dropped beyond that
+  int queueSize = 8192;
+};
+
 class Utils {
 public:
-  static void createLogger();
+  static void createLogger(const LoggingConfig& config = LoggingConfig());
 };
 
-} // namespace mik
\ No newline at end of file
+} // namespace mik
@@ -0,0 +1,180 @@
+#include <algorithm>
+
+#include "lat/determinize-lattice-pruned.h"
+
+#include "KaldiInterface.hpp"
+#include "NnetBatchScheduler.hpp"
+#include "UtteranceDecoder.hpp"
+
+using namespace kaldi;
+namespace mik {
+
+/**
+ * makeInferenceTasks
+ */
+std::vector<nnet3::NnetInferenceTask> makeInferenceTasks(int32 frameCount, int32 chunkFrames,
+                                                         int32 frameSubsampling,
+                                                         int32 leftContext) {
+  chunkFrames = std::max(chunkFrames, 1);
+  const auto taskCount = std::max(0, (frameCount + chunkFrames - 1) / chunkFrames);
+  std::vector<nnet3::NnetInferenceTask> tasks(static_cast<size_t>(taskCount));
+  for (int32 i = 0; i < taskCount; ++i) {
+    auto& task = tasks[static_cast<size_t>(i)];
+    const auto taskOffset = i * chunkFrames;
+    const auto taskFrames = std::min(chunkFrames, frameCount - taskOffset);
+    // Output frames are numbered t = 0, frameSubsampling, ... and the input starts before them
+    task.first_input_t = -leftContext;
+    task.output_t_stride = frameSubsampling;
+    task.num_output_frames = taskFrames;
+    task.num_initial_unused_output_frames = 0;
+    task.num_used_output_frames = taskFrames;
+    task.first_used_output_frame_index = taskOffset;
+    task.is_edge = false;
+    task.is_irregular = taskFrames != chunkFrames;
+    task.priority = 0.0;
+    task.output_to_cpu = true;
+  }
+  return tasks;
+}
+
+/**
+ * LoopedUtteranceDecoder::LoopedUtteranceDecoder
+ */
+LoopedUtteranceDecoder::LoopedUtteranceDecoder(const Nnet3Model& model,
+                                               OnlineNnet2FeaturePipeline* featurePipeline,
+                                               int32 frameOffset)
+    : decoder_(model.decoderOptions(), model.transitionModel(), model.decodableInfo(),
+               model.decodeFst(), featurePipeline) {
+  decoder_.InitDecoding(frameOffset);
+}
+
+/**
+ * BatchedUtteranceDecoder::BatchedUtteranceDecoder
+ */
+BatchedUtteranceDecoder::BatchedUtteranceDecoder(const Nnet3Model& model,
+                                                 NnetBatchScheduler& scheduler,
+                                                 OnlineNnet2FeaturePipeline* featurePipeline,
+                                                 int32 frameOffset)
+    : model_(model), scheduler_(scheduler), featurePipeline_(*featurePipeline),
+      frameOffset_(frameOffset), decoder_(model.decodeFst(), model.decoderOptions()),
+      decodable_(model.transitionModel()) {
+  decoder_.InitDecoding();
+}
+
+/**
+ * BatchedUtteranceDecoder::advanceDecoding
+ */
+void BatchedUtteranceDecoder::advanceDecoding() {
+  computeReadyFrames();
+  decoder_.AdvanceDecoding(&decodable_);
+}
+
+/**
+ * BatchedUtteranceDecoder::computeReadyFrames
+ * @brief Evaluates the acoustic model for every whole chunk that has all of its context available.
+ * Once the input is finished the remaining frames are evaluated as well
+ */
+void BatchedUtteranceDecoder::computeReadyFrames() {
+  const auto featuresReady = featurePipeline_.NumFramesReady();
+  if (featuresReady == 0) {
+    return;
+  }
+  const bool isInputFinished = featurePipeline_.IsLastFrame(featuresReady - 1);
+  const auto frameSubsampling = scheduler_.frameSubsampling();
+
+  // Output frames, counted from the start of the stream, that have enough features
+  int32 streamFramesReady = 0;
+  if (isInputFinished) {
+    streamFramesReady = (featuresReady + frameSubsampling - 1) / frameSubsampling;
+  } else if (featuresReady > scheduler_.rightContext()) {
+    streamFramesReady = (featuresReady - 1 - scheduler_.rightContext()) / frameSubsampling + 1;
+  }
+
+  const auto firstFrame = frameOffset_ + framesComputed_;
+  const auto chunkFrames = scheduler_.chunkFrames();
+  auto framesLeft = streamFramesReady - firstFrame;
+  if (!isInputFinished) {
+    // Partial chunks would end up in a minibatch of their own
+    framesLeft -= framesLeft % chunkFrames;
+  }
+  if (framesLeft <= 0) {
+    if (isInputFinished) {
+      decodable_.InputIsFinished();
+    }
+    return;
+  }
+
+  auto tasks =
+      makeInferenceTasks(framesLeft, chunkFrames, frameSubsampling, scheduler_.leftContext());
+  for (auto& task : tasks) {
+    prepareTaskInput(firstFrame + task.first_used_output_frame_index, featuresReady, &task);
+  }
+  scheduler_.compute(&tasks);
+
+  Matrix<BaseFloat> loglikes;
+  nnet3::MergeTaskOutput(tasks, &loglikes);
+  // Frames that were already decoded aren't needed anymore
+  decodable_.AcceptLoglikes(&loglikes,
+                            decoder_.NumFramesDecoded() - decodable_.FirstAvailableFrame());
+  framesComputed_ += framesLeft;
+  if (isInputFinished) {
+    decodable_.InputIsFinished();
+  }
+}
+
+/**
+ * BatchedUtteranceDecoder::prepareTaskInput
+ * @brief Sets up the input of a task whose first output frame is the stream's output frame
+ * firstFrame, along with the context the acoustic model needs around it
+ */
+void BatchedUtteranceDecoder::prepareTaskInput(int32 firstFrame, int32 featuresReady,
+                                               nnet3::NnetInferenceTask* task) const {
+  const auto frameSubsampling = scheduler_.frameSubsampling();
+  const auto leftContext = scheduler_.leftContext();
+  const auto firstInputFrame = firstFrame * frameSubsampling - leftContext;
+  const auto inputFrameCount = (task->num_output_frames - 1) * frameSubsampling + 1 +
+                               leftContext + scheduler_.rightContext();
+
+  // Past either end of the stream the edge frames are repeated, like the looped computation does
+  std::vector<int32> inputFrames(static_cast<size_t>(inputFrameCount));
+  for (int32 i = 0; i < inputFrameCount; ++i) {
+    inputFrames[static_cast<size_t>(i)] = std::clamp(firstInputFrame + i, 0, featuresReady - 1);
+  }
+  auto* inputFeature = featurePipeline_.InputFeature();
+  Matrix<BaseFloat> input(inputFrameCount, inputFeature->Dim(), kUndefined);
+  inputFeature->GetFrames(inputFrames, &input);
+  task->input.Swap(&input);
+
+  if (auto* ivectorFeature = featurePipeline_.IvectorFeature()) {
+    // Use the most recent iVector the chunk has access to
+    const auto lastInputFrame = std::min(inputFrames.back(), ivectorFeature->NumFramesReady() - 1);
+    Vector<BaseFloat> ivector(ivectorFeature->Dim());
+    ivectorFeature->GetFrame(lastInputFrame, &ivector);
+    task->ivector.Swap(&ivector);
+  }
+}
+
+/**
+ * BatchedUtteranceDecoder::getLattice
+ * @brief Same as SingleUtteranceNnet3Decoder::GetLattice
+ */
+void BatchedUtteranceDecoder::getLattice(bool endOfUtterance, CompactLattice* clat) const {
+  if (decoder_.NumFramesDecoded() == 0) {
+    clat->DeleteStates();
+    return;
+  }
+  Lattice rawLattice;
+  decoder_.GetRawLattice(&rawLattice, endOfUtterance);
+  const auto& decoderOptions = model_.decoderOptions();
+  DeterminizeLatticePhonePrunedWrapper(model_.transitionModel(), &rawLattice,
+                                       decoderOptions.lattice_beam, clat, decoderOptions.det_opts);
+}
+
+/**
+ * BatchedUtteranceDecoder::endpointDetected
+ */
+bool BatchedUtteranceDecoder::endpointDetected(const OnlineEndpointConfig& config) const {
+  return EndpointDetected(config, model_.transitionModel(), model_.frameDuration(), decoder_);
+}
+
+} // namespace mik
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <vector>
+
+#include "decoder/decodable-matrix.h"
+#include "decoder/lattice-faster-online-decoder.h"
+#include "nnet3/nnet-batch-compute.h"
+#include "online2/online-endpoint.h"
+#include "online2/online-nnet2-feature-pipeline.h"
+#include "online2/online-nnet3-decoding.h"
+
+namespace mik {
+
+class Nnet3Model;
+class NnetBatchScheduler;
+
+/**
+ * makeInferenceTasks
+ * @brief Splits frameCount output frames into tasks of at most chunkFrames frames each and sets
+ * where their output goes. The output of MergeTaskOutput starts at row 0 on every call, so
+ * first_used_output_frame_index is the task's row in it, not its frame in the stream. The input
+ * isn't set
+ */
+std::vector<kaldi::nnet3::NnetInferenceTask> makeInferenceTasks(kaldi::int32 frameCount,
+                                                                kaldi::int32 chunkFrames,
+                                                                kaldi::int32 frameSubsampling,
+                                                                kaldi::int32 leftContext);
+
+/**
+ * UtteranceDecoder
+ * @brief Decodes a single utterance from a session's feature pipeline. Lets Nnet3Data switch
+ * between evaluating the acoustic model on its own and batching it with other sessions
+ */
+class UtteranceDecoder {
+public:
+  virtual ~UtteranceDecoder() = default;
+
+  /// @brief Decodes every frame that the feature pipeline has enough features for
+  virtual void advanceDecoding() = 0;
+  virtual void finalizeDecoding() = 0;
+  [[nodiscard]] virtual kaldi::int32 numFramesDecoded() const = 0;
+  virtual void getBestPath(bool endOfUtterance, kaldi::Lattice* bestPath) const = 0;
+  virtual void getLattice(bool endOfUtterance, kaldi::CompactLattice* clat) const = 0;
+  [[nodiscard]] virtual bool endpointDetected(const kaldi::OnlineEndpointConfig& config) const = 0;
+  /// @brief Needed for silence weighting
+  [[nodiscard]] virtual const kaldi::LatticeFasterOnlineDecoder& decoder() const = 0;
+};
+
+/**
+ * LoopedUtteranceDecoder
+ * @brief Evaluates the acoustic model with Kaldi's looped computation, separately for each session
+ */
+class LoopedUtteranceDecoder : public UtteranceDecoder {
+public:
+  /// @param frameOffset Output frames of the stream that were decoded in previous utterances
+  LoopedUtteranceDecoder(const Nnet3Model& model,
+                         kaldi::OnlineNnet2FeaturePipeline* featurePipeline,
+                         kaldi::int32 frameOffset);
+
+  void advanceDecoding() override { decoder_.AdvanceDecoding(); }
+  void finalizeDecoding() override { decoder_.FinalizeDecoding(); }
+  [[nodiscard]] kaldi::int32 numFramesDecoded() const override {
+    return decoder_.NumFramesDecoded();
+  }
+  void getBestPath(bool endOfUtterance, kaldi::Lattice* bestPath) const override {
+    decoder_.GetBestPath(endOfUtterance, bestPath);
+  }
+  void getLattice(bool endOfUtterance, kaldi::CompactLattice* clat) const override {
+    decoder_.GetLattice(endOfUtterance, clat);
+  }
+  [[nodiscard]] bool endpointDetected(const kaldi::OnlineEndpointConfig& config) const override {
+    return decoder_.EndpointDetected(config);
+  }
+  [[nodiscard]] const kaldi::LatticeFasterOnlineDecoder& decoder() const override {
+    return decoder_.Decoder();
+  }
+
+private:
+  // EndpointDetected() isn't const in Kaldi
+  mutable kaldi::SingleUtteranceNnet3Decoder decoder_;
+};
+
+/**
+ * BatchedUtteranceDecoder
+ * @brief Hands fixed-size chunks of features to the NnetBatchScheduler so the acoustic model is
+ * evaluated together with other sessions, then decodes the log-likelihoods it gets back. Unlike
+ * the looped computation each chunk recomputes its left and right context
+ */
+class BatchedUtteranceDecoder : public UtteranceDecoder {
+public:
+  /// @param frameOffset Output frames of the stream that were decoded in previous utterances
+  BatchedUtteranceDecoder(const Nnet3Model& model, NnetBatchScheduler& scheduler,
+                          kaldi::OnlineNnet2FeaturePipeline* featurePipeline,
+                          kaldi::int32 frameOffset);
+
+  void advanceDecoding() override;
+  void finalizeDecoding() override { decoder_.FinalizeDecoding(); }
+  [[nodiscard]] kaldi::int32 numFramesDecoded() const override {
+    return decoder_.NumFramesDecoded();
+  }
+  void getBestPath(bool endOfUtterance, kaldi::Lattice* bestPath) const override {
+    decoder_.GetBestPath(bestPath, endOfUtterance);
+  }
+  void getLattice(bool endOfUtterance, kaldi::CompactLattice* clat) const override;
+  [[nodiscard]] bool endpointDetected(const kaldi::OnlineEndpointConfig& config) const override;
+  [[nodiscard]] const kaldi::LatticeFasterOnlineDecoder& decoder() const override {
+    return decoder_;
+  }
+
+private:
+  void computeReadyFrames();
+  void prepareTaskInput(kaldi::int32 firstFrame, kaldi::int32 featuresReady,
+                        kaldi::nnet3::NnetInferenceTask* task) const;
+
+  const Nnet3Model& model_;
+  NnetBatchScheduler& scheduler_;
+  kaldi::OnlineNnet2FeaturePipeline& featurePipeline_;
+  const kaldi::int32 frameOffset_;
+  /// @brief Output frames of this utterance that the acoustic model was evaluated for
+  kaldi::int32 framesComputed_ = 0;
+
+  kaldi::LatticeFasterOnlineDecoder decoder_;
+  kaldi::DecodableMatrixMappedOffset decodable_;
+};
+
+} // namespace mik
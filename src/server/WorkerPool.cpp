@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <tuple>
+
+#include <spdlog/spdlog.h>
+
+#include "WorkerPool.hpp"
+
+namespace mik {
+
+/**
+ * WorkerPool::WorkerPool
+ */
+WorkerPool::WorkerPool(size_t threadCount) {
+  threads_.reserve(threadCount);
+  for (size_t i = 0; i < threadCount; ++i) {
+    threads_.emplace_back(&WorkerPool::workerLoop, this);
+  }
+  SPDLOG_INFO("Started WorkerPool with {} threads", threadCount);
+}
+
+/**
+ * WorkerPool::~WorkerPool
+ */
+WorkerPool::~WorkerPool() { shutdown(); }
+
+/**
+ * WorkerPool::submit
+ */
+void WorkerPool::submit(Job job, JobPriority priority, Clock::time_point deadline) {
+  {
+    std::lock_guard<std::mutex> lock(queueMutex_);
+    if (shuttingDown_) {
+      SPDLOG_WARN("WorkerPool is shutting down, dropping job");
+      return;
+    }
+    jobQueue_.push_back({priority, deadline, nextSequence_++, std::move(job)});
+    std::push_heap(jobQueue_.begin(), jobQueue_.end(), &WorkerPool::runsAfter);
+  }
+  queueCv_.notify_one();
+}
+
+/**
+ * WorkerPool::shutdown
+ */
+void WorkerPool::shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(queueMutex_);
+    shuttingDown_ = true;
+  }
+  queueCv_.notify_all();
+
+  for (auto& thread : threads_) {
+    if (thread.joinable()) {
+      thread.join();
+    }
+  }
+}
+
+/**
+ * WorkerPool::queueDepth
+ * @brief Number of jobs that are waiting for a thread
+ */
+size_t WorkerPool::queueDepth() const {
+  std::lock_guard<std::mutex> lock(queueMutex_);
+  return jobQueue_.size();
+}
+
+/**
+ * WorkerPool::runsAfter
+ */
+bool WorkerPool::runsAfter(const QueuedJob& lhs, const QueuedJob& rhs) noexcept {
+  return std::tie(lhs.priority, lhs.deadline, lhs.sequence) >
+         std::tie(rhs.priority, rhs.deadline, rhs.sequence);
+}
+
+/**
+ * WorkerPool::workerLoop
+ */
+void WorkerPool::workerLoop() {
+  while (true) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(queueMutex_);
+      queueCv_.wait(lock, [this] { return shuttingDown_ || !jobQueue_.empty(); });
+      if (jobQueue_.empty()) {
+        // Only happens when shutting down, every remaining job has been run
+        return;
+      }
+      std::pop_heap(jobQueue_.begin(), jobQueue_.end(), &WorkerPool::runsAfter);
+      job = std::move(jobQueue_.back().job);
+      jobQueue_.pop_back();
+    }
+
+    try {
+      job();
+    } catch (const std::exception& e) {
+      SPDLOG_ERROR("Caught std::exception from job:{}", e.what());
+    } catch (...) {
+      SPDLOG_ERROR("Caught unknown exception from job");
+    }
+  }
+}
+
+} // namespace mik
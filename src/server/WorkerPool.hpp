@@ -0,0 +1,64 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mik {
+
+/// @brief Waiting interactive jobs are always run before batch ones
+enum class JobPriority { Interactive, Batch };
+
+/**
+ * WorkerPool
+ * @brief Fixed-size pool of threads that run the most urgent job first: interactive before batch,
+ * then the earliest deadline, then the order they were submitted in. Used so that completion
+ * queue threads only have to hand off decoding work instead of running it themselves
+ */
+class WorkerPool {
+public:
+  using Job = std::function<void()>;
+  using Clock = std::chrono::steady_clock;
+
+  explicit WorkerPool(size_t threadCount);
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool(WorkerPool&&) = delete;
+  ~WorkerPool();
+
+  /// @param deadline When the job's result is no use anymore, jobs without one go last
+  void submit(Job job, JobPriority priority = JobPriority::Interactive,
+              Clock::time_point deadline = Clock::time_point::max());
+  /// @brief Finishes every job that was already submitted and joins the threads
+  void shutdown();
+
+  [[nodiscard]] size_t queueDepth() const;
+  [[nodiscard]] size_t threadCount() const noexcept { return threads_.size(); }
+
+private:
+  struct QueuedJob {
+    JobPriority priority;
+    Clock::time_point deadline;
+    uint64_t sequence;
+    Job job;
+  };
+
+  /// @brief Orders the heap so that its front is the job to run next
+  [[nodiscard]] static bool runsAfter(const QueuedJob& lhs, const QueuedJob& rhs) noexcept;
+  void workerLoop();
+
+  mutable std::mutex queueMutex_;
+  std::condition_variable queueCv_;
+  /// @brief Heap ordered by runsAfter
+  std::vector<QueuedJob> jobQueue_;
+  /// @brief Keeps jobs that are otherwise equally urgent in the order they were submitted
+  uint64_t nextSequence_ = 0;
+  bool shuttingDown_ = false;
+
+  std::vector<std::thread> threads_;
+};
+
+} // namespace mik
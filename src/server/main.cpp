@@ -4,18 +4,23 @@
 #include <spdlog/spdlog.h>
 
 #include "RistrettoServer.hpp"
+#include "ServerConfig.hpp"
 #include "Utils.hpp"
 
 int main(int argc, const char** argv) {
 
-  mik::Utils::createLogger();
+  const auto config = mik::ServerConfig::fromCommandLine(argc, argv);
+
+  mik::Utils::createLogger(config.logging);
   fmt::print("Created logger\n");
 
-  mik::RistrettoServer server(argc, argv);
+  mik::RistrettoServer server(config);
   fmt::print("Created server\n");
 
   server.run();
 
   fmt::print("Server exited unexpectedly\n");
+  // Writes out whatever the async logger still has queued
+  spdlog::shutdown();
   return 1;
 }
\ No newline at end of file
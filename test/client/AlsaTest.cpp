@@ -70,7 +70,10 @@ TEST(AlsaTest, PlaybackAudioFromFile) {
 class MockAlsaInterface : public mik::AlsaInterface {
 public:
   MockAlsaInterface(const mik::AlsaConfig& config = mik::AlsaConfig()) : AlsaInterface(config){};
-  void setAudioData(const std::vector<char>& v) { audioData_ = v; }
+  void setAudioData(const std::vector<char>& v) {
+    audioData_->write(std::string_view(v.data(), v.size()));
+  }
+  [[nodiscard]] size_t captureBufferCapacity() const { return audioData_->capacity(); }
 };
 
 TEST(AlsaTest, ConsumeAllAudio) {
@@ -107,6 +110,41 @@ TEST(AlsaTest, ConsumeDurationOfAudio_LargeRequest) {
   ASSERT_EQ(internalAudioData.size(), audioData.size());
 }
 
+TEST(AlsaTest, ConsumeAllAudioIntoString) {
+  const std::vector<char> internalAudioData(100, 'a');
+  MockAlsaInterface alsa;
+  alsa.setAudioData(internalAudioData);
+
+  std::string audioData = "prefix";
+  ASSERT_EQ(internalAudioData.size(), alsa.consumeAllAudioData(&audioData));
+  EXPECT_EQ("prefix" + std::string(100, 'a'), audioData);
+  EXPECT_EQ(0, alsa.audioDataAvailableBytes());
+}
+
+TEST(AlsaTest, CaptureBufferOverrun) {
+  mik::AlsaConfig config;
+  config.captureBuffer_ms = 100;
+  MockAlsaInterface alsa(config);
+  const auto capacity = config.captureBufferBytes();
+
+  // Audio that doesn't fit is dropped and counted, what's already there is kept
+  alsa.setAudioData(std::vector<char>(capacity));
+  alsa.setAudioData(std::vector<char>(config.periodSizeBytes));
+  EXPECT_EQ(capacity, alsa.audioDataAvailableBytes());
+  EXPECT_EQ(config.periodSizeBytes, alsa.overrunBytes());
+}
+
+TEST(AlsaTest, WaitForAudioData) {
+  MockAlsaInterface alsa;
+  alsa.setAudioData(std::vector<char>(100));
+
+  EXPECT_TRUE(alsa.waitForAudioData(100, 0ms));
+  // Nothing is recording, so more audio is never coming and it doesn't wait for the timeout
+  const auto start = std::chrono::steady_clock::now();
+  EXPECT_FALSE(alsa.waitForAudioData(200, 10s));
+  EXPECT_LT(std::chrono::steady_clock::now() - start, 1s);
+}
+
 TEST(AlsaTest, CalcAudioDurationAndSize) {
   MockAlsaInterface alsa;
   const auto singlePeriodSize = alsa.getConfiguration().periodSizeBytes;
@@ -122,4 +160,26 @@ TEST(AlsaTest, CalcAudioDurationAndSize) {
   const auto size = alsa.audioDurationToBytes(duration);
 
   ASSERT_EQ(singlePeriodSize, size);
-}
\ No newline at end of file
+}
+TEST(AlsaTest, FailedUpdateKeepsConfiguration) {
+  MockAlsaInterface alsa;
+  const auto before = alsa.getConfiguration();
+  const auto capacity = alsa.captureBufferCapacity();
+
+  auto config = before;
+  config.pcmDesc = "nonexistent";
+  config.samplingFreq_Hz = before.samplingFreq_Hz * 2;
+  EXPECT_EQ(mik::Status::ERROR, alsa.updateConfiguration(config));
+  EXPECT_EQ(before, alsa.getConfiguration());
+  EXPECT_EQ(capacity, alsa.captureBufferCapacity());
+}
+
+TEST(AlsaTest, UpdateResizesCaptureBuffer) {
+  MockAlsaInterface alsa;
+  auto config = alsa.getConfiguration();
+  config.samplingFreq_Hz = 16000;
+  ASSERT_EQ(mik::Status::SUCCESS, alsa.updateConfiguration(config));
+
+  // The buffer still holds captureBuffer_ms of audio at whatever rate the device gave
+  EXPECT_EQ(alsa.getConfiguration().captureBufferBytes(), alsa.captureBufferCapacity());
+}
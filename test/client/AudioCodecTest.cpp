@@ -0,0 +1,59 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+
+#include "AudioCodec.hpp"
+
+namespace {
+
+/// @brief Number of length-prefixed packets, or -1 if the stream doesn't split into them evenly
+int countOpusPackets(const std::string& stream) {
+  int count = 0;
+  size_t position = 0;
+  while (stream.size() - position >= 2) {
+    const auto length = static_cast<size_t>(static_cast<uint8_t>(stream[position])) |
+                        static_cast<size_t>(static_cast<uint8_t>(stream[position + 1])) << 8;
+    position += 2 + length;
+    ++count;
+  }
+  return position == stream.size() ? count : -1;
+}
+
+} // namespace
+
+// @test Samples are held back until a 20 ms packet is full, finish() pads the last one
+TEST(AudioCodecTest, OpusPackets) {
+  mik::OpusAudioEncoder encoder(16000);
+  const std::string pcm(250 * sizeof(int16_t), '\0');
+  std::string stream;
+  EXPECT_TRUE(encoder.encode(pcm, &stream));
+  EXPECT_TRUE(stream.empty());
+  EXPECT_TRUE(encoder.encode(pcm, &stream));
+  EXPECT_EQ(countOpusPackets(stream), 1);
+  EXPECT_TRUE(encoder.finish(&stream));
+  EXPECT_EQ(countOpusPackets(stream), 2);
+}
+
+// @test The first output starts with the stream's header, and a new stream starts after finish()
+TEST(AudioCodecTest, FlacHeader) {
+  mik::FlacAudioEncoder encoder(16000);
+  const std::string pcm(1600 * sizeof(int16_t), '\0');
+  std::string stream;
+  EXPECT_TRUE(encoder.encode(pcm, &stream));
+  EXPECT_EQ(stream.substr(0, 4), "fLaC");
+  EXPECT_TRUE(encoder.finish(&stream));
+
+  std::string nextStream;
+  EXPECT_TRUE(encoder.encode(pcm, &nextStream));
+  EXPECT_EQ(nextStream.substr(0, 4), "fLaC");
+}
+
+// @test The names taken on the command line
+TEST(AudioCodecTest, ParseEncoding) {
+  EXPECT_EQ(mik::parseAudioEncoding("pcm"), mik::AudioEncoding::Linear16);
+  EXPECT_EQ(mik::parseAudioEncoding("flac"), mik::AudioEncoding::Flac);
+  EXPECT_EQ(mik::parseAudioEncoding("opus"), mik::AudioEncoding::Opus);
+  EXPECT_EQ(mik::parseAudioEncoding("mp3"), std::nullopt);
+}
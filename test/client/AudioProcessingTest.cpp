@@ -0,0 +1,107 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "AudioProcessing.hpp"
+
+namespace {
+
+std::vector<int16_t> sine(double frequency, unsigned int sampleRate, size_t count) {
+  std::vector<int16_t> samples(count);
+  for (size_t i = 0; i < count; ++i) {
+    samples[i] = static_cast<int16_t>(
+        10000 * std::sin(2 * 3.14159265358979 * frequency * static_cast<double>(i) / sampleRate));
+  }
+  return samples;
+}
+
+/// @brief Root mean square of the samples after the filter's start-up
+double rms(const std::vector<int16_t>& samples, size_t skip) {
+  double sum = 0;
+  for (size_t i = skip; i < samples.size(); ++i) {
+    sum += static_cast<double>(samples[i]) * samples[i];
+  }
+  return std::sqrt(sum / static_cast<double>(samples.size() - skip));
+}
+
+std::vector<int16_t> resample(unsigned int inputRate, unsigned int outputRate,
+                              const std::vector<int16_t>& input, size_t pieceSize) {
+  mik::Resampler resampler(inputRate, outputRate);
+  std::vector<int16_t> output;
+  for (size_t i = 0; i < input.size(); i += pieceSize) {
+    resampler.process(input.data() + i, std::min(pieceSize, input.size() - i), &output);
+  }
+  return output;
+}
+
+} // namespace
+
+// @test Left and right are averaged, including frames past the vectorized part
+TEST(AudioProcessingTest, DownmixStereo) {
+  std::vector<int16_t> stereo;
+  std::vector<int16_t> expected;
+  for (int i = 0; i < 21; ++i) {
+    const auto left = static_cast<int16_t>(i * 1000 - 10000);
+    const auto right = static_cast<int16_t>(i % 2 == 0 ? 32767 : -32768);
+    stereo.insert(stereo.end(), {left, right});
+    expected.push_back(static_cast<int16_t>((left + right) >> 1));
+  }
+
+  std::vector<int16_t> mono(expected.size());
+  mik::downmixToMono(stereo.data(), mono.size(), 2, mono.data());
+  EXPECT_EQ(expected, mono);
+}
+
+// @test Equal rates don't change the audio at all
+TEST(AudioProcessingTest, ResamplerPassthrough) {
+  const auto input = sine(440, 16000, 1000);
+  EXPECT_EQ(input, resample(16000, 16000, input, 100));
+}
+
+// @test The output has as many samples as the rates say and a tone below both Nyquist
+// frequencies keeps its level
+TEST(AudioProcessingTest, ResamplerKeepsPassband) {
+  const auto rates = {std::pair{8000u, 16000u}, std::pair{44100u, 16000u},
+                      std::pair{48000u, 16000u}};
+  for (const auto& [inputRate, outputRate] : rates) {
+    const auto input = sine(1000, inputRate, inputRate);
+    const auto output = resample(inputRate, outputRate, input, 555);
+    EXPECT_NEAR(static_cast<double>(output.size()), outputRate, 1.0) << inputRate;
+    EXPECT_NEAR(rms(output, output.size() / 10), rms(input, 0), rms(input, 0) * 0.02) << inputRate;
+  }
+}
+
+// @test A tone above the output's Nyquist frequency is filtered out instead of aliasing
+TEST(AudioProcessingTest, ResamplerRemovesAliases) {
+  const auto input = sine(12000, 44100, 44100);
+  const auto output = resample(44100, 16000, input, 1024);
+  EXPECT_LT(rms(output, output.size() / 10), rms(input, 0) * 0.01);
+}
+
+// @test Feeding audio in pieces gives the same output as all at once
+TEST(AudioProcessingTest, ResamplerPiecesMatchWhole) {
+  const auto input = sine(300, 44100, 10000);
+  EXPECT_EQ(resample(44100, 16000, input, input.size()), resample(44100, 16000, input, 37));
+}
+
+// @test Stereo bytes come out as mono at the new rate, a split frame is completed by the next call
+TEST(AudioProcessingTest, PreprocessorSplitFrames) {
+  const std::vector<int16_t> stereo(400, 1000);
+  std::string bytes(stereo.size() * sizeof(int16_t), '\0');
+  std::memcpy(bytes.data(), stereo.data(), bytes.size());
+
+  mik::AudioPreprocessor preprocessor(16000, 2, 16000);
+  std::string output;
+  preprocessor.process(std::string_view(bytes).substr(0, 7), &output);
+  preprocessor.process(std::string_view(bytes).substr(7), &output);
+
+  ASSERT_EQ(200 * sizeof(int16_t), output.size());
+  std::vector<int16_t> mono(200);
+  std::memcpy(mono.data(), output.data(), output.size());
+  EXPECT_THAT(mono, ::testing::Each(1000));
+}
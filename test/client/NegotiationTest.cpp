@@ -0,0 +1,115 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+
+#include <grpc++/grpc++.h>
+
+#include "RistrettoClient.hpp"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+/// @brief Answers GetServerInfo with whatever the test sets, or with an error if it's not ok
+class FakeDecoderService : public RistrettoProto::Decoder::Service {
+public:
+  grpc::Status GetServerInfo(grpc::ServerContext* /*context*/,
+                             const RistrettoProto::ServerInfoRequest* /*request*/,
+                             RistrettoProto::ServerInfo* response) override {
+    if (!status.ok()) {
+      return status;
+    }
+    *response = info;
+    return grpc::Status::OK;
+  }
+
+  RistrettoProto::ServerInfo info;
+  grpc::Status status;
+};
+
+/// @brief In-process server with just the fake service, the client talks to it over a channel
+class NegotiationTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    grpc::ServerBuilder builder;
+    builder.RegisterService(&service_);
+    server_ = builder.BuildAndStart();
+    ASSERT_NE(server_, nullptr);
+    channel_ = server_->InProcessChannel(grpc::ChannelArguments());
+  }
+  void TearDown() override {
+    if (server_) {
+      server_->Shutdown();
+    }
+  }
+
+  /// @brief Model that takes 16 kHz audio in 180 ms chunks
+  void setServerInfo(unsigned int sampleRate = 16000, uint32_t chunkSamples = 2880) {
+    service_.info.set_samplerate(sampleRate);
+    service_.info.set_chunksamples(chunkSamples);
+    service_.info.add_encodings(RistrettoProto::LINEAR16);
+  }
+
+  FakeDecoderService service_;
+  std::unique_ptr<grpc::Server> server_;
+  std::shared_ptr<grpc::Channel> channel_;
+};
+
+} // namespace
+
+// @test Chunks are rounded to the nearest whole number of decoder chunks, never to none
+TEST(ChunkRoundingTest, RoundsToNearestServerChunk) {
+  // 2880 samples at 16 kHz are 180 ms
+  EXPECT_EQ(mik::roundToServerChunks(200ms, 2880, 16000), 180ms);
+  EXPECT_EQ(mik::roundToServerChunks(300ms, 2880, 16000), 360ms);
+  EXPECT_EQ(mik::roundToServerChunks(1000ms, 2880, 16000), 1080ms);
+  EXPECT_EQ(mik::roundToServerChunks(10ms, 2880, 16000), 180ms);
+  // 0.18 s at 8 kHz, 1441 samples don't make whole milliseconds so they're rounded up
+  EXPECT_EQ(mik::roundToServerChunks(200ms, 1440, 8000), 180ms);
+  EXPECT_EQ(mik::roundToServerChunks(200ms, 1441, 8000), 181ms);
+}
+
+// @test The client takes on the server's rate and chunks, and sends PCM if its codec isn't taken
+TEST_F(NegotiationTest, AdoptsServerSettings) {
+  setServerInfo();
+  mik::RistrettoClient client(channel_);
+  client.setChunkDuration(200ms);
+  client.setAudioEncoding(mik::AudioEncoding::Opus);
+
+  ASSERT_TRUE(client.negotiateWithServer(1s));
+  EXPECT_EQ(client.serverSampleRate(), 16000U);
+  EXPECT_EQ(client.chunkDuration(), 180ms);
+  EXPECT_EQ(client.audioEncoding(), mik::AudioEncoding::Linear16);
+}
+
+// @test The microphone switches to the server's rate, or keeps its own if it can't capture at it
+TEST_F(NegotiationTest, SwitchesCaptureRate) {
+  setServerInfo(16000);
+  mik::AlsaConfig captureConfig;
+  captureConfig.samplingFreq_Hz = 8000;
+  mik::RistrettoClient client(channel_, captureConfig);
+  const auto before = client.captureConfiguration();
+
+  ASSERT_TRUE(client.negotiateWithServer(1s));
+  // Without a sound card the configuration can't change, and nothing else may change with it
+  const auto& after = client.captureConfiguration();
+  if (after.samplingFreq_Hz != 16000) {
+    EXPECT_EQ(after, before);
+  }
+  EXPECT_EQ(client.serverSampleRate(), 16000U);
+}
+
+// @test A server that doesn't answer leaves the client's own settings
+TEST_F(NegotiationTest, KeepsSettingsWhenServerFails) {
+  service_.status = grpc::Status(grpc::StatusCode::UNAVAILABLE, "Not yet");
+  mik::RistrettoClient client(channel_);
+  client.setChunkDuration(200ms);
+  client.setAudioEncoding(mik::AudioEncoding::Flac);
+
+  EXPECT_FALSE(client.negotiateWithServer(1s));
+  EXPECT_EQ(client.serverSampleRate(), mik::RistrettoClient::DefaultServerSampleRate);
+  EXPECT_EQ(client.chunkDuration(), 200ms);
+  EXPECT_EQ(client.audioEncoding(), mik::AudioEncoding::Flac);
+}
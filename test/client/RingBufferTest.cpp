@@ -0,0 +1,90 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+
+#include "RingBuffer.hpp"
+
+TEST(RingBufferTest, WriteAndRead) {
+  mik::RingBuffer buffer(16);
+  ASSERT_TRUE(buffer.write("hello"));
+  ASSERT_TRUE(buffer.write(" world"));
+  EXPECT_EQ(11, buffer.size());
+
+  std::string output;
+  EXPECT_EQ(5, buffer.read(5, &output));
+  EXPECT_EQ("hello", output);
+  EXPECT_EQ(6, buffer.read(100, &output));
+  EXPECT_EQ("hello world", output);
+  EXPECT_EQ(0, buffer.size());
+}
+
+TEST(RingBufferTest, WrapsAround) {
+  mik::RingBuffer buffer(8);
+  ASSERT_TRUE(buffer.write("abcdef"));
+  buffer.consume(4);
+  ASSERT_TRUE(buffer.write("ghijkl"));
+
+  // The readable bytes go past the end of the buffer, so they come in two pieces
+  const auto pieces = buffer.peek(100);
+  EXPECT_EQ("efgh", pieces[0]);
+  EXPECT_EQ("ijkl", pieces[1]);
+
+  std::string output;
+  buffer.read(100, &output);
+  EXPECT_EQ("efghijkl", output);
+}
+
+TEST(RingBufferTest, OverrunDropsWholeWrites) {
+  mik::RingBuffer buffer(8);
+  ASSERT_TRUE(buffer.write("abcdef"));
+  EXPECT_FALSE(buffer.write("ghi"));
+  EXPECT_EQ(3, buffer.overrunBytes());
+  EXPECT_EQ(6, buffer.size());
+
+  // Once there's room again writes go through, the count of dropped bytes is kept
+  buffer.consume(3);
+  EXPECT_TRUE(buffer.write("ghi"));
+  EXPECT_EQ(3, buffer.overrunBytes());
+
+  std::string output;
+  buffer.read(100, &output);
+  EXPECT_EQ("defghi", output);
+}
+
+TEST(RingBufferTest, ConsumeIsClampedToSize) {
+  mik::RingBuffer buffer(8);
+  ASSERT_TRUE(buffer.write("abc"));
+  buffer.consume(100);
+  EXPECT_EQ(0, buffer.size());
+  EXPECT_TRUE(buffer.write("abcdefgh"));
+}
+
+TEST(RingBufferTest, ProducerAndConsumerThreads) {
+  constexpr int WriteCount = 100000;
+  mik::RingBuffer buffer(64);
+
+  std::thread producer([&buffer] {
+    for (int i = 0; i < WriteCount; ++i) {
+      // The capture thread drops what doesn't fit, this retries instead so every byte can be checked
+      const char byte = static_cast<char>(i % 128);
+      while (!buffer.write(std::string_view(&byte, 1))) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  std::string output;
+  while (output.size() < WriteCount) {
+    if (buffer.read(WriteCount, &output) == 0) {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+
+  ASSERT_EQ(WriteCount, output.size());
+  for (int i = 0; i < WriteCount; ++i) {
+    ASSERT_EQ(static_cast<char>(i % 128), output[static_cast<size_t>(i)]) << "at byte " << i;
+  }
+}
@@ -0,0 +1,31 @@
+#include <algorithm>
+
+#include "ClientEncoder.hpp"
+#include "client/AudioCodec.hpp"
+
+namespace TestUtils {
+
+std::vector<std::string> encodeLikeClient(Codec codec, unsigned int sampleRate,
+                                          std::string_view pcm, size_t chunkBytes) {
+  const auto encoder = mik::makeAudioEncoder(
+      codec == Codec::Flac ? mik::AudioEncoding::Flac : mik::AudioEncoding::Opus, sampleRate);
+  std::vector<std::string> pieces;
+  if (!encoder) {
+    return pieces;
+  }
+  for (size_t start = 0; start < pcm.size(); start += chunkBytes) {
+    auto& piece = pieces.emplace_back();
+    if (!encoder->encode(pcm.substr(start, chunkBytes), &piece)) {
+      return {};
+    }
+  }
+  if (pieces.empty()) {
+    pieces.emplace_back();
+  }
+  if (!encoder->finish(&pieces.back())) {
+    return {};
+  }
+  return pieces;
+}
+
+} // namespace TestUtils
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace TestUtils {
+
+/// @brief One of the client's encoders. The client and the server both declare mik::AudioEncoding,
+/// so it can't be used in a file that sees the server's codecs
+enum class Codec { Flac, Opus };
+
+/// @brief Encodes the PCM with the client's encoder a chunk at a time, the way the recording thread
+/// does. The last piece also has what finishing the stream handed out
+/// @return One piece per chunk, what each request would carry
+std::vector<std::string> encodeLikeClient(Codec codec, unsigned int sampleRate,
+                                          std::string_view pcm, size_t chunkBytes);
+
+} // namespace TestUtils
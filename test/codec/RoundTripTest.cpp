@@ -0,0 +1,95 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "ClientEncoder.hpp"
+#include "server/AudioCodec.hpp"
+
+namespace {
+
+constexpr unsigned int SampleRate = 16000;
+/// @brief 200 ms, the client's default chunk
+constexpr size_t ChunkBytes = SampleRate / 5 * sizeof(int16_t);
+constexpr double Pi = 3.14159265358979323846;
+
+/// @brief A second of a tone with a slow rise, so the samples aren't all alike
+std::string makeTone() {
+  std::vector<int16_t> samples(SampleRate);
+  for (size_t i = 0; i < samples.size(); ++i) {
+    const auto t = static_cast<double>(i) / SampleRate;
+    samples[i] = static_cast<int16_t>(8000 * t * std::sin(2 * Pi * 440 * t));
+  }
+  std::string pcm(samples.size() * sizeof(int16_t), '\0');
+  std::memcpy(pcm.data(), samples.data(), pcm.size());
+  return pcm;
+}
+
+double rms(const std::string& pcm) {
+  std::vector<int16_t> samples(pcm.size() / sizeof(int16_t));
+  std::memcpy(samples.data(), pcm.data(), samples.size() * sizeof(int16_t));
+  double sum = 0;
+  for (const auto sample : samples) {
+    sum += static_cast<double>(sample) * sample;
+  }
+  return samples.empty() ? 0 : std::sqrt(sum / static_cast<double>(samples.size()));
+}
+
+/// @brief Decodes the pieces one after the other, the way a session gets one per request
+std::string decodePieces(mik::AudioEncoding encoding, const std::vector<std::string>& pieces) {
+  const auto decoder = mik::makeAudioDecoder(encoding, SampleRate);
+  std::string pcm;
+  if (!decoder) {
+    ADD_FAILURE() << "No decoder";
+    return pcm;
+  }
+  for (size_t i = 0; i < pieces.size(); ++i) {
+    EXPECT_TRUE(decoder->decode(pieces[i], &pcm)) << "piece " << i;
+  }
+  return pcm;
+}
+
+} // namespace
+
+// @test What the client's FLAC encoder sends, chunk by chunk, the server decodes bit for bit
+TEST(CodecRoundTripTest, Flac) {
+  const auto pcm = makeTone();
+  const auto pieces =
+      TestUtils::encodeLikeClient(TestUtils::Codec::Flac, SampleRate, pcm, ChunkBytes);
+  ASSERT_EQ(pieces.size(), 5U);
+
+  EXPECT_EQ(decodePieces(mik::AudioEncoding::Flac, pieces), pcm);
+}
+
+// @test The client's Opus packets decode to the same length of audio, padded to whole packets, at
+// about the same level
+TEST(CodecRoundTripTest, Opus) {
+  const auto pcm = makeTone();
+  const auto pieces =
+      TestUtils::encodeLikeClient(TestUtils::Codec::Opus, SampleRate, pcm, ChunkBytes);
+  ASSERT_EQ(pieces.size(), 5U);
+
+  const auto decoded = decodePieces(mik::AudioEncoding::Opus, pieces);
+  // 20 ms packets
+  constexpr size_t PacketBytes = SampleRate / 50 * sizeof(int16_t);
+  EXPECT_GE(decoded.size(), pcm.size());
+  EXPECT_LT(decoded.size(), pcm.size() + PacketBytes);
+  EXPECT_NEAR(rms(decoded) / rms(pcm), 1.0, 0.3);
+}
+
+// @test A piece whose bytes got mangled on the way is reported, not decoded into noise
+TEST(CodecRoundTripTest, CorruptFlacIsRejected) {
+  auto pieces =
+      TestUtils::encodeLikeClient(TestUtils::Codec::Flac, SampleRate, makeTone(), ChunkBytes);
+  ASSERT_FALSE(pieces.empty());
+  pieces[0].replace(0, 4, "XXXX");
+
+  const auto decoder = mik::makeAudioDecoder(mik::AudioEncoding::Flac, SampleRate);
+  ASSERT_NE(decoder, nullptr);
+  std::string pcm;
+  EXPECT_FALSE(decoder->decode(pieces[0], &pcm));
+}
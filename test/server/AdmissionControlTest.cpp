@@ -0,0 +1,103 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+
+#include "AdmissionControl.hpp"
+#include "Metrics.hpp"
+
+using namespace std::chrono_literals;
+using Clock = mik::AdmissionController::Clock;
+
+// @test Nothing is refused before anything was measured
+TEST(AdmissionControlTest, AdmitsWhenIdle) {
+  mik::Counter audioSeconds;
+  mik::Counter decodeSeconds;
+  mik::AdmissionController admission({}, 4, audioSeconds, decodeSeconds);
+  EXPECT_TRUE(admission.admit(true, 0).admitted);
+  EXPECT_TRUE(admission.admit(true, 100).admitted);
+}
+
+// @test New streams are refused when the queue is long, the hint is how long it takes to drain
+TEST(AdmissionControlTest, RefusesLongQueue) {
+  mik::Counter audioSeconds;
+  mik::Counter decodeSeconds;
+  mik::AdmissionOptions options;
+  options.maxQueueWaitMs = 1000;
+  options.minRetryAfterMs = 500;
+  mik::AdmissionController admission(options, 2, audioSeconds, decodeSeconds);
+  admission.recordJob(0.25);
+
+  // 8 jobs of 0.25 s on 2 threads wait for a second
+  EXPECT_DOUBLE_EQ(admission.estimatedWaitSeconds(8), 1.0);
+  EXPECT_TRUE(admission.admit(true, 8).admitted);
+
+  const auto refused = admission.admit(true, 16);
+  EXPECT_FALSE(refused.admitted);
+  EXPECT_EQ(refused.retryAfter, 1000ms);
+  EXPECT_FALSE(refused.reason.empty());
+
+  // Just over the limit is still told to wait the minimum
+  EXPECT_EQ(admission.admit(true, 9).retryAfter, 500ms);
+}
+
+// @test A chunk in the middle of an admitted session is never refused, however long the queue is
+// or however busy the threads are, so its transcript doesn't get a gap
+TEST(AdmissionControlTest, NeverRefusesAdmittedStreams) {
+  mik::Counter audioSeconds;
+  mik::Counter decodeSeconds;
+  mik::AdmissionOptions options;
+  options.maxQueueWaitMs = 1000;
+  options.maxLoad = 0.5;
+  const auto start = Clock::now();
+  mik::AdmissionController admission(options, 1, audioSeconds, decodeSeconds);
+  admission.recordJob(1);
+  audioSeconds.add(2);
+  decodeSeconds.add(2);
+
+  EXPECT_FALSE(admission.admit(true, 100, start + 2s).admitted);
+  EXPECT_FALSE(admission.admit(true, 0, start + 2s).admitted);
+  EXPECT_TRUE(admission.admit(false, 100, start + 2s).admitted);
+}
+
+// @test New streams are refused once they'd push the measured load over the limit, streams that
+// were already admitted keep going
+TEST(AdmissionControlTest, RefusesNewStreamsWhenBusy) {
+  mik::Counter audioSeconds;
+  mik::Counter decodeSeconds;
+  mik::AdmissionOptions options;
+  options.maxLoad = 0.8;
+  const auto start = Clock::now();
+  mik::AdmissionController admission(options, 2, audioSeconds, decodeSeconds);
+
+  // 2 threads decoding for 1.6 s over 2 s is a load of 0.4, at a real-time factor of 0.5
+  audioSeconds.add(3.2);
+  decodeSeconds.add(1.6);
+  EXPECT_TRUE(admission.admit(true, 0, start + 2s).admitted);
+  EXPECT_NEAR(admission.load(), 0.2, 1e-3);
+  EXPECT_NEAR(admission.realTimeFactor(), 0.5, 1e-3);
+
+  // Fully busy from then on
+  audioSeconds.add(8);
+  decodeSeconds.add(4);
+  const auto refused = admission.admit(true, 0, start + 4s);
+  EXPECT_NEAR(admission.load(), 0.6, 1e-3);
+  EXPECT_FALSE(refused.admitted);
+  EXPECT_GE(refused.retryAfter, 1s);
+  EXPECT_TRUE(admission.admit(false, 0, start + 4s).admitted);
+}
+
+// @test 0 turns the limits off
+TEST(AdmissionControlTest, Disabled) {
+  mik::Counter audioSeconds;
+  mik::Counter decodeSeconds;
+  mik::AdmissionOptions options;
+  options.maxQueueWaitMs = 0;
+  options.maxLoad = 0;
+  const auto start = Clock::now();
+  mik::AdmissionController admission(options, 1, audioSeconds, decodeSeconds);
+  admission.recordJob(10);
+  audioSeconds.add(1);
+  decodeSeconds.add(10);
+  EXPECT_TRUE(admission.admit(true, 1000, start + 1s).admitted);
+}
@@ -0,0 +1,80 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <new>
+#include <string>
+
+#include "KaldiInterface.hpp"
+
+// This replaces the global operator new, so it's built into its own test binary where it can't
+// affect any other test
+
+namespace {
+
+/// @brief Allocations made by this thread while counting is turned on
+thread_local size_t allocationCount = 0;
+thread_local bool isCountingAllocations = false;
+
+/**
+ * AllocationCounter
+ * @brief Counts the calling thread's heap allocations while it's alive
+ */
+class AllocationCounter {
+public:
+  AllocationCounter() {
+    allocationCount = 0;
+    isCountingAllocations = true;
+  }
+  ~AllocationCounter() { isCountingAllocations = false; }
+
+  [[nodiscard]] size_t count() const noexcept { return allocationCount; }
+};
+
+/// @brief Feeds the audio through the same conversion and chunking that Nnet3Data::decodeAudio uses
+kaldi::BaseFloat feedChunks(const std::string& audioData, kaldi::Vector<kaldi::BaseFloat>* buffer,
+                            kaldi::int32 chunkLength) {
+  const auto audio = mik::stringToKaldiVector(audioData, buffer);
+  kaldi::BaseFloat total = 0;
+  mik::AudioChunker chunks(audio, chunkLength);
+  while (!chunks.done()) {
+    total += chunks.next().Sum();
+  }
+  return total;
+}
+
+} // namespace
+
+// Every allocation in this test binary goes through here so that it can be counted
+void* operator new(size_t size) {
+  if (isCountingAllocations) {
+    ++allocationCount;
+  }
+  if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t /*size*/) noexcept { std::free(ptr); }
+
+// @test Once the session's buffer is big enough, converting and chunking audio never allocates
+TEST(AllocationTest, SteadyStateDoesNotAllocate) {
+  // About one second of 16KHz audio per request, split into 180ms chunks
+  const std::string audioData(2 * 16000, '\x01');
+  const kaldi::int32 chunkLength = 2880;
+  kaldi::Vector<kaldi::BaseFloat> buffer;
+  // The first request grows the buffer
+  feedChunks(audioData, &buffer, chunkLength);
+  // Kaldi's vectors don't allocate with operator new, a new buffer would have moved
+  const auto* const bufferData = buffer.Data();
+
+  AllocationCounter allocations;
+  kaldi::BaseFloat total = 0;
+  for (int request = 0; request < 10; ++request) {
+    total += feedChunks(audioData, &buffer, chunkLength);
+  }
+  EXPECT_EQ(allocations.count(), 0);
+  EXPECT_EQ(buffer.Data(), bufferData);
+  EXPECT_GT(total, 0);
+}
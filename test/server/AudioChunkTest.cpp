@@ -0,0 +1,36 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "KaldiInterface.hpp"
+
+// @test Chunks cover the audio exactly once and the last one is the leftover
+TEST(AudioChunkTest, ChunksCoverAudio) {
+  const std::string audioData(2 * 1000, '\x01');
+  kaldi::Vector<kaldi::BaseFloat> buffer;
+  const auto audio = mik::stringToKaldiVector(audioData, &buffer);
+  ASSERT_EQ(audio.Dim(), 1000);
+
+  mik::AudioChunker chunks(audio, 300);
+  std::vector<kaldi::MatrixIndexT> chunkLengths;
+  while (!chunks.done()) {
+    chunkLengths.push_back(chunks.next().Dim());
+  }
+  EXPECT_THAT(chunkLengths, ::testing::ElementsAre(300, 300, 300, 100));
+}
+
+// @test The buffer only grows, shorter audio reuses it
+TEST(AudioChunkTest, BufferIsReused) {
+  kaldi::Vector<kaldi::BaseFloat> buffer;
+  [[maybe_unused]] const auto longAudio = mik::stringToKaldiVector(std::string(200, '\0'), &buffer);
+  const auto* const bufferData = buffer.Data();
+
+  const auto shortAudio = mik::stringToKaldiVector(std::string{0x02, 0x00, 0x03}, &buffer);
+  EXPECT_EQ(buffer.Data(), bufferData);
+  EXPECT_EQ(buffer.Dim(), 100);
+  ASSERT_EQ(shortAudio.Dim(), 2);
+  EXPECT_EQ(shortAudio(0), 2.0f);
+  EXPECT_EQ(shortAudio(1), 3.0f);
+}
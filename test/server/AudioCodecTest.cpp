@@ -0,0 +1,142 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <FLAC/stream_encoder.h>
+#include <opus/opus.h>
+
+#include "AudioCodec.hpp"
+
+namespace {
+
+constexpr unsigned int SampleRate = 16000;
+
+std::string sine(double frequency, size_t count) {
+  std::string pcm(count * sizeof(int16_t), '\0');
+  for (size_t i = 0; i < count; ++i) {
+    const auto sample = static_cast<int16_t>(
+        8000 * std::sin(2 * 3.14159265358979 * frequency * static_cast<double>(i) / SampleRate));
+    std::memcpy(pcm.data() + i * sizeof(int16_t), &sample, sizeof(int16_t));
+  }
+  return pcm;
+}
+
+double rms(const std::string& pcm) {
+  double sum = 0;
+  const auto count = pcm.size() / sizeof(int16_t);
+  for (size_t i = 0; i < count; ++i) {
+    int16_t sample = 0;
+    std::memcpy(&sample, pcm.data() + i * sizeof(int16_t), sizeof(int16_t));
+    sum += static_cast<double>(sample) * sample;
+  }
+  return std::sqrt(sum / static_cast<double>(count));
+}
+
+/// @brief The FLAC stream split where the encoder handed out each write, which is on a frame
+/// boundary after the header
+std::vector<std::string> encodeFlac(const std::string& pcm) {
+  std::vector<std::string> pieces;
+  auto* encoder = FLAC__stream_encoder_new();
+  FLAC__stream_encoder_set_channels(encoder, 1);
+  FLAC__stream_encoder_set_bits_per_sample(encoder, 16);
+  FLAC__stream_encoder_set_sample_rate(encoder, SampleRate);
+  FLAC__stream_encoder_set_blocksize(encoder, 640);
+  const auto write = [](const FLAC__StreamEncoder*, const FLAC__byte buffer[], size_t bytes,
+                        uint32_t, uint32_t, void* clientData) {
+    static_cast<std::vector<std::string>*>(clientData)
+        ->emplace_back(reinterpret_cast<const char*>(buffer), bytes);
+    return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+  };
+  FLAC__stream_encoder_init_stream(encoder, write, nullptr, nullptr, nullptr, &pieces);
+
+  std::vector<FLAC__int32> samples(pcm.size() / sizeof(int16_t));
+  for (size_t i = 0; i < samples.size(); ++i) {
+    int16_t sample = 0;
+    std::memcpy(&sample, pcm.data() + i * sizeof(int16_t), sizeof(int16_t));
+    samples[i] = sample;
+  }
+  FLAC__stream_encoder_process_interleaved(encoder, samples.data(),
+                                           static_cast<uint32_t>(samples.size()));
+  FLAC__stream_encoder_finish(encoder);
+  FLAC__stream_encoder_delete(encoder);
+  return pieces;
+}
+
+/// @brief 20 ms packets, each preceded by its length
+std::string encodeOpus(const std::string& pcm) {
+  int error = OPUS_OK;
+  auto* encoder = opus_encoder_create(SampleRate, 1, OPUS_APPLICATION_VOIP, &error);
+  const size_t frameSamples = SampleRate / 50;
+  std::string stream;
+  unsigned char packet[1275];
+  const auto* samples = reinterpret_cast<const int16_t*>(pcm.data());
+  for (size_t i = 0; i + frameSamples <= pcm.size() / sizeof(int16_t); i += frameSamples) {
+    const auto length = opus_encode(encoder, samples + i, static_cast<int>(frameSamples), packet,
+                                    static_cast<opus_int32>(sizeof(packet)));
+    stream.push_back(static_cast<char>(length & 0xff));
+    stream.push_back(static_cast<char>(length >> 8));
+    stream.append(reinterpret_cast<const char*>(packet), static_cast<size_t>(length));
+  }
+  opus_encoder_destroy(encoder);
+  return stream;
+}
+
+} // namespace
+
+// @test FLAC is lossless, decoding it one write at a time gives back exactly the same samples
+TEST(AudioCodecTest, FlacRoundTrip) {
+  const auto pcm = sine(440, SampleRate);
+  const auto pieces = encodeFlac(pcm);
+  ASSERT_GT(pieces.size(), 2u);
+
+  auto decoder = mik::makeAudioDecoder(mik::AudioEncoding::Flac, SampleRate);
+  ASSERT_NE(decoder, nullptr);
+  std::string decoded;
+  for (const auto& piece : pieces) {
+    EXPECT_TRUE(decoder->decode(piece, &decoded));
+  }
+  EXPECT_EQ(decoded, pcm);
+}
+
+// @test A message that ends in the middle of a frame is reported and the decoder starts over
+TEST(AudioCodecTest, FlacSplitFrame) {
+  const auto pieces = encodeFlac(sine(440, SampleRate / 10));
+  std::string stream;
+  for (const auto& piece : pieces) {
+    stream += piece;
+  }
+  mik::FlacAudioDecoder decoder(SampleRate);
+  std::string decoded;
+  EXPECT_FALSE(decoder.decode(stream.substr(0, stream.size() - 5), &decoded));
+}
+
+// @test Opus packets split at arbitrary bytes are put back together, the audio is lossy so only
+// its length and loudness are compared
+TEST(AudioCodecTest, OpusRoundTrip) {
+  const auto pcm = sine(440, SampleRate);
+  const auto stream = encodeOpus(pcm);
+  EXPECT_LT(stream.size(), pcm.size() / 4);
+
+  auto decoder = mik::makeAudioDecoder(mik::AudioEncoding::Opus, SampleRate);
+  ASSERT_NE(decoder, nullptr);
+  std::string decoded;
+  for (size_t i = 0; i < stream.size(); i += 37) {
+    EXPECT_TRUE(decoder->decode(std::string_view(stream).substr(i, 37), &decoded));
+  }
+  EXPECT_EQ(decoded.size(), pcm.size());
+  EXPECT_NEAR(rms(decoded), rms(pcm), rms(pcm) * 0.2);
+}
+
+// @test Opus can't be sent at rates that it doesn't run at, PCM and FLAC can
+TEST(AudioCodecTest, SupportedEncodings) {
+  EXPECT_TRUE(mik::isEncodingSupported(mik::AudioEncoding::Opus, 16000));
+  EXPECT_FALSE(mik::isEncodingSupported(mik::AudioEncoding::Opus, 44100));
+  EXPECT_TRUE(mik::isEncodingSupported(mik::AudioEncoding::Flac, 44100));
+  EXPECT_EQ(mik::makeAudioDecoder(mik::AudioEncoding::Opus, 44100), nullptr);
+  EXPECT_EQ(mik::makeAudioDecoder(mik::AudioEncoding::Linear16, 16000), nullptr);
+}
@@ -0,0 +1,78 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "AudioConversion.hpp"
+
+namespace {
+
+/// @brief Every instruction set that the machine running the tests supports
+std::vector<mik::SimdLevel> supportedSimdLevels() {
+  std::vector<mik::SimdLevel> simdLevels = {mik::SimdLevel::Scalar};
+  const auto best = mik::detectSimdLevel();
+  if (best == mik::SimdLevel::Sse2 || best == mik::SimdLevel::Avx2) {
+    simdLevels.push_back(mik::SimdLevel::Sse2);
+  }
+  if (best == mik::SimdLevel::Avx2) {
+    simdLevels.push_back(mik::SimdLevel::Avx2);
+  }
+  return simdLevels;
+}
+
+std::string randomBytes(size_t length) {
+  std::mt19937 generator(length);
+  std::uniform_int_distribution<int> distribution(std::numeric_limits<char>::min(),
+                                                  std::numeric_limits<char>::max());
+  std::string bytes(length, '\0');
+  for (auto& byte : bytes) {
+    byte = static_cast<char>(distribution(generator));
+  }
+  return bytes;
+}
+
+} // namespace
+
+// @test Extreme values keep their sign and magnitude
+TEST(AudioConversionTest, ConvertsExtremes) {
+  const std::string input = {0x00, int8_t(0x80), -1, 0x7F, -1, -1, 0x01, 0x00};
+  for (const auto simdLevel : supportedSimdLevels()) {
+    std::vector<float> output(4);
+    mik::int16ToFloat(input, output.data(), simdLevel);
+    EXPECT_THAT(output, ::testing::ElementsAre(-32768.0f, 32767.0f, -1.0f, 1.0f));
+  }
+}
+
+// @test A trailing odd byte becomes an unsigned low half
+TEST(AudioConversionTest, OddTrailingByte) {
+  const std::string input = {0x01, 0x00, int8_t(-54)};
+  for (const auto simdLevel : supportedSimdLevels()) {
+    std::vector<float> output(2);
+    mik::int16ToFloat(input, output.data(), simdLevel);
+    EXPECT_THAT(output, ::testing::ElementsAre(1.0f, 202.0f));
+  }
+}
+
+// @test Every instruction set matches the scalar conversion, including lengths that leave a tail
+//       after the vectorized loop and inputs that start at an unaligned address
+TEST(AudioConversionTest, MatchesScalar) {
+  for (size_t length = 0; length < 100; ++length) {
+    const auto bytes = randomBytes(length + 1);
+    for (size_t offset = 0; offset < 2; ++offset) {
+      const std::string_view input(bytes.data() + offset, length);
+      std::vector<float> expected((length + 1) / 2);
+      mik::int16ToFloat(input, expected.data(), mik::SimdLevel::Scalar);
+
+      for (const auto simdLevel : supportedSimdLevels()) {
+        std::vector<float> output(expected.size());
+        mik::int16ToFloat(input, output.data(), simdLevel);
+        EXPECT_EQ(expected, output) << "length:" << length << " offset:" << offset
+                                    << " simdLevel:" << static_cast<int>(simdLevel);
+      }
+    }
+  }
+}
@@ -0,0 +1,147 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "AudioReorder.hpp"
+
+using namespace std::chrono_literals;
+using ::testing::ElementsAre;
+using Clock = mik::AudioReorderBuffer::Clock;
+
+namespace {
+
+mik::PendingAudio makeAudio(const std::string& audio, Clock::time_point received = Clock::now()) {
+  return {std::make_unique<std::string>(audio), false, mik::AudioEncoding::Linear16, received};
+}
+
+/// @brief The audio of everything that's ready, in the order it comes out
+std::vector<std::string> popAll(mik::AudioReorderBuffer& buffer) {
+  std::vector<std::string> audio;
+  while (auto next = buffer.pop()) {
+    audio.push_back(next->second.audio ? *next->second.audio : "<skipped>");
+  }
+  return audio;
+}
+
+} // namespace
+
+// @test Audio that arrives in order comes straight out
+TEST(AudioReorderTest, PassesAudioInOrder) {
+  mik::AudioReorderBuffer buffer(3);
+  for (uint32_t audioId = 0; audioId < 3; ++audioId) {
+    ASSERT_TRUE(buffer.push(audioId, makeAudio(std::to_string(audioId))));
+    EXPECT_THAT(popAll(buffer), ElementsAre(std::to_string(audioId)));
+  }
+  EXPECT_EQ(buffer.nextAudioId(), 3U);
+  EXPECT_EQ(buffer.heldCount(), 0U);
+}
+
+// @test Early audio is held until the audio before it arrives
+TEST(AudioReorderTest, HoldsEarlyAudio) {
+  mik::AudioReorderBuffer buffer(3);
+  ASSERT_TRUE(buffer.push(0, makeAudio("0")));
+  EXPECT_THAT(popAll(buffer), ElementsAre("0"));
+
+  ASSERT_TRUE(buffer.push(2, makeAudio("2")));
+  ASSERT_TRUE(buffer.push(3, makeAudio("3")));
+  EXPECT_TRUE(popAll(buffer).empty());
+  EXPECT_EQ(buffer.heldCount(), 2U);
+
+  ASSERT_TRUE(buffer.push(1, makeAudio("1")));
+  EXPECT_THAT(popAll(buffer), ElementsAre("1", "2", "3"));
+  EXPECT_EQ(buffer.nextAudioId(), 4U);
+}
+
+// @test Audio that was already passed and audio that's already held are dropped
+TEST(AudioReorderTest, DropsDuplicates) {
+  mik::AudioReorderBuffer buffer(3);
+  ASSERT_TRUE(buffer.push(0, makeAudio("0")));
+  EXPECT_THAT(popAll(buffer), ElementsAre("0"));
+  ASSERT_TRUE(buffer.push(2, makeAudio("2")));
+
+  EXPECT_FALSE(buffer.push(2, makeAudio("again")));
+  ASSERT_TRUE(buffer.push(1, makeAudio("1")));
+  EXPECT_THAT(popAll(buffer), ElementsAre("1", "2"));
+  EXPECT_FALSE(buffer.push(1, makeAudio("late")));
+}
+
+// @test audioId 0 drops what's held of the previous stream, but not audio of its own stream that
+// arrived before it
+TEST(AudioReorderTest, AudioIdZeroStartsNewStream) {
+  mik::AudioReorderBuffer buffer(3);
+  ASSERT_TRUE(buffer.push(1, makeAudio("1")));
+  ASSERT_TRUE(buffer.push(0, makeAudio("0")));
+  EXPECT_THAT(popAll(buffer), ElementsAre("0", "1"));
+
+  ASSERT_TRUE(buffer.push(3, makeAudio("old")));
+  ASSERT_TRUE(buffer.push(0, makeAudio("new")));
+  EXPECT_THAT(popAll(buffer), ElementsAre("new"));
+  EXPECT_EQ(buffer.heldCount(), 0U);
+}
+
+// @test The missing audio is given up on once the oldest held audio waited for the read timeout
+TEST(AudioReorderTest, GivesUpAfterReadTimeout) {
+  mik::AudioReorderBuffer buffer(3);
+  const auto start = Clock::now();
+  ASSERT_TRUE(buffer.push(0, makeAudio("0", start), start));
+  EXPECT_THAT(popAll(buffer), ElementsAre("0"));
+
+  ASSERT_TRUE(buffer.push(2, makeAudio("2", start), start));
+  ASSERT_TRUE(buffer.push(3, makeAudio("3", start + 2s), start + 2s));
+  EXPECT_TRUE(popAll(buffer).empty());
+
+  ASSERT_TRUE(buffer.push(4, makeAudio("4", start + 4s), start + 4s));
+  EXPECT_THAT(popAll(buffer), ElementsAre("2", "3", "4"));
+  EXPECT_FALSE(buffer.push(1, makeAudio("1")));
+}
+
+// @test Without a read timeout the missing audio is only given up on once too much is held
+TEST(AudioReorderTest, GivesUpWhenTooMuchIsHeld) {
+  mik::AudioReorderBuffer buffer(-1);
+  const auto start = Clock::now();
+  const auto held = static_cast<uint32_t>(mik::AudioReorderBuffer::MaxPendingAudio);
+  for (uint32_t audioId = 1; audioId <= held; ++audioId) {
+    ASSERT_TRUE(buffer.push(audioId, makeAudio("held", start), start + 1h));
+  }
+  EXPECT_TRUE(popAll(buffer).empty());
+
+  ASSERT_TRUE(buffer.push(held + 1, makeAudio("last", start), start + 1h));
+  EXPECT_EQ(popAll(buffer).size(), held + 1);
+  EXPECT_EQ(buffer.nextAudioId(), held + 2);
+}
+
+// @test Audio without any audio, like that of an expired call, takes its place in line so the
+// audio held after it doesn't wait for the read timeout
+TEST(AudioReorderTest, SkippedAudioReleasesHeldAudio) {
+  mik::AudioReorderBuffer buffer(3);
+  ASSERT_TRUE(buffer.push(0, makeAudio("0")));
+  EXPECT_THAT(popAll(buffer), ElementsAre("0"));
+  ASSERT_TRUE(buffer.push(2, makeAudio("2")));
+  EXPECT_TRUE(popAll(buffer).empty());
+
+  ASSERT_TRUE(buffer.push(1, {nullptr, false, mik::AudioEncoding::Linear16, Clock::now()}));
+  EXPECT_THAT(popAll(buffer), ElementsAre("<skipped>", "2"));
+}
+
+// @test The end of a stream gives up on the audio that's still missing
+TEST(AudioReorderTest, SkipMissingContinuesAtHeldAudio) {
+  mik::AudioReorderBuffer buffer(3);
+  ASSERT_TRUE(buffer.push(0, makeAudio("0")));
+  ASSERT_TRUE(buffer.push(2, makeAudio("2")));
+  ASSERT_TRUE(buffer.push(5, makeAudio("5")));
+  EXPECT_THAT(popAll(buffer), ElementsAre("0"));
+
+  buffer.skipMissing();
+  EXPECT_THAT(popAll(buffer), ElementsAre("2"));
+  buffer.skipMissing();
+  EXPECT_THAT(popAll(buffer), ElementsAre("5"));
+  EXPECT_EQ(buffer.heldCount(), 0U);
+
+  // Nothing is missing, so nothing is skipped
+  buffer.skipMissing();
+  EXPECT_EQ(buffer.nextAudioId(), 6U);
+}
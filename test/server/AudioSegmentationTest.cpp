@@ -0,0 +1,110 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include "AudioSegmentation.hpp"
+
+namespace {
+
+constexpr float SampleRate = 16000;
+
+/// @brief Appends a loud tone, or digital silence if amplitude is 0
+void appendAudio(std::string& audio, float secs, int16_t amplitude) {
+  const auto sampleCount = static_cast<size_t>(secs * SampleRate);
+  for (size_t i = 0; i < sampleCount; ++i) {
+    const auto sample = static_cast<int16_t>(amplitude * std::sin(static_cast<float>(i) * 0.1f));
+    char bytes[sizeof(int16_t)];
+    std::memcpy(bytes, &sample, sizeof(int16_t));
+    audio.append(bytes, sizeof(int16_t));
+  }
+}
+
+size_t seconds(float secs) { return static_cast<size_t>(secs * SampleRate); }
+
+/// @brief Every sample is in exactly one span, in order
+void expectContiguous(const std::vector<mik::AudioSpan>& spans, size_t sampleCount) {
+  ASSERT_FALSE(spans.empty());
+  EXPECT_EQ(spans.front().begin, 0U);
+  EXPECT_EQ(spans.back().end, sampleCount);
+  for (size_t i = 0; i < spans.size(); ++i) {
+    EXPECT_LT(spans[i].begin, spans[i].end);
+    if (i > 0) {
+      EXPECT_EQ(spans[i - 1].end, spans[i].begin);
+    }
+  }
+}
+
+} // namespace
+
+// @test No audio gives no segments
+TEST(AudioSegmentation, EmptyAudio) {
+  EXPECT_TRUE(mik::splitAtSilence({}, {}).empty());
+  // A lone byte isn't a whole sample
+  EXPECT_TRUE(mik::splitAtSilence("a", {}).empty());
+}
+
+// @test Long recordings are cut in the middle of the silences between speech
+TEST(AudioSegmentation, CutsInTheMiddleOfSilence) {
+  std::string audio;
+  appendAudio(audio, 20, 10000);
+  appendAudio(audio, 1, 0);
+  appendAudio(audio, 20, 10000);
+  appendAudio(audio, 1, 0);
+  appendAudio(audio, 20, 10000);
+
+  const auto spans = mik::splitAtSilence(audio, {});
+  ASSERT_EQ(spans.size(), 3U);
+  expectContiguous(spans, audio.size() / 2);
+  EXPECT_EQ(spans[0].end, seconds(20.5f));
+  EXPECT_EQ(spans[1].end, seconds(41.5f));
+}
+
+// @test Pauses that are too short, or come too early in a segment, aren't split at
+TEST(AudioSegmentation, KeepsShortPausesAndSegmentsTogether) {
+  std::string audio;
+  appendAudio(audio, 5, 10000);
+  appendAudio(audio, 1, 0);
+  appendAudio(audio, 20, 10000);
+  appendAudio(audio, 0.1f, 0);
+  appendAudio(audio, 20, 10000);
+
+  const auto spans = mik::splitAtSilence(audio, {});
+  ASSERT_EQ(spans.size(), 1U);
+  expectContiguous(spans, audio.size() / 2);
+}
+
+// @test Audio without any silence is still split once it reaches the maximum length
+TEST(AudioSegmentation, SplitsAtMaximumLength) {
+  std::string audio;
+  appendAudio(audio, 150, 10000);
+
+  mik::SegmentationOptions options;
+  options.maxSegmentSecs = 60;
+  const auto spans = mik::splitAtSilence(audio, options);
+  expectContiguous(spans, audio.size() / 2);
+  EXPECT_GE(spans.size(), 3U);
+  for (const auto& span : spans) {
+    EXPECT_LE(span.end - span.begin, seconds(options.maxSegmentSecs));
+  }
+
+  options.maxSegmentSecs = 0;
+  EXPECT_EQ(mik::splitAtSilence(audio, options).size(), 1U);
+}
+
+// @test Quiet noise counts as silence as long as it's below the threshold
+TEST(AudioSegmentation, ThresholdDecidesWhatIsSilent) {
+  std::string audio;
+  appendAudio(audio, 20, 10000);
+  // About -50 dBFS
+  appendAudio(audio, 1, 150);
+  appendAudio(audio, 20, 10000);
+
+  mik::SegmentationOptions options;
+  EXPECT_EQ(mik::splitAtSilence(audio, options).size(), 2U);
+  options.silenceThresholdDb = -60;
+  EXPECT_EQ(mik::splitAtSilence(audio, options).size(), 1U);
+}
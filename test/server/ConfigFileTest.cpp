@@ -0,0 +1,151 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "ConfigFile.hpp"
+#include "ServerConfig.hpp"
+
+using ::testing::ElementsAre;
+
+namespace {
+
+/// @brief Writes the contents to a file that's removed again when this goes out of scope
+class TempFile {
+public:
+  explicit TempFile(const std::string& contents)
+      : path_(std::filesystem::temp_directory_path() /
+              ("ristretto-config-" + std::to_string(counter_++) + ".json")) {
+    std::ofstream(path_) << contents;
+  }
+  TempFile(const TempFile&) = delete;
+  TempFile& operator=(const TempFile&) = delete;
+  ~TempFile() { std::filesystem::remove(path_); }
+
+  [[nodiscard]] const std::filesystem::path& path() const noexcept { return path_; }
+
+private:
+  static inline int counter_ = 0;
+  std::filesystem::path path_;
+};
+
+/// @brief A config file from the repository with its online.conf swapped for an empty one. Kaldi
+/// reads --config files while parsing, and the model the file points at isn't installed here
+class RepositoryConfig {
+public:
+  explicit RepositoryConfig(const std::string& relativePath)
+      : onlineConf_(""), config_(withOnlineConf(relativePath, onlineConf_.path())) {}
+
+  [[nodiscard]] mik::ServerConfig load() const {
+    const std::string configArg = "--server-config=" + config_.path().string();
+    std::array<const char*, 2> argv{"RistrettoServer", configArg.c_str()};
+    return mik::ServerConfig::fromCommandLine(static_cast<int>(argv.size()), argv.data());
+  }
+
+private:
+  static std::string withOnlineConf(const std::string& relativePath,
+                                    const std::filesystem::path& onlineConf) {
+    std::ifstream file(std::filesystem::path(RISTRETTO_SOURCE_DIR) / relativePath);
+    const std::string contents((std::istreambuf_iterator<char>(file)),
+                               std::istreambuf_iterator<char>());
+    EXPECT_FALSE(contents.empty()) << "Couldn't read " << relativePath;
+    return std::regex_replace(contents, std::regex("--config=[^\"]*"),
+                              "--config=" + onlineConf.string());
+  }
+
+  TempFile onlineConf_;
+  TempFile config_;
+};
+
+} // namespace
+
+// @test Server parameters become options named after them, Kaldi's arguments are passed through
+TEST(ConfigFile, ReadsParametersAndKaldiArgs) {
+  const TempFile file(R"({
+    "serverParameters": [
+      { "ipAndPort": { "type": "string", "value": "127.0.0.1:6000" } },
+      { "numDecodeThreads": { "type": "int", "value": 8 } },
+      { "batchInference": { "type": "bool", "value": true } },
+      { "batch.minibatchSize": { "type": "int", "value": 64 } }
+    ],
+    "kaldiCommandLineArgs": ["--beam=15.0", "final.mdl", "HCLG.fst", "words.txt"]
+  })");
+
+  const auto args = mik::readConfigFile(file.path());
+  ASSERT_TRUE(args);
+  EXPECT_THAT(args->options,
+              ElementsAre("--ip-and-port=127.0.0.1:6000", "--num-decode-threads=8",
+                          "--batch-inference=true", "--batch.minibatch-size=64", "--beam=15.0"));
+  EXPECT_THAT(args->positionals, ElementsAre("final.mdl", "HCLG.fst", "words.txt"));
+}
+
+// @test Files that are missing or malformed are reported instead of throwing
+TEST(ConfigFile, RejectsBadFiles) {
+  EXPECT_FALSE(mik::readConfigFile("/nonexistent/serverConfig.json"));
+
+  const TempFile notJson("{ this isn't json");
+  EXPECT_FALSE(mik::readConfigFile(notJson.path()));
+
+  const TempFile missingValue(
+      R"({ "serverParameters": [ { "maxSessions": { "type": "int" } } ] })");
+  EXPECT_FALSE(mik::readConfigFile(missingValue.path()));
+}
+
+// @test Command line options come after the file's so they win, its positionals replace the file's
+TEST(ConfigFile, CommandLineOverridesFile) {
+  const mik::ConfigFileArgs fileArgs{{"--max-sessions=64", "--beam=15.0"},
+                                     {"final.mdl", "HCLG.fst", "words.txt"}};
+
+  EXPECT_THAT(mik::mergeArgs(fileArgs, {"RistrettoServer", "--max-sessions=8"}),
+              ElementsAre("RistrettoServer", "--max-sessions=64", "--beam=15.0",
+                          "--max-sessions=8", "final.mdl", "HCLG.fst", "words.txt"));
+
+  EXPECT_THAT(mik::mergeArgs(fileArgs, {"RistrettoServer", "other.mdl", "other.fst", "o.txt"}),
+              ElementsAre("RistrettoServer", "--max-sessions=64", "--beam=15.0", "other.mdl",
+                          "other.fst", "o.txt"));
+}
+
+// @test The shipped config only uses options the server has, and they end up in the config
+TEST(ConfigFile, LoadsShippedConfig) {
+  const auto config = RepositoryConfig("serverConfig.json").load();
+
+  EXPECT_EQ(config.address, "0.0.0.0:5050");
+  EXPECT_GE(config.decodeThreadCount, 1);
+  EXPECT_EQ(config.completionQueueCount, 1);
+  EXPECT_EQ(config.maxSessions, 64);
+  EXPECT_EQ(config.sessionIdleTimeoutSecs, 300);
+  EXPECT_EQ(config.pooledDecoderCount, 1);
+  EXPECT_EQ(config.admission.maxQueueWaitMs, 2000);
+  EXPECT_DOUBLE_EQ(config.admission.maxLoad, 0.9);
+  EXPECT_FALSE(config.nnet3.batchInference);
+  EXPECT_EQ(config.nnet3.batchMaxWaitMs, 5);
+  EXPECT_EQ(config.nnet3.batchOpts.minibatch_size, 128);
+
+  EXPECT_EQ(config.nnet3.decodableOpts.frames_per_chunk, 20);
+  EXPECT_EQ(config.nnet3.decodableOpts.frame_subsampling_factor, 3);
+  EXPECT_EQ(config.nnet3.decoderOpts.max_active, 7000);
+  EXPECT_FLOAT_EQ(config.nnet3.decoderOpts.beam, 15.0f);
+  EXPECT_FLOAT_EQ(config.nnet3.decoderOpts.lattice_beam, 6.0f);
+  EXPECT_EQ(config.nnet3.nnet3Filename, "/opt/kaldi/egs/aspire/s5/exp/chain/tdnn_7b/final.mdl");
+  EXPECT_EQ(config.nnet3.fstFilename,
+            "/opt/kaldi/egs/aspire/s5/exp/tdnn_7b_chain_online/graph_pp/HCLG.fst");
+  EXPECT_EQ(config.nnet3.wordSymsFilename,
+            "/opt/kaldi/egs/aspire/s5/exp/tdnn_7b_chain_online/graph_pp/words.txt");
+}
+
+// @test The test resource config loads the same way, options it leaves out keep their defaults
+TEST(ConfigFile, LoadsTestResourceConfig) {
+  const auto config = RepositoryConfig("test/resources/testServerConfig.json").load();
+
+  EXPECT_EQ(config.address, "0.0.0.0:5050");
+  EXPECT_EQ(config.maxSessions, 64);
+  EXPECT_EQ(config.nnet3.batchOpts.minibatch_size, 128);
+  EXPECT_EQ(config.admission.maxQueueWaitMs, mik::AdmissionOptions{}.maxQueueWaitMs);
+  EXPECT_EQ(config.nnet3.nnet3Filename, "/opt/kaldi/egs/aspire/s5/exp/chain/tdnn_7b/final.mdl");
+}
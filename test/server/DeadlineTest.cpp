@@ -0,0 +1,48 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+
+#include "RistrettoServer.hpp"
+
+using namespace std::chrono_literals;
+using Clock = mik::WorkerPool::Clock;
+
+// @test A call without a deadline never expires by itself
+TEST(DeadlineTest, NoDeadlineIsEndOfTime) {
+  EXPECT_EQ(mik::steadyDeadline(std::chrono::system_clock::time_point::max()),
+            Clock::time_point::max());
+
+  const std::atomic<bool> isCancelled = false;
+  EXPECT_FALSE(mik::hasExpired(isCancelled, Clock::time_point::max()));
+}
+
+// @test The time that's left until the client's deadline is kept on the workers' clock
+TEST(DeadlineTest, KeepsTimeLeft) {
+  const auto before = Clock::now();
+  const auto deadline = mik::steadyDeadline(std::chrono::system_clock::now() + 5s);
+  const auto after = Clock::now();
+  EXPECT_GE(deadline, before + 4s);
+  EXPECT_LE(deadline, after + 5s);
+
+  const std::atomic<bool> isCancelled = false;
+  EXPECT_FALSE(mik::hasExpired(isCancelled, deadline));
+}
+
+// @test Calls past their deadline have expired, so they're skipped instead of decoded
+TEST(DeadlineTest, PastDeadlineHasExpired) {
+  const std::atomic<bool> isCancelled = false;
+  const auto passed = mik::steadyDeadline(std::chrono::system_clock::now() - 1s);
+  EXPECT_TRUE(mik::hasExpired(isCancelled, passed));
+  EXPECT_TRUE(mik::hasExpired(isCancelled, Clock::now() - 1ms));
+}
+
+// @test Cancelled calls have expired whatever their deadline
+TEST(DeadlineTest, CancelledHasExpired) {
+  std::atomic<bool> isCancelled = false;
+  EXPECT_FALSE(mik::hasExpired(isCancelled, Clock::now() + 1h));
+  isCancelled = true;
+  EXPECT_TRUE(mik::hasExpired(isCancelled, Clock::now() + 1h));
+  EXPECT_TRUE(mik::hasExpired(isCancelled, Clock::time_point::max()));
+}
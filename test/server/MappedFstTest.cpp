@@ -0,0 +1,92 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include "MappedFst.hpp"
+
+namespace {
+
+/// @brief Small stand-in for a decoding graph: 0 -1:1-> 1 -2:2-> 2
+fst::VectorFst<fst::StdArc> makeGraph() {
+  fst::VectorFst<fst::StdArc> graph;
+  const auto start = graph.AddState();
+  const auto middle = graph.AddState();
+  const auto end = graph.AddState();
+  graph.SetStart(start);
+  graph.AddArc(start, fst::StdArc(1, 1, 0.5, middle));
+  graph.AddArc(middle, fst::StdArc(2, 2, 0.25, end));
+  graph.SetFinal(end, fst::TropicalWeight::One());
+  return graph;
+}
+
+/**
+ * MappedFstTest
+ * @brief Writes graphs into a scratch directory that's removed afterwards
+ */
+class MappedFstTest : public ::testing::Test {
+protected:
+  void SetUp() override {
+    directory_ = std::filesystem::temp_directory_path() /
+                 ::testing::UnitTest::GetInstance()->current_test_info()->name();
+    std::filesystem::create_directories(directory_);
+  }
+  void TearDown() override { std::filesystem::remove_all(directory_); }
+
+  [[nodiscard]] std::string path(const std::string& filename) const {
+    return (directory_ / filename).string();
+  }
+
+private:
+  std::filesystem::path directory_;
+};
+
+} // namespace
+
+// @test A graph that isn't a ConstFst is converted once and the conversion is reused afterwards
+TEST_F(MappedFstTest, ConvertsOnce) {
+  const auto graphFilename = path("HCLG.fst");
+  const auto cacheFilename = path("HCLG.fst.mapped");
+  ASSERT_TRUE(makeGraph().Write(graphFilename));
+
+  const auto mapped = mik::readMappedFst(graphFilename);
+  ASSERT_NE(mapped, nullptr);
+  EXPECT_TRUE(fst::Equal(*mapped, makeGraph()));
+  ASSERT_TRUE(std::filesystem::exists(cacheFilename));
+
+  const auto cacheTime = std::filesystem::last_write_time(cacheFilename);
+  const auto mappedAgain = mik::readMappedFst(graphFilename);
+  ASSERT_NE(mappedAgain, nullptr);
+  EXPECT_EQ(std::filesystem::last_write_time(cacheFilename), cacheTime);
+}
+
+// @test An aligned ConstFst is mapped as is, without writing anything
+TEST_F(MappedFstTest, MapsAlignedConstFstDirectly) {
+  const auto graphFilename = path("HCLG.fst");
+  {
+    std::ofstream strm(graphFilename, std::ios_base::out | std::ios_base::binary);
+    fst::FstWriteOptions writeOptions(graphFilename);
+    writeOptions.align = true;
+    ASSERT_TRUE(fst::ConstFst<fst::StdArc>(makeGraph()).Write(strm, writeOptions));
+  }
+
+  const auto mapped = mik::readMappedFst(graphFilename);
+  ASSERT_NE(mapped, nullptr);
+  EXPECT_TRUE(fst::Equal(*mapped, makeGraph()));
+  EXPECT_FALSE(std::filesystem::exists(graphFilename + ".mapped"));
+}
+
+// @test A graph that doesn't exist can't be mapped, nothing is thrown so the caller can fall back
+TEST_F(MappedFstTest, MissingGraph) {
+  EXPECT_EQ(mik::readMappedFst(path("missing.fst")), nullptr);
+}
+
+// @test Kaldi's pipes can't be mapped, the caller reads them normally instead
+TEST_F(MappedFstTest, PipeIsNotMapped) {
+  const auto graphFilename = path("HCLG.fst");
+  ASSERT_TRUE(makeGraph().Write(graphFilename));
+  EXPECT_EQ(mik::readMappedFst("cat " + graphFilename + " |"), nullptr);
+  EXPECT_FALSE(std::filesystem::exists(graphFilename + " |.mapped"));
+}
@@ -0,0 +1,128 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Metrics.hpp"
+#include "MetricsServer.hpp"
+
+using ::testing::HasSubstr;
+
+namespace {
+
+/// @brief Sends a raw HTTP request to the local port and returns the whole response
+std::string httpRequest(uint16_t port, const std::string& request) {
+  const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  ::inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+  // NOLINTNEXTLINE: sockaddr_in is meant to be passed as a sockaddr
+  if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+    ::close(fd);
+    return {};
+  }
+  ::send(fd, request.data(), request.size(), 0);
+
+  std::string response;
+  char buffer[1024];
+  ssize_t received;
+  while ((received = ::recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+    response.append(buffer, static_cast<size_t>(received));
+  }
+  ::close(fd);
+  return response;
+}
+
+} // namespace
+
+// @test Observations land in the first bucket whose bound they don't exceed
+TEST(Metrics, HistogramBuckets) {
+  mik::Histogram histogram({1, 2, 5});
+  for (const double value : {0.5, 1.0, 1.5, 5.0, 7.0}) {
+    histogram.observe(value);
+  }
+  EXPECT_THAT(histogram.cumulativeCounts(), ::testing::ElementsAre(2, 3, 4, 5));
+  EXPECT_DOUBLE_EQ(histogram.sum(), 15);
+}
+
+// @test Every kind of metric is rendered in the Prometheus text format, in registration order
+TEST(Metrics, RendersExpositionFormat) {
+  mik::MetricsRegistry registry;
+  auto& counter = registry.addCounter("test_total", "A counter.");
+  auto& histogram = registry.addHistogram("test_seconds", "A histogram.", {0.1, 1});
+  registry.addGauge("test_depth", "A gauge.", [] { return 3; });
+
+  counter.add(2.5);
+  histogram.observe(0.05);
+  histogram.observe(0.5);
+
+  EXPECT_EQ(registry.render(), "# HELP test_total A counter.\n"
+                               "# TYPE test_total counter\n"
+                               "test_total 2.5\n"
+                               "# HELP test_seconds A histogram.\n"
+                               "# TYPE test_seconds histogram\n"
+                               "test_seconds_bucket{le=\"0.1\"} 1\n"
+                               "test_seconds_bucket{le=\"1\"} 2\n"
+                               "test_seconds_bucket{le=\"+Inf\"} 2\n"
+                               "test_seconds_sum 0.55\n"
+                               "test_seconds_count 2\n"
+                               "# HELP test_depth A gauge.\n"
+                               "# TYPE test_depth gauge\n"
+                               "test_depth 3\n");
+}
+
+// @test Updates from many threads aren't lost
+TEST(Metrics, ConcurrentUpdates) {
+  mik::MetricsRegistry registry;
+  auto& counter = registry.addCounter("test_total", "A counter.");
+  auto& histogram = registry.addHistogram("test_seconds", "A histogram.", mik::latencyBuckets());
+
+  constexpr int ThreadCount = 8;
+  constexpr int UpdateCount = 10000;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < ThreadCount; ++i) {
+    threads.emplace_back([&] {
+      for (int j = 0; j < UpdateCount; ++j) {
+        counter.add(1);
+        histogram.observe(0.01);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_DOUBLE_EQ(counter.value(), ThreadCount * UpdateCount);
+  EXPECT_EQ(histogram.cumulativeCounts().back(), static_cast<uint64_t>(ThreadCount * UpdateCount));
+}
+
+// @test The metrics are served over HTTP and anything else is a 404
+TEST(MetricsServer, ServesMetrics) {
+  mik::MetricsServer server("127.0.0.1", 0, [] { return std::string("test_depth 3\n"); });
+  ASSERT_TRUE(server.isListening());
+  ASSERT_NE(server.port(), 0);
+
+  const auto response = httpRequest(server.port(), "GET /metrics HTTP/1.1\r\nHost: x\r\n\r\n");
+  EXPECT_THAT(response, HasSubstr("HTTP/1.1 200 OK\r\n"));
+  EXPECT_THAT(response, HasSubstr("Content-Length: 13\r\n"));
+  EXPECT_THAT(response, ::testing::EndsWith("\r\n\r\ntest_depth 3\n"));
+
+  EXPECT_THAT(httpRequest(server.port(), "GET /other HTTP/1.1\r\n\r\n"),
+              HasSubstr("HTTP/1.1 404 Not Found\r\n"));
+}
+
+// @test A port that's already taken is reported instead of throwing
+TEST(MetricsServer, PortInUse) {
+  mik::MetricsServer first("127.0.0.1", 0, [] { return std::string(); });
+  ASSERT_TRUE(first.isListening());
+  mik::MetricsServer second("127.0.0.1", first.port(), [] { return std::string(); });
+  EXPECT_FALSE(second.isListening());
+}
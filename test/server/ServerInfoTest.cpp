@@ -0,0 +1,25 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include "RistrettoServer.hpp"
+
+using ::testing::ElementsAre;
+
+// @test The model's audio is described as is, PCM comes first and every codec works at 16 kHz
+TEST(ServerInfoTest, DescribesModelAudio) {
+  const auto info = mik::modelServerInfo(16000, 2880, 0.03f);
+  EXPECT_EQ(info.samplerate(), 16000U);
+  EXPECT_EQ(info.chunksamples(), 2880U);
+  EXPECT_FLOAT_EQ(info.frameduration(), 0.03f);
+  EXPECT_THAT(info.encodings(),
+              ElementsAre(RistrettoProto::LINEAR16, RistrettoProto::FLAC, RistrettoProto::OPUS));
+  // The load is the server's to fill in
+  EXPECT_EQ(info.activesessions(), 0U);
+  EXPECT_EQ(info.queuedjobs(), 0U);
+}
+
+// @test Opus isn't offered at rates it can't encode
+TEST(ServerInfoTest, LeavesOutOpusAtOtherRates) {
+  const auto info = mik::modelServerInfo(44100, 7938, 0.03f);
+  EXPECT_THAT(info.encodings(), ElementsAre(RistrettoProto::LINEAR16, RistrettoProto::FLAC));
+}
@@ -0,0 +1,175 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "SessionManager.hpp"
+
+using namespace std::chrono_literals;
+
+namespace {
+
+/// @brief Stands in for Nnet3Data so that no model has to be loaded
+struct FakeDecoder {
+  void reset() { ++resetCount; }
+  int resetCount = 0;
+};
+
+using FakeSessionManager = mik::BasicSessionManager<FakeDecoder>;
+
+FakeSessionManager::DecoderFactory countingFactory(std::atomic<int>& constructedCount) {
+  return [&constructedCount] {
+    ++constructedCount;
+    return std::make_unique<FakeDecoder>();
+  };
+}
+
+} // namespace
+
+// @test The same token always gets the same decoder
+TEST(SessionManagerTest, SameTokenSameDecoder) {
+  std::atomic<int> constructedCount = 0;
+  FakeSessionManager sessions(countingFactory(constructedCount), 0, 0s, 0);
+
+  const auto first = sessions.acquire("a");
+  const auto second = sessions.acquire("a");
+  const auto other = sessions.acquire("b");
+
+  ASSERT_NE(first, nullptr);
+  EXPECT_EQ(first, second);
+  EXPECT_NE(first, other);
+  EXPECT_EQ(sessions.activeSessions(), 2);
+  EXPECT_EQ(constructedCount.load(), 2);
+}
+
+// @test Pooled decoders are constructed up front and handed out before constructing new ones
+TEST(SessionManagerTest, UsesPooledDecoders) {
+  std::atomic<int> constructedCount = 0;
+  FakeSessionManager sessions(countingFactory(constructedCount), 0, 0s, 2);
+  ASSERT_EQ(constructedCount.load(), 2);
+  ASSERT_EQ(sessions.pooledDecoders(), 2);
+
+  [[maybe_unused]] const auto a = sessions.acquire("a");
+  [[maybe_unused]] const auto b = sessions.acquire("b");
+  EXPECT_EQ(constructedCount.load(), 2);
+  EXPECT_EQ(sessions.pooledDecoders(), 0);
+
+  [[maybe_unused]] const auto c = sessions.acquire("c");
+  EXPECT_EQ(constructedCount.load(), 3);
+}
+
+// @test New sessions are refused at capacity, existing ones are still found
+TEST(SessionManagerTest, RefusesSessionsAtCapacity) {
+  std::atomic<int> constructedCount = 0;
+  FakeSessionManager sessions(countingFactory(constructedCount), 2, 0s, 0);
+
+  const auto a = sessions.acquire("a");
+  const auto b = sessions.acquire("b");
+  ASSERT_NE(a, nullptr);
+  ASSERT_NE(b, nullptr);
+
+  EXPECT_EQ(sessions.acquire("c"), nullptr);
+  EXPECT_EQ(sessions.acquire("a"), a);
+}
+
+// @test Idle sessions are evicted, reset and put back in the pool
+TEST(SessionManagerTest, EvictsIdleSessionsIntoPool) {
+  std::atomic<int> constructedCount = 0;
+  FakeSessionManager sessions(countingFactory(constructedCount), 0, 1s, 1);
+
+  const FakeDecoder* decoder = sessions.acquire("a").get();
+  ASSERT_EQ(sessions.pooledDecoders(), 0);
+
+  std::this_thread::sleep_for(1100ms);
+  // The eviction thread may have gotten to it first
+  sessions.evictIdleSessions();
+  EXPECT_EQ(sessions.activeSessions(), 0);
+  ASSERT_EQ(sessions.pooledDecoders(), 1);
+
+  // The recycled decoder goes to the next session
+  const auto recycled = sessions.acquire("b");
+  EXPECT_EQ(recycled.get(), decoder);
+  EXPECT_EQ(recycled->resetCount, 1);
+  EXPECT_EQ(constructedCount.load(), 1);
+}
+
+// @test A session that's still being decoded is never evicted
+TEST(SessionManagerTest, DoesNotEvictSessionsInUse) {
+  std::atomic<int> constructedCount = 0;
+  FakeSessionManager sessions(countingFactory(constructedCount), 0, 1s, 0);
+
+  const auto inUse = sessions.acquire("a");
+  std::this_thread::sleep_for(1100ms);
+
+  EXPECT_EQ(sessions.evictIdleSessions(), 0);
+  EXPECT_EQ(sessions.acquire("a"), inUse);
+}
+
+// @test Reaching capacity evicts idle sessions to make room
+TEST(SessionManagerTest, EvictsToMakeRoom) {
+  std::atomic<int> constructedCount = 0;
+  FakeSessionManager sessions(countingFactory(constructedCount), 1, 1s, 0);
+
+  { [[maybe_unused]] const auto a = sessions.acquire("a"); }
+  EXPECT_EQ(sessions.acquire("b"), nullptr);
+
+  std::this_thread::sleep_for(1100ms);
+  EXPECT_NE(sessions.acquire("b"), nullptr);
+  EXPECT_EQ(sessions.activeSessions(), 1);
+}
+
+// @test Looking up an existing session doesn't wait for a new session's decoder to be constructed
+TEST(SessionManagerTest, LookupDoesNotWaitForConstruction) {
+  std::atomic<bool> shouldBlock = false;
+  std::promise<void> constructionStarted;
+  std::promise<void> releaseConstruction;
+  auto constructionReleased = releaseConstruction.get_future().share();
+  FakeSessionManager sessions(
+      [&] {
+        if (shouldBlock.exchange(false)) {
+          constructionStarted.set_value();
+          constructionReleased.wait();
+        }
+        return std::make_unique<FakeDecoder>();
+      },
+      0, 0s, 0);
+
+  const auto hot = sessions.acquire("hot");
+  shouldBlock = true;
+  auto cold = std::async(std::launch::async, [&sessions] { return sessions.acquire("cold"); });
+  constructionStarted.get_future().wait();
+
+  auto lookup = std::async(std::launch::async, [&sessions] { return sessions.acquire("hot"); });
+  EXPECT_EQ(lookup.wait_for(5s), std::future_status::ready);
+  EXPECT_EQ(lookup.get(), hot);
+
+  releaseConstruction.set_value();
+  EXPECT_NE(cold.get(), nullptr);
+  EXPECT_EQ(sessions.activeSessions(), 2);
+}
+
+// @test Sessions created concurrently never go over the limit
+TEST(SessionManagerTest, ConcurrentAcquireRespectsLimit) {
+  std::atomic<int> constructedCount = 0;
+  FakeSessionManager sessions(countingFactory(constructedCount), 8, 0s, 0);
+
+  std::atomic<int> acceptedCount = 0;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 32; ++i) {
+    threads.emplace_back([&sessions, &acceptedCount, i] {
+      if (sessions.acquire(std::to_string(i))) {
+        ++acceptedCount;
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(acceptedCount.load(), 8);
+  EXPECT_EQ(sessions.activeSessions(), 8);
+}
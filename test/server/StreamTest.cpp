@@ -0,0 +1,201 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <grpc++/grpc++.h>
+
+#include "RistrettoServer.hpp"
+#include "ServerConfig.hpp"
+
+using ::testing::HasSubstr;
+
+namespace {
+
+constexpr char TestAddress[] = "127.0.0.1:50505";
+/// @brief A quarter of a second of the 8 kHz test audio
+constexpr size_t ChunkBytes = 4000;
+
+std::string readTestResource(const std::string& name) {
+  std::ifstream file(std::filesystem::path(RISTRETTO_SOURCE_DIR) / "test/resources" / name,
+                     std::ios::binary);
+  return {std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+RistrettoProto::AudioData makeAudioData(const std::string& sessionToken, uint32_t audioId,
+                                        std::string audio) {
+  RistrettoProto::AudioData audioData;
+  audioData.set_sessiontoken(sessionToken);
+  audioData.set_audioid(audioId);
+  audioData.set_audio(std::move(audio));
+  return audioData;
+}
+
+/// @brief What the server sent back on a stream and how it ended it
+struct StreamResult {
+  std::vector<RistrettoProto::Transcript> transcripts;
+  grpc::Status status;
+};
+
+/**
+ * StreamTest
+ * @brief Runs the server on the model of testServerConfig.json. Only the server's Docker image has
+ * that model, the tests are skipped without it
+ */
+class StreamTest : public ::testing::Test {
+protected:
+  static void SetUpTestSuite() {
+    const auto configArg =
+        "--server-config=" +
+        (std::filesystem::path(RISTRETTO_SOURCE_DIR) / "test/resources/testServerConfig.json")
+            .string();
+    const auto addressArg = std::string("--ip-and-port=") + TestAddress;
+    // Nothing is refused for being slow, the tests are about the stream and not about the load
+    std::array<const char*, 6> argv{"RistrettoServer",       configArg.c_str(),
+                                    addressArg.c_str(),      "--num-decode-threads=2",
+                                    "--max-queue-wait-ms=0", "--max-load=0"};
+    try {
+      server_ = std::make_unique<mik::RistrettoServer>(
+          mik::ServerConfig::fromCommandLine(static_cast<int>(argv.size()), argv.data()));
+      server_->start();
+    } catch (const std::exception&) {
+      // Kaldi throws when it can't read the model
+      server_.reset();
+    }
+  }
+  static void TearDownTestSuite() { server_.reset(); }
+
+  void SetUp() override {
+    if (!server_) {
+      GTEST_SKIP() << "The model in testServerConfig.json isn't installed";
+    }
+    stub_ = RistrettoProto::Decoder::NewStub(
+        grpc::CreateChannel(TestAddress, grpc::InsecureChannelCredentials()));
+  }
+
+  /// @brief Streams the audio in quarter second chunks while the transcripts are read on another
+  /// thread, then ends the stream
+  StreamResult streamAudio(const std::string& audio, const std::string& sessionToken) {
+    grpc::ClientContext context;
+    auto stream = stub_->DecodeStream(&context);
+    StreamResult result;
+    std::thread reader([&stream, &result] {
+      RistrettoProto::Transcript transcript;
+      while (stream->Read(&transcript)) {
+        result.transcripts.push_back(transcript);
+      }
+    });
+
+    uint32_t audioId = 0;
+    for (size_t offset = 0; offset < audio.size(); offset += ChunkBytes) {
+      auto audioData = makeAudioData(sessionToken, audioId++, audio.substr(offset, ChunkBytes));
+      if (!stream->Write(audioData)) {
+        break;
+      }
+    }
+    stream->WritesDone();
+    reader.join();
+    result.status = stream->Finish();
+    return result;
+  }
+
+  static inline std::unique_ptr<mik::RistrettoServer> server_;
+  std::unique_ptr<RistrettoProto::Decoder::Stub> stub_;
+};
+
+} // namespace
+
+// @test An admitted stream gets its initial metadata without a retry hint, and a stream that ends
+// without any audio finishes cleanly without transcripts
+TEST_F(StreamTest, OpensAndClosesStream) {
+  grpc::ClientContext context;
+  auto stream = stub_->DecodeStream(&context);
+  stream->WaitForInitialMetadata();
+  EXPECT_EQ(context.GetServerInitialMetadata().count("retry-after-ms"), 0U);
+
+  ASSERT_TRUE(stream->WritesDone());
+  RistrettoProto::Transcript transcript;
+  EXPECT_FALSE(stream->Read(&transcript));
+  const auto status = stream->Finish();
+  EXPECT_TRUE(status.ok()) << status.error_message();
+}
+
+// @test Temporary transcripts come while the audio is decoded, each with the one segment decoded
+// so far. Final ones have the text up to an endpoint
+TEST_F(StreamTest, InterimAndFinalTranscripts) {
+  const auto audio = readTestResource("ClientTestAudio8KHz.raw");
+  ASSERT_FALSE(audio.empty());
+  const auto result = streamAudio(audio, "interim");
+  ASSERT_TRUE(result.status.ok()) << result.status.error_message();
+
+  size_t interimCount = 0;
+  std::string finalText;
+  for (const auto& transcript : result.transcripts) {
+    EXPECT_FALSE(transcript.text().empty());
+    EXPECT_EQ(transcript.sessiontoken(), "interim");
+    ASSERT_EQ(transcript.segments_size(), 1);
+    if (transcript.isfinal()) {
+      finalText += transcript.text() + " ";
+    } else {
+      ++interimCount;
+    }
+  }
+  EXPECT_GT(interimCount, 0U);
+  EXPECT_THAT(finalText, HasSubstr("one two three"));
+}
+
+// @test Ending the stream flushes the rest of the audio, the last transcript is final and the
+// stream finishes with OK
+TEST_F(StreamTest, EndOfStreamFinalizesTranscript) {
+  const auto audio = readTestResource("ClientTestAudio8KHz.raw");
+  ASSERT_FALSE(audio.empty());
+  const auto result = streamAudio(audio, "end-of-stream");
+  ASSERT_TRUE(result.status.ok()) << result.status.error_message();
+  ASSERT_FALSE(result.transcripts.empty());
+
+  const auto& last = result.transcripts.back();
+  EXPECT_TRUE(last.isfinal());
+  EXPECT_LE(last.segments(0).starttime(), last.segments(0).endtime());
+  // The audio after the last chunk never arrived, so no audioId is later than it
+  const auto chunkCount = (audio.size() + ChunkBytes - 1) / ChunkBytes;
+  for (const auto& transcript : result.transcripts) {
+    EXPECT_LT(transcript.audioid(), chunkCount);
+  }
+}
+
+// @test A client that cancels mid-stream ends the RPC as cancelled, and the server keeps serving
+// other streams afterwards
+TEST_F(StreamTest, ClientCancelsMidStream) {
+  const auto audio = readTestResource("ClientTestAudio8KHz.raw");
+  ASSERT_FALSE(audio.empty());
+  {
+    grpc::ClientContext context;
+    auto stream = stub_->DecodeStream(&context);
+    stream->WaitForInitialMetadata();
+    for (uint32_t audioId = 0; audioId < 8; ++audioId) {
+      ASSERT_TRUE(stream->Write(
+          makeAudioData("cancelled", audioId, audio.substr(audioId * ChunkBytes, ChunkBytes))));
+    }
+    context.TryCancel();
+
+    RistrettoProto::Transcript transcript;
+    while (stream->Read(&transcript)) {
+    }
+    EXPECT_EQ(stream->Finish().error_code(), grpc::StatusCode::CANCELLED);
+  }
+
+  const auto result = streamAudio(audio, "after-cancel");
+  ASSERT_TRUE(result.status.ok()) << result.status.error_message();
+  ASSERT_FALSE(result.transcripts.empty());
+  EXPECT_TRUE(result.transcripts.back().isfinal());
+}
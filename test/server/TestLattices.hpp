@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+
+#include "KaldiInterface.hpp"
+
+namespace TestUtils {
+
+/// @brief Symbols "word1" to "word<vocabularySize>", with word ID i being "word<i>"
+inline fst::SymbolTable makeWordSymbols(int vocabularySize) {
+  fst::SymbolTable wordSyms;
+  wordSyms.AddSymbol("<eps>", 0);
+  for (int word = 1; word <= vocabularySize; ++word) {
+    wordSyms.AddSymbol("word" + std::to_string(word), word);
+  }
+  return wordSyms;
+}
+
+/// @brief Lattice with a choice between a few words for every word of the utterance, like a
+/// sausage. Each of the words takes the same frames, choice c of word i is word ID
+/// i * choices + c + 1 and costs c more, so the first choice is the best one
+inline kaldi::CompactLattice makeSausageLattice(int wordCount, int choices,
+                                                int vocabularySize = 1000) {
+  constexpr int FramesPerWord = 8;
+  kaldi::Lattice lat;
+  auto state = lat.AddState();
+  lat.SetStart(state);
+  for (int i = 0; i < wordCount; ++i) {
+    const auto next = lat.AddState();
+    for (int choice = 0; choice < choices; ++choice) {
+      const int word = (i * choices + choice) % vocabularySize + 1;
+      auto from = state;
+      for (int frame = 0; frame < FramesPerWord; ++frame) {
+        const auto to = frame + 1 == FramesPerWord ? next : lat.AddState();
+        const auto cost = frame == 0 ? static_cast<float>(choice) : 0.f;
+        lat.AddArc(from, kaldi::LatticeArc(i * FramesPerWord + frame + 1, frame == 0 ? word : 0,
+                                           kaldi::LatticeWeight(cost, 1), to));
+        from = to;
+      }
+    }
+    state = next;
+  }
+  lat.SetFinal(state, kaldi::LatticeWeight::One());
+
+  kaldi::CompactLattice clat;
+  fst::ConvertLattice(lat, &clat);
+  return clat;
+}
+
+} // namespace TestUtils
@@ -0,0 +1,123 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "KaldiInterface.hpp"
+#include "TestLattices.hpp"
+
+using ::testing::UnorderedElementsAre;
+
+namespace {
+
+constexpr int VocabularySize = 100;
+constexpr kaldi::BaseFloat FrameDuration = 0.03f;
+
+/// @brief Posterior of the choice that costs this much more than the best one, out of three
+double sausagePosterior(int extraCost) {
+  return std::exp(-extraCost) / (1 + std::exp(-1.0) + std::exp(-2.0));
+}
+
+} // namespace
+
+// @test Alternatives come best first with the path's graph plus acoustic cost
+TEST(TranscriptTest, NbestIsOrderedByCost) {
+  const auto wordSyms = TestUtils::makeWordSymbols(VocabularySize);
+  mik::TranscriptOptions options;
+  options.nbest = 3;
+  options.frameDuration = FrameDuration;
+
+  // Two words with three choices each, every frame costs 1 and the choices 0, 1 and 2 more
+  const auto segment =
+      mik::LatticeToSegment(TestUtils::makeSausageLattice(2, 3, VocabularySize), wordSyms, options);
+  EXPECT_EQ(segment.text, "word1 word4");
+  ASSERT_EQ(segment.alternatives.size(), 3U);
+  EXPECT_EQ(segment.alternatives[0].text, "word1 word4");
+  EXPECT_FLOAT_EQ(segment.alternatives[0].cost, 16);
+  // The two second best paths cost the same, so they can come in either order
+  EXPECT_FLOAT_EQ(segment.alternatives[1].cost, 17);
+  EXPECT_FLOAT_EQ(segment.alternatives[2].cost, 17);
+  EXPECT_THAT((std::vector<std::string>{segment.alternatives[1].text,
+                                        segment.alternatives[2].text}),
+              UnorderedElementsAre("word2 word4", "word1 word5"));
+  EXPECT_TRUE(segment.words.empty());
+}
+
+// @test Each of the best path's words gets its posterior in its sausage and the frames it spans
+TEST(TranscriptTest, WordConfidencesAndTimes) {
+  const auto wordSyms = TestUtils::makeWordSymbols(VocabularySize);
+  mik::TranscriptOptions options;
+  options.wordConfidence = true;
+  options.wordTimes = true;
+  options.frameDuration = FrameDuration;
+
+  const auto segment =
+      mik::LatticeToSegment(TestUtils::makeSausageLattice(3, 3, VocabularySize), wordSyms, options);
+  EXPECT_EQ(segment.text, "word1 word4 word7");
+  EXPECT_TRUE(segment.alternatives.empty());
+  ASSERT_EQ(segment.words.size(), 3U);
+  for (size_t i = 0; i < segment.words.size(); ++i) {
+    const auto& word = segment.words[i];
+    EXPECT_NEAR(word.confidence, sausagePosterior(0), 1e-3) << "word " << i;
+    EXPECT_FLOAT_EQ(word.startTime, static_cast<float>(i * 8) * FrameDuration) << "word " << i;
+    EXPECT_FLOAT_EQ(word.endTime, static_cast<float>((i + 1) * 8) * FrameDuration) << "word " << i;
+  }
+}
+
+// @test Words missing from the symbol table get the same placeholder in the text and the words
+TEST(TranscriptTest, UnknownWordsGetPlaceholder) {
+  // Only the first word's choices are in the table
+  const auto wordSyms = TestUtils::makeWordSymbols(3);
+  mik::TranscriptOptions options;
+  options.nbest = 2;
+  options.wordConfidence = true;
+
+  const auto segment =
+      mik::LatticeToSegment(TestUtils::makeSausageLattice(2, 3, VocabularySize), wordSyms, options);
+  EXPECT_EQ(segment.text, "word1 <#1>");
+  ASSERT_EQ(segment.words.size(), 2U);
+  EXPECT_EQ(segment.words[0].text, "word1");
+  EXPECT_EQ(segment.words[1].text, "<#1>");
+}
+
+// @test Without N-best or words only the best path's text is given
+TEST(TranscriptTest, TextOnly) {
+  const auto wordSyms = TestUtils::makeWordSymbols(VocabularySize);
+  const auto segment = mik::LatticeToSegment(TestUtils::makeSausageLattice(2, 3, VocabularySize),
+                                             wordSyms, mik::TranscriptOptions{});
+  EXPECT_EQ(segment.text, "word1 word4");
+  EXPECT_TRUE(segment.alternatives.empty());
+  EXPECT_TRUE(segment.words.empty());
+}
+
+// @test Word times follow the segment to where its utterance starts in the stream, and again to
+// where its piece starts in a DecodeFile recording
+TEST(TranscriptTest, WordTimesFollowOffsets) {
+  const auto wordSyms = TestUtils::makeWordSymbols(VocabularySize);
+  mik::TranscriptOptions options;
+  options.wordTimes = true;
+  options.frameDuration = FrameDuration;
+
+  auto segment =
+      mik::LatticeToSegment(TestUtils::makeSausageLattice(2, 3, VocabularySize), wordSyms, options);
+  segment.endTime = 16 * FrameDuration;
+  ASSERT_EQ(segment.words.size(), 2U);
+
+  // The utterance started after an endpoint 1.5 seconds into the stream
+  constexpr kaldi::BaseFloat UtteranceStart = 1.5f;
+  mik::offsetSegment(&segment, UtteranceStart);
+  EXPECT_FLOAT_EQ(segment.startTime, UtteranceStart);
+  EXPECT_FLOAT_EQ(segment.endTime, UtteranceStart + 16 * FrameDuration);
+  EXPECT_FLOAT_EQ(segment.words[1].startTime, UtteranceStart + 8 * FrameDuration);
+  EXPECT_FLOAT_EQ(segment.words[1].endTime, UtteranceStart + 16 * FrameDuration);
+
+  // The stream was a piece of a file that started 10 seconds in
+  constexpr kaldi::BaseFloat PieceStart = 10;
+  mik::offsetSegment(&segment, PieceStart);
+  EXPECT_FLOAT_EQ(segment.startTime, PieceStart + UtteranceStart);
+  EXPECT_FLOAT_EQ(segment.words[0].startTime, PieceStart + UtteranceStart);
+  EXPECT_FLOAT_EQ(segment.words[0].endTime, PieceStart + UtteranceStart + 8 * FrameDuration);
+  EXPECT_FLOAT_EQ(segment.words[1].endTime, PieceStart + UtteranceStart + 16 * FrameDuration);
+}
@@ -0,0 +1,71 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <utility>
+#include <vector>
+
+#include "UtteranceDecoder.hpp"
+
+namespace {
+
+constexpr kaldi::int32 ChunkFrames = 20;
+constexpr kaldi::int32 FrameSubsampling = 3;
+constexpr kaldi::int32 LeftContext = 40;
+
+/**
+ * @brief Does what BatchedUtteranceDecoder::computeReadyFrames does with the tasks, the acoustic
+ * model's output is faked so that each row holds the stream frame it's for
+ * @return Log-likelihoods of the frames, merged like they're handed to the decoder
+ */
+kaldi::Matrix<kaldi::BaseFloat> computeFrames(kaldi::int32 firstFrame, kaldi::int32 frameCount) {
+  auto tasks = mik::makeInferenceTasks(frameCount, ChunkFrames, FrameSubsampling, LeftContext);
+  for (auto& task : tasks) {
+    const auto taskFirstFrame = firstFrame + task.first_used_output_frame_index;
+    task.output_cpu.Resize(task.num_output_frames, 1);
+    for (kaldi::int32 i = 0; i < task.num_output_frames; ++i) {
+      task.output_cpu(i, 0) = static_cast<kaldi::BaseFloat>(taskFirstFrame + i);
+    }
+  }
+  kaldi::Matrix<kaldi::BaseFloat> loglikes;
+  kaldi::nnet3::MergeTaskOutput(tasks, &loglikes);
+  return loglikes;
+}
+
+} // namespace
+
+// @test Tasks are whole chunks except for the last one
+TEST(UtteranceDecoderTest, TasksSplitIntoChunks) {
+  const auto tasks = mik::makeInferenceTasks(47, ChunkFrames, FrameSubsampling, LeftContext);
+  ASSERT_EQ(tasks.size(), 3U);
+  std::vector<kaldi::int32> frames;
+  std::vector<kaldi::int32> rows;
+  for (const auto& task : tasks) {
+    frames.push_back(task.num_used_output_frames);
+    rows.push_back(task.first_used_output_frame_index);
+    EXPECT_EQ(task.first_input_t, -LeftContext);
+    EXPECT_EQ(task.output_t_stride, FrameSubsampling);
+    EXPECT_TRUE(task.output_to_cpu);
+  }
+  EXPECT_THAT(frames, ::testing::ElementsAre(20, 20, 7));
+  EXPECT_THAT(rows, ::testing::ElementsAre(0, 20, 40));
+  EXPECT_FALSE(tasks[0].is_irregular);
+  EXPECT_TRUE(tasks[2].is_irregular);
+  EXPECT_TRUE(mik::makeInferenceTasks(0, ChunkFrames, FrameSubsampling, LeftContext).empty());
+}
+
+// @test A stream's frames come out in order over several chunks of audio and an endpoint, even
+// though every call's output starts at row 0 while the stream's frames keep counting up
+TEST(UtteranceDecoderTest, MergesOverChunksAndEndpoint) {
+  // The first utterance is decoded over two calls, after the endpoint the next utterance starts
+  // at frame 60 and the input finishes with a partial chunk
+  const std::vector<std::pair<kaldi::int32, kaldi::int32>> calls = {
+      {0, 40}, {40, 20}, {60, 40}, {100, 7}};
+  for (const auto& [firstFrame, frameCount] : calls) {
+    const auto loglikes = computeFrames(firstFrame, frameCount);
+    ASSERT_EQ(loglikes.NumRows(), frameCount) << "at frame " << firstFrame;
+    for (kaldi::int32 row = 0; row < frameCount; ++row) {
+      ASSERT_EQ(loglikes(row, 0), static_cast<kaldi::BaseFloat>(firstFrame + row))
+          << "at frame " << firstFrame << ", row " << row;
+    }
+  }
+}
@@ -0,0 +1,115 @@
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "WorkerPool.hpp"
+
+using namespace std::chrono_literals;
+
+// @test Every submitted job is ran before shutdown returns
+TEST(WorkerPoolTest, RunsAllJobs) {
+  std::atomic<int> jobsRan = 0;
+  mik::WorkerPool pool(4);
+  for (int i = 0; i < 100; ++i) {
+    pool.submit([&jobsRan] { ++jobsRan; });
+  }
+  pool.shutdown();
+
+  ASSERT_EQ(jobsRan.load(), 100);
+}
+
+// @test A long job on one thread doesn't stop other jobs from running
+TEST(WorkerPoolTest, LongJobDoesNotBlockOthers) {
+  mik::WorkerPool pool(2);
+  std::promise<void> releaseLongJob;
+  auto longJobReleased = releaseLongJob.get_future().share();
+  pool.submit([longJobReleased] { longJobReleased.wait(); });
+
+  std::promise<void> shortJobRan;
+  auto shortJobDone = shortJobRan.get_future();
+  pool.submit([&shortJobRan] { shortJobRan.set_value(); });
+
+  EXPECT_EQ(shortJobDone.wait_for(5s), std::future_status::ready);
+  releaseLongJob.set_value();
+}
+
+// @test Jobs are spread across the threads in the pool
+TEST(WorkerPoolTest, UsesMultipleThreads) {
+  constexpr size_t threadCount = 3;
+  mik::WorkerPool pool(threadCount);
+  ASSERT_EQ(pool.threadCount(), threadCount);
+
+  std::mutex idMutex;
+  std::set<std::thread::id> threadIds;
+  std::atomic<size_t> waiting = 0;
+  for (size_t i = 0; i < threadCount; ++i) {
+    pool.submit([&] {
+      {
+        std::lock_guard<std::mutex> lock(idMutex);
+        threadIds.insert(std::this_thread::get_id());
+      }
+      // Hold each thread until all of them have picked up a job
+      ++waiting;
+      while (waiting.load() < threadCount) {
+        std::this_thread::sleep_for(1ms);
+      }
+    });
+  }
+  pool.shutdown();
+
+  ASSERT_EQ(threadIds.size(), threadCount);
+}
+
+// @test An exception thrown by a job doesn't take down the worker
+TEST(WorkerPoolTest, SurvivesThrowingJob) {
+  std::atomic<bool> ranAfterThrow = false;
+  mik::WorkerPool pool(1);
+  pool.submit([] { throw std::runtime_error("test"); });
+  pool.submit([&ranAfterThrow] { ranAfterThrow = true; });
+  pool.shutdown();
+
+  ASSERT_TRUE(ranAfterThrow.load());
+}
+
+// @test Interactive jobs run before batch ones, the earliest deadline first and then in the order
+// they were submitted
+TEST(WorkerPoolTest, RunsMostUrgentFirst) {
+  mik::WorkerPool pool(1);
+  std::promise<void> workerBlocked;
+  auto blocked = workerBlocked.get_future();
+  std::promise<void> releaseWorker;
+  auto workerReleased = releaseWorker.get_future().share();
+  pool.submit([&workerBlocked, workerReleased] {
+    workerBlocked.set_value();
+    workerReleased.wait();
+  });
+  // Otherwise the worker could pick one of the jobs below before the rest are queued
+  blocked.wait();
+
+  std::mutex orderMutex;
+  std::vector<int> order;
+  const auto record = [&orderMutex, &order](int id) {
+    return [&orderMutex, &order, id] {
+      std::lock_guard<std::mutex> lock(orderMutex);
+      order.push_back(id);
+    };
+  };
+  const auto now = mik::WorkerPool::Clock::now();
+  pool.submit(record(6), mik::JobPriority::Batch, now + 1s);
+  pool.submit(record(5), mik::JobPriority::Batch);
+  pool.submit(record(3), mik::JobPriority::Interactive);
+  pool.submit(record(2), mik::JobPriority::Interactive, now + 2s);
+  pool.submit(record(4), mik::JobPriority::Interactive);
+  pool.submit(record(1), mik::JobPriority::Interactive, now + 1s);
+  releaseWorker.set_value();
+  pool.shutdown();
+
+  ASSERT_EQ(order, (std::vector<int>{1, 2, 3, 4, 6, 5}));
+}